@@ -0,0 +1,529 @@
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <system_error>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "asyncio.h"
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define AIO_HAVE_IO_URING
+#endif
+
+#ifdef AIO_HAVE_IO_URING
+// The submission and completion rings shared with the kernel, driven through the raw system calls
+struct IoUring
+{
+    int fd;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    struct io_uring_sqe *sqes;
+    size_t sqesSize;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    unsigned sqEntries;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+};
+#else
+struct IoUring
+{
+};
+#endif
+
+AsyncIOManager* AsyncIOManager::_aio_manager = NULL;
+
+AsyncIOManager* AsyncIOManager::instance()
+{
+    static once_flag created;
+    call_once(created, [] { _aio_manager = new AsyncIOManager(); });
+
+    return _aio_manager;
+}
+
+AsyncIOManager::AsyncIOManager()
+{
+    nextToken = 1;
+    ring = NULL;
+    inFlight = 0;
+    stopping = false;
+
+    // io_uring may be missing from the kernel or blocked by a sandbox; the thread pool always works
+    if (setUpRing() == SUCCESS)
+        backend = AsyncIoUring;
+    else
+    {
+        backend = AsyncThreadPool;
+        startWorkers();
+    }
+}
+
+AsyncIOManager::~AsyncIOManager()
+{
+    stopWorkers();
+    tearDownRing();
+}
+
+AsyncBackend AsyncIOManager::getBackend()
+{
+    return backend;
+}
+
+RC AsyncIOManager::setBackend(AsyncBackend newBackend)
+{
+    unique_lock<mutex> lock(latch);
+    if (newBackend == backend)
+        return SUCCESS;
+    if (!requests.empty())
+        return AIO_IN_USE;
+
+    if (newBackend == AsyncIoUring)
+    {
+        if (setUpRing())
+            return AIO_SETUP_FAILED;
+        lock.unlock();
+        stopWorkers();
+        lock.lock();
+    }
+    else
+    {
+        tearDownRing();
+        startWorkers();
+    }
+    backend = newBackend;
+    return SUCCESS;
+}
+
+RC AsyncIOManager::submitRead(int fd, unsigned pageSize, PageNum pageNum, unsigned count, void *data, IOToken &token)
+{
+    AsyncRequest request;
+    request.fd = fd;
+    request.pageSize = pageSize;
+    request.pageNum = pageNum;
+    request.count = count;
+    request.data = (char*) data;
+    request.write = false;
+    request.verify = false;
+    request.ownsData = false;
+    return submit(request, token);
+}
+
+RC AsyncIOManager::submitVerifiedRead(int fd, unsigned pageSize, PageNum pageNum, unsigned count, void *data, IOToken &token)
+{
+    AsyncRequest request;
+    request.fd = fd;
+    request.pageSize = pageSize;
+    request.pageNum = pageNum;
+    request.count = count;
+    request.data = (char*) data;
+    request.write = false;
+    request.verify = true;
+    request.ownsData = false;
+    return submit(request, token);
+}
+
+RC AsyncIOManager::submitWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, const void *data, IOToken &token)
+{
+    return submitWrite(fd, pageSize, pageNum, count, data, IOCompletion(), token);
+}
+
+RC AsyncIOManager::submitWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, const void *data, const IOCompletion &completion,
+                               IOToken &token)
+{
+    AsyncRequest request;
+    request.fd = fd;
+    request.pageSize = pageSize;
+    request.pageNum = pageNum;
+    request.count = count;
+    request.data = (char*) data;
+    request.write = true;
+    request.verify = false;
+    request.ownsData = false;
+    request.completion = completion;
+    return submit(request, token);
+}
+
+RC AsyncIOManager::submitOwnedWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, char *data, IOToken &token)
+{
+    return submitOwnedWrite(fd, pageSize, pageNum, count, data, IOCompletion(), token);
+}
+
+// The buffer is ours from here on, whether or not the request gets going
+RC AsyncIOManager::submitOwnedWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, char *data, const IOCompletion &completion,
+                                    IOToken &token)
+{
+    AsyncRequest request;
+    request.fd = fd;
+    request.pageSize = pageSize;
+    request.pageNum = pageNum;
+    request.count = count;
+    request.data = data;
+    request.write = true;
+    request.verify = false;
+    request.ownsData = true;
+    request.completion = completion;
+    RC rc = submit(request, token);
+    if (rc)
+        free(data);
+    return rc;
+}
+
+RC AsyncIOManager::submit(AsyncRequest &request, IOToken &token)
+{
+    unique_lock<mutex> lock(latch);
+
+    request.iov.iov_base = request.data;
+    request.iov.iov_len = (size_t) request.count * request.pageSize;
+    request.done = false;
+    request.result = SUCCESS;
+
+    token = nextToken++;
+    AsyncRequest &stored = requests[token] = request;
+
+    if (backend == AsyncIoUring)
+    {
+        // Make room in the rings first: completions are moved into the table as they come in
+        while (inFlight >= AIO_QUEUE_DEPTH)
+            reapRing(true);
+        if (submitToRing(token, stored))
+        {
+            requests.erase(token);
+            return AIO_SUBMIT_FAILED;
+        }
+        inFlight++;
+        return SUCCESS;
+    }
+
+    queue.push_back(token);
+    queued.notify_one();
+    return SUCCESS;
+}
+
+RC AsyncIOManager::poll(IOToken token, bool &done)
+{
+    unique_lock<mutex> lock(latch);
+    return collect(token, lock, false, done);
+}
+
+RC AsyncIOManager::wait(IOToken token)
+{
+    unique_lock<mutex> lock(latch);
+    bool done;
+    return collect(token, lock, true, done);
+}
+
+RC AsyncIOManager::wait(const vector<IOToken> &tokens)
+{
+    RC result = SUCCESS;
+    for (unsigned i = 0; i < tokens.size(); i++)
+    {
+        RC rc = wait(tokens[i]);
+        if (rc && result == SUCCESS)
+            result = rc;
+    }
+    return result;
+}
+
+// Another thread may collect the request meanwhile, so it is looked up again after every wait
+RC AsyncIOManager::settle(IOToken token)
+{
+    unique_lock<mutex> lock(latch);
+    while (true)
+    {
+        unordered_map<IOToken, AsyncRequest>::iterator it = requests.find(token);
+        if (it == requests.end())
+            return AIO_UNKNOWN_TOKEN;
+        if (it->second.done)
+            return SUCCESS;
+        if (backend == AsyncIoUring)
+            reapRing(true);
+        else
+            completed.wait(lock);
+    }
+}
+
+// Hands back the result of a completed request and forgets it. Called with the latch held.
+RC AsyncIOManager::collect(IOToken token, unique_lock<mutex> &lock, bool block, bool &done)
+{
+    unordered_map<IOToken, AsyncRequest>::iterator it = requests.find(token);
+    if (it == requests.end())
+        return AIO_UNKNOWN_TOKEN;
+
+    AsyncRequest &request = it->second;
+    if (backend == AsyncIoUring)
+    {
+        reapRing(false);
+        while (block && !request.done)
+            reapRing(true);
+    }
+    else
+    {
+        while (block && !request.done)
+            completed.wait(lock);
+    }
+
+    done = request.done;
+    if (!done)
+        return SUCCESS;
+
+    // Pages are checked here rather than where they completed, by the thread that asked for them
+    RC result = request.result;
+    if (result == SUCCESS && request.verify)
+    {
+        for (unsigned i = 0; i < request.count && result == SUCCESS; i++)
+        {
+            if (!FileHandle::checksumMatches(request.data + (size_t) i * request.pageSize, request.pageSize))
+                result = AIO_CHECKSUM_FAILED;
+        }
+    }
+    if (request.ownsData)
+        free(request.data);
+    requests.erase(it);
+    return result;
+}
+
+#ifdef AIO_HAVE_IO_URING
+
+static int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+RC AsyncIOManager::setUpRing()
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = ioUringSetup(AIO_QUEUE_DEPTH, &params);
+    if (fd < 0)
+        return AIO_SETUP_FAILED;
+
+    IoUring *r = new IoUring();
+    r->fd = fd;
+    r->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    r->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap)
+        r->sqRingSize = r->cqRingSize = max(r->sqRingSize, r->cqRingSize);
+
+    r->sqRing = mmap(NULL, r->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    r->cqRing = singleMap ? r->sqRing
+        : mmap(NULL, r->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    r->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, r->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (r->sqRing == MAP_FAILED || r->cqRing == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        if (r->sqRing != MAP_FAILED)
+            munmap(r->sqRing, r->sqRingSize);
+        if (!singleMap && r->cqRing != MAP_FAILED)
+            munmap(r->cqRing, r->cqRingSize);
+        if (sqes != MAP_FAILED)
+            munmap(sqes, r->sqesSize);
+        close(fd);
+        delete r;
+        return AIO_SETUP_FAILED;
+    }
+    r->sqes = (struct io_uring_sqe*) sqes;
+
+    char *sq = (char*) r->sqRing;
+    r->sqHead = (unsigned*) (sq + params.sq_off.head);
+    r->sqTail = (unsigned*) (sq + params.sq_off.tail);
+    r->sqMask = (unsigned*) (sq + params.sq_off.ring_mask);
+    r->sqArray = (unsigned*) (sq + params.sq_off.array);
+    r->sqEntries = params.sq_entries;
+
+    char *cq = (char*) r->cqRing;
+    r->cqHead = (unsigned*) (cq + params.cq_off.head);
+    r->cqTail = (unsigned*) (cq + params.cq_off.tail);
+    r->cqMask = (unsigned*) (cq + params.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    ring = r;
+    inFlight = 0;
+    return SUCCESS;
+}
+
+void AsyncIOManager::tearDownRing()
+{
+    if (ring == NULL)
+        return;
+
+    // The kernel may still write into buffers of requests in flight
+    while (inFlight > 0)
+        reapRing(true);
+
+    munmap(ring->sqes, ring->sqesSize);
+    if (ring->cqRing != ring->sqRing)
+        munmap(ring->cqRing, ring->cqRingSize);
+    munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+    delete ring;
+    ring = NULL;
+}
+
+RC AsyncIOManager::submitToRing(IOToken token, AsyncRequest &request)
+{
+    // We are the only producer, so the tail is ours; the head moves as the kernel consumes entries
+    unsigned tail = *ring->sqTail;
+    unsigned head = __atomic_load_n(ring->sqHead, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->sqEntries)
+        return AIO_SUBMIT_FAILED;
+
+    unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request.fd;
+    sqe->off = (uint64_t) request.pageNum * request.pageSize;
+    sqe->addr = (uint64_t) (uintptr_t) &request.iov;
+    sqe->len = 1;
+    sqe->user_data = token;
+
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    do
+        submitted = ioUringEnter(ring->fd, 1, 0, 0);
+    while (submitted < 0 && errno == EINTR);
+    if (submitted != 1)
+    {
+        // Take the entry back, the kernel didn't see it
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+        return AIO_SUBMIT_FAILED;
+    }
+    return SUCCESS;
+}
+
+// Moves completions from the ring into the request table, first waiting for one if asked to
+void AsyncIOManager::reapRing(bool block)
+{
+    if (block && inFlight > 0)
+    {
+        int rc;
+        do
+            rc = ioUringEnter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+        while (rc < 0 && errno == EINTR);
+    }
+
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        unordered_map<IOToken, AsyncRequest>::iterator it = requests.find(cqe->user_data);
+        if (it != requests.end())
+        {
+            AsyncRequest &request = it->second;
+            // A short transfer means the pages aren't all there, as with the synchronous calls
+            bool failed = cqe->res < 0 || (size_t) cqe->res != request.iov.iov_len;
+            request.result = failed ? AIO_IO_FAILED : SUCCESS;
+            request.done = true;
+            if (request.completion)
+                request.completion(request.result);
+        }
+        inFlight--;
+        head++;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+
+#else
+
+RC AsyncIOManager::setUpRing()
+{
+    return AIO_SETUP_FAILED;
+}
+
+void AsyncIOManager::tearDownRing()
+{
+}
+
+RC AsyncIOManager::submitToRing(IOToken token, AsyncRequest &request)
+{
+    return AIO_SUBMIT_FAILED;
+}
+
+void AsyncIOManager::reapRing(bool block)
+{
+}
+
+#endif
+
+void AsyncIOManager::startWorkers()
+{
+    stopping = false;
+    for (unsigned i = 0; i < AIO_THREADS; i++)
+    {
+        try
+        {
+            workers.push_back(thread(&AsyncIOManager::work, this));
+        }
+        catch (const system_error &)
+        {
+            // Fewer workers just means less parallelism, as long as there is one
+            break;
+        }
+    }
+}
+
+void AsyncIOManager::stopWorkers()
+{
+    {
+        unique_lock<mutex> lock(latch);
+        stopping = true;
+    }
+    queued.notify_all();
+    for (unsigned i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+}
+
+// A worker of the thread pool: runs queued requests with ordinary blocking I/O
+void AsyncIOManager::work()
+{
+    unique_lock<mutex> lock(latch);
+    while (true)
+    {
+        while (queue.empty() && !stopping)
+            queued.wait(lock);
+        if (queue.empty())
+            return;
+
+        IOToken token = queue.front();
+        queue.pop_front();
+        // Requests are only forgotten once complete, so this one stays put while we work on it
+        AsyncRequest &request = requests[token];
+        lock.unlock();
+
+        RC rc;
+        if (request.write)
+            rc = FileHandle::writeToFile(request.fd, request.pageSize, request.pageNum, request.count, request.data);
+        else
+            rc = FileHandle::readFromFile(request.fd, request.pageSize, request.pageNum, request.count, request.data);
+
+        lock.lock();
+        request.result = rc ? AIO_IO_FAILED : SUCCESS;
+        request.done = true;
+        if (request.completion)
+            request.completion(request.result);
+        completed.notify_all();
+    }
+}
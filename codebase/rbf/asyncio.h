@@ -0,0 +1,110 @@
+#ifndef _asyncio_h_
+#define _asyncio_h_
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/uio.h>
+#include "pfm.h"
+
+#define AIO_QUEUE_DEPTH 256     // requests in flight at most with io_uring
+#define AIO_THREADS     4       // workers of the thread-pool backend
+
+#define AIO_SETUP_FAILED    1
+#define AIO_SUBMIT_FAILED   2
+#define AIO_IO_FAILED       3
+#define AIO_UNKNOWN_TOKEN   4
+#define AIO_IN_USE          5
+#define AIO_CHECKSUM_FAILED 6
+
+using namespace std;
+
+typedef enum { AsyncIoUring = 0, AsyncThreadPool } AsyncBackend;
+
+// Run with the result of a request as it completes, before the request is collected. It runs with the
+// manager's latch held, so it may take other latches but must not call back into the manager.
+typedef function<void(RC)> IOCompletion;
+
+typedef struct AsyncRequest
+{
+    int fd;
+    unsigned pageSize;
+    PageNum pageNum;        // physical page the transfer starts at
+    unsigned count;
+    char *data;
+    bool write;
+    bool verify;            // read: check the checksum of every page once it is in
+    bool ownsData;          // write: data is a copy of our own, freed once the request is collected
+    IOCompletion completion;    // if set, run as the request completes
+    struct iovec iov;       // what io_uring reads into or writes from
+    bool done;
+    RC result;
+} AsyncRequest;
+
+struct IoUring;
+
+// AsyncIOManager runs page reads and writes in the background. Submitting returns a token
+// right away; the caller polls or waits for it, one token or a batch at a time.
+// Requests go to io_uring where the kernel offers it, and to a pool of worker threads otherwise.
+//
+// The caller's buffer must stay valid, and be left alone, until the request has completed.
+class AsyncIOManager
+{
+public:
+	static AsyncIOManager* instance();                                                             // Access to the _aio_manager instance
+
+	RC submitRead(int fd, unsigned pageSize, PageNum pageNum, unsigned count, void *data, IOToken &token);            // Start reading count physical pages
+	RC submitWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, const void *data, IOToken &token);     // Start writing count physical pages
+	RC submitVerifiedRead(int fd, unsigned pageSize, PageNum pageNum, unsigned count, void *data, IOToken &token);    // Start reading count data pages that carry checksums
+	RC submitOwnedWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, char *data, IOToken &token);      // Start writing a buffer from malloc, which is freed once written
+	RC submitWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, const void *data, const IOCompletion &completion, IOToken &token);
+	RC submitOwnedWrite(int fd, unsigned pageSize, PageNum pageNum, unsigned count, char *data, const IOCompletion &completion, IOToken &token);
+	RC poll(IOToken token, bool &done);              // Whether a request has completed; once it has, returns its result and forgets it
+	RC wait(IOToken token);                          // Wait for a request to complete and return its result
+	RC wait(const vector<IOToken> &tokens);          // Wait for every request of a batch; returns the first failure, if any
+	RC settle(IOToken token);                        // Wait for a request to complete, leaving it to be collected
+
+	AsyncBackend getBackend();
+	RC setBackend(AsyncBackend backend);             // Switch backends; only while nothing is in flight
+
+protected:
+	AsyncIOManager();
+	~AsyncIOManager();
+
+private:
+	static AsyncIOManager *_aio_manager;
+
+	AsyncBackend backend;
+	IOToken nextToken;
+	unordered_map<IOToken, AsyncRequest> requests;   // submitted and not yet collected by poll or wait
+	mutex latch;
+
+	// io_uring
+	IoUring *ring;
+	unsigned inFlight;
+
+	// Thread pool
+	vector<thread> workers;
+	deque<IOToken> queue;
+	condition_variable queued;
+	condition_variable completed;
+	bool stopping;
+
+	RC submit(AsyncRequest &request, IOToken &token);
+	RC collect(IOToken token, unique_lock<mutex> &lock, bool block, bool &done);
+
+	RC setUpRing();
+	void tearDownRing();
+	RC submitToRing(IOToken token, AsyncRequest &request);
+	void reapRing(bool block);
+
+	void startWorkers();
+	void stopWorkers();
+	void work();
+};
+
+#endif
@@ -0,0 +1,1118 @@
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+
+#include "bpm.h"
+#include "asyncio.h"
+
+size_t PageIdHash::operator()(const PageId &pageId) const
+{
+    // Mix the three components; inodes and page numbers are both small and dense
+    size_t h = hash<uint64_t>()(pageId.fileId.inode);
+    h ^= hash<uint64_t>()(pageId.fileId.device) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= hash<uint32_t>()(pageId.pageNum) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+}
+
+bool PageIdEqual::operator()(const PageId &a, const PageId &b) const
+{
+    return a.pageNum == b.pageNum
+        && a.fileId.inode == b.fileId.inode
+        && a.fileId.device == b.fileId.device;
+}
+
+static bool sameFile(const FileId &a, const FileId &b)
+{
+    return a.inode == b.inode && a.device == b.device;
+}
+
+BufferPoolManager* BufferPoolManager::_bp_manager = NULL;
+
+BufferPoolManager* BufferPoolManager::instance()
+{
+    static once_flag created;
+    call_once(created, [] { _bp_manager = new BufferPoolManager(); });
+
+    return _bp_manager;
+}
+
+BufferPoolManager::BufferPoolManager()
+{
+    clockHand = 0;
+    policy = ReplaceClock;
+    accessClock = 0;
+    dirtyFrames = 0;
+    writingFrames = 0;
+    pagesWritten = 0;
+    pagesRead = 0;
+    lastTicket = 0;
+    flusherRunning = false;
+    stopping = false;
+    staging = NULL;
+    allocateFrames(BPM_DEFAULT_FRAMES);
+}
+
+BufferPoolManager::~BufferPoolManager()
+{
+    if (flusherRunning)
+    {
+        {
+            unique_lock<mutex> lock(latch);
+            stopping = true;
+        }
+        flushNeeded.notify_one();
+        flusher.join();
+    }
+    free(staging);
+    freeFrames();
+}
+
+RC BufferPoolManager::allocateFrames(unsigned frameCount)
+{
+    frames.resize(frameCount);
+    for (unsigned i = 0; i < frameCount; i++)
+    {
+        Frame &frame = frames[i];
+        // Frames are page aligned so they can be handed straight to the OS, even for O_DIRECT
+        void *data = NULL;
+        if (posix_memalign(&data, PAGE_SIZE, PAGE_SIZE) != 0)
+        {
+            frames.resize(i);
+            resetPolicy();
+            return BPM_MALLOC_FAILED;
+        }
+        frame.data = (char*) data;
+        frame.capacity = PAGE_SIZE;
+        frame.pageSize = PAGE_SIZE;
+        frame.pageLatch = new shared_mutex();
+        frame.fd = -1;
+        frame.pinCount = 0;
+        frame.dirty = false;
+        frame.writing = false;
+        frame.asyncTicket = 0;
+        frame.asyncToken = 0;
+        frame.loading = false;
+        frame.referenced = false;
+        frame.valid = false;
+        frame.orphaned = false;
+        frame.lastUse = 0;
+        frame.prevUse = 0;
+        frame.onList = ListNone;
+    }
+    resetPolicy();
+    return SUCCESS;
+}
+
+void BufferPoolManager::freeFrames()
+{
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        free(frames[i].data);
+        delete frames[i].pageLatch;
+    }
+    frames.clear();
+    pageTable.clear();
+    dirtyFrames = 0;
+}
+
+RC BufferPoolManager::setCapacity(unsigned frameCount)
+{
+    if (frameCount == 0)
+        return BPM_NO_FREE_FRAME;
+
+    unique_lock<mutex> lock(latch);
+    waitForWrites(lock, NULL);
+
+    // Everything has to be written back before the frames go away
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].pinCount > 0)
+            return BPM_POOL_IN_USE;
+    }
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].valid && frames[i].dirty)
+        {
+            RC rc = writeBack(frames[i]);
+            if (rc)
+                return rc;
+        }
+    }
+
+    freeFrames();
+    return allocateFrames(frameCount);
+}
+
+unsigned BufferPoolManager::getCapacity()
+{
+    unique_lock<mutex> lock(latch);
+    return frames.size();
+}
+
+uint64_t BufferPoolManager::getPagesWritten()
+{
+    unique_lock<mutex> lock(latch);
+    return pagesWritten;
+}
+
+uint64_t BufferPoolManager::getPagesRead()
+{
+    unique_lock<mutex> lock(latch);
+    return pagesRead;
+}
+
+void BufferPoolManager::setPolicy(ReplacementPolicy newPolicy)
+{
+    unique_lock<mutex> lock(latch);
+    if (newPolicy == policy)
+        return;
+    policy = newPolicy;
+    resetPolicy();
+}
+
+ReplacementPolicy BufferPoolManager::getPolicy()
+{
+    unique_lock<mutex> lock(latch);
+    return policy;
+}
+
+// Forgets every page's history: the cached pages start over as if each had been read once
+void BufferPoolManager::resetPolicy()
+{
+    a1in.clear();
+    am.clear();
+    ring.clear();
+    ghosts.clear();
+    ghostTable.clear();
+    freeList.clear();
+    accessClock = 0;
+    clockHand = 0;
+    for (unsigned i = frames.size(); i > 0; i--)
+    {
+        frames[i - 1].onList = ListNone;
+        if (frames[i - 1].valid)
+            admit(i - 1, false);
+        else
+            freeList.push_back(i - 1);
+    }
+}
+
+void BufferPoolManager::setDirty(Frame &frame, bool dirty)
+{
+    if (dirty && !frame.dirty)
+        dirtyFrames++;
+    else if (!dirty && frame.dirty)
+        dirtyFrames--;
+    frame.dirty = dirty;
+}
+
+// Waits for the write a frame is marked writing for to complete, or for any write to. io_uring
+// reports an asynchronous write complete only to whoever asks, so one already submitted is
+// settled through the async manager, with the pool latch let go.
+void BufferPoolManager::awaitWrite(unique_lock<mutex> &lock, unsigned frameIndex)
+{
+    IOToken token = frames[frameIndex].asyncToken;
+    if (token == 0)
+    {
+        writesDone.wait(lock);
+        return;
+    }
+    lock.unlock();
+    AsyncIOManager::instance()->settle(token);
+    lock.lock();
+}
+
+// Waits for one write in flight, of one file or of any, preferring an asynchronous one to settle;
+// false if there is none
+bool BufferPoolManager::waitForWrite(unique_lock<mutex> &lock, const FileId *fileId)
+{
+    int busy = -1;
+    for (unsigned i = 0; i < frames.size() && writingFrames > 0; i++)
+    {
+        if (frames[i].writing && (fileId == NULL || sameFile(frames[i].pageId.fileId, *fileId)))
+        {
+            busy = i;
+            if (frames[i].asyncToken != 0)
+                break;
+        }
+    }
+    if (busy < 0)
+        return false;
+    awaitWrite(lock, busy);
+    return true;
+}
+
+// Waits until no write is in flight, for one file or for any
+void BufferPoolManager::waitForWrites(unique_lock<mutex> &lock, const FileId *fileId)
+{
+    while (waitForWrite(lock, fileId))
+        ;
+}
+
+RC BufferPoolManager::writeBack(Frame &frame)
+{
+    RC rc = FileHandle::writeToFile(frame.fd, frame.pageSize, frame.pageId.pageNum, frame.data);
+    if (rc)
+        return rc;
+    setDirty(frame, false);
+    pagesWritten++;
+    return SUCCESS;
+}
+
+bool BufferPoolManager::evictable(const Frame &frame)
+{
+    // A page on its way to disk must stay, or a read could find the old version there
+    return frame.valid && frame.pinCount == 0 && !frame.writing;
+}
+
+// Takes a frame off whichever list it is on
+void BufferPoolManager::unlink(unsigned frameIndex)
+{
+    Frame &frame = frames[frameIndex];
+    if (frame.onList == ListA1in)
+        a1in.erase(frame.position);
+    else if (frame.onList == ListAm)
+        am.erase(frame.position);
+    else if (frame.onList == ListRing)
+        ring.erase(frame.position);
+    frame.onList = ListNone;
+}
+
+// Keeps the page of a frame about to be evicted as a ghost. 2Q remembers the pages that left A1in,
+// so one coming back soon goes straight to Am; LRU-K remembers every page's last access, so one
+// coming back soon has two. Pages of a sequential reader are never remembered.
+void BufferPoolManager::remember(const Frame &frame)
+{
+    if (policy == ReplaceClock || frame.onList == ListRing)
+        return;
+    if (policy == Replace2Q && frame.onList != ListA1in)
+        return;
+
+    Ghost ghost;
+    ghost.pageId = frame.pageId;
+    ghost.lastUse = frame.lastUse;
+    ghostTable[frame.pageId] = ghosts.insert(ghosts.end(), ghost);
+
+    unsigned capacity = max((unsigned) frames.size() / 2, 1u);
+    while (ghosts.size() > capacity)
+    {
+        ghostTable.erase(ghosts.front().pageId);
+        ghosts.pop_front();
+    }
+}
+
+// Puts a page just read into a frame under the policy
+void BufferPoolManager::admit(unsigned frameIndex, bool sequential)
+{
+    Frame &frame = frames[frameIndex];
+    if (sequential)
+    {
+        frame.referenced = false;
+        frame.lastUse = ++accessClock;
+        frame.prevUse = 0;
+        frame.onList = ListRing;
+        frame.position = ring.insert(ring.end(), frameIndex);
+        return;
+    }
+
+    frame.referenced = true;
+    frame.prevUse = 0;
+    bool seen = false;
+    unordered_map<PageId, list<Ghost>::iterator, PageIdHash, PageIdEqual>::iterator it = ghostTable.find(frame.pageId);
+    if (it != ghostTable.end())
+    {
+        frame.prevUse = it->second->lastUse;
+        ghosts.erase(it->second);
+        ghostTable.erase(it);
+        seen = true;
+    }
+    frame.lastUse = ++accessClock;
+
+    if (policy == Replace2Q)
+    {
+        if (seen)
+        {
+            frame.onList = ListAm;
+            frame.position = am.insert(am.end(), frameIndex);
+        }
+        else
+        {
+            frame.onList = ListA1in;
+            frame.position = a1in.insert(a1in.end(), frameIndex);
+        }
+    }
+}
+
+// Records a hit on a cached page
+void BufferPoolManager::touch(unsigned frameIndex, bool sequential)
+{
+    Frame &frame = frames[frameIndex];
+    if (frame.onList == ListRing)
+    {
+        // Wanted by someone other than a sequential reader: the page joins the pool proper
+        if (!sequential)
+        {
+            unlink(frameIndex);
+            admit(frameIndex, false);
+        }
+        return;
+    }
+
+    frame.referenced = true;
+    frame.prevUse = frame.lastUse;
+    frame.lastUse = ++accessClock;
+
+    // A second use moves a page from A1in to Am, as in simplified 2Q, and a use in Am makes it
+    // the most recent there
+    if (policy == Replace2Q)
+    {
+        unlink(frameIndex);
+        frame.onList = ListAm;
+        frame.position = am.insert(am.end(), frameIndex);
+    }
+}
+
+// The first frame of a list, oldest first, that can be evicted
+bool BufferPoolManager::victimFromList(list<unsigned> &frameList, unsigned &frameIndex)
+{
+    for (list<unsigned>::iterator it = frameList.begin(); it != frameList.end(); ++it)
+    {
+        if (evictable(frames[*it]))
+        {
+            frameIndex = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+// CLOCK: sweep the frames, giving every referenced frame a second chance.
+// Two full sweeps without finding an unpinned frame means the pool is exhausted.
+bool BufferPoolManager::clockVictim(unsigned &frameIndex)
+{
+    unsigned frameCount = frames.size();
+    for (unsigned step = 0; step < 2 * frameCount; step++)
+    {
+        Frame &frame = frames[clockHand];
+        unsigned current = clockHand;
+        clockHand = (clockHand + 1) % frameCount;
+
+        if (!evictable(frame))
+            continue;
+        if (frame.referenced)
+        {
+            frame.referenced = false;
+            continue;
+        }
+        frameIndex = current;
+        return true;
+    }
+    return false;
+}
+
+// LRU-2: the page whose second most recent access is the oldest. Pages used only once have
+// no second access and go first, least recently used first. Ring frames are looked at separately.
+bool BufferPoolManager::lruKVictim(unsigned &frameIndex, bool fromRing)
+{
+    bool found = false;
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        const Frame &frame = frames[i];
+        if (!evictable(frame) || (frame.onList == ListRing) != fromRing)
+            continue;
+        if (!found || frame.prevUse < frames[frameIndex].prevUse
+            || (frame.prevUse == frames[frameIndex].prevUse && frame.lastUse < frames[frameIndex].lastUse))
+        {
+            frameIndex = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Empties a frame whose page is clean
+void BufferPoolManager::evict(unsigned frameIndex)
+{
+    Frame &frame = frames[frameIndex];
+    remember(frame);
+    unlink(frameIndex);
+    pageTable.erase(frame.pageId);
+    frame.valid = false;
+    frame.referenced = false;
+}
+
+// The frame the policy would empty next, or an empty one
+RC BufferPoolManager::pickVictim(unsigned &frameIndex, bool sequential, bool &evicted)
+{
+    // Once a sequential reader has its ring, it recycles the ring's frames and nothing else
+    evicted = true;
+    if (sequential && ring.size() >= BPM_RING_FRAMES && victimFromList(ring, frameIndex))
+        return SUCCESS;
+
+    evicted = false;
+    if (!freeList.empty())
+    {
+        frameIndex = freeList.back();
+        freeList.pop_back();
+        return SUCCESS;
+    }
+
+    bool found;
+    if (policy == Replace2Q)
+    {
+        // A1in is held to a quarter of the pool; past that its oldest page goes before anything in Am
+        if (a1in.size() > max((unsigned) frames.size() / 4, 1u))
+            found = victimFromList(a1in, frameIndex) || victimFromList(am, frameIndex);
+        else
+            found = victimFromList(am, frameIndex) || victimFromList(a1in, frameIndex);
+        found = found || victimFromList(ring, frameIndex);
+    }
+    else if (policy == ReplaceLRUK)
+        found = lruKVictim(frameIndex, false) || lruKVictim(frameIndex, true);
+    else
+        found = clockVictim(frameIndex);
+
+    if (!found)
+        return BPM_NO_FREE_FRAME;
+    evicted = true;
+    return SUCCESS;
+}
+
+// Finds an empty frame, evicting a page if there is none. A dirty victim is written back with the
+// pool latch let go; it may be pinned again meanwhile, so the victim is picked over once it is clean.
+RC BufferPoolManager::findVictim(unique_lock<mutex> &lock, unsigned &frameIndex, bool sequential, bool &evicted)
+{
+    while (true)
+    {
+        RC rc = pickVictim(frameIndex, sequential, evicted);
+        if (rc || !evicted)
+            return rc;
+        if (!frames[frameIndex].dirty)
+        {
+            evict(frameIndex);
+            return SUCCESS;
+        }
+        rc = writeBackUnlatched(lock, frameIndex);
+        if (rc)
+            return rc;
+    }
+}
+
+// Lets go of the pin of a frame whose page could not be read; the last one out frees the frame
+void BufferPoolManager::release(unsigned frameIndex)
+{
+    Frame &frame = frames[frameIndex];
+    frame.pinCount--;
+    if (frame.pinCount == 0)
+        freeList.push_back(frameIndex);
+}
+
+static void lockPage(shared_mutex *pageLatch, LatchMode mode)
+{
+    if (mode == LatchShared)
+        pageLatch->lock_shared();
+    else if (mode == LatchExclusive)
+        pageLatch->lock();
+}
+
+static void unlockPage(shared_mutex *pageLatch, LatchMode mode)
+{
+    if (mode == LatchShared)
+        pageLatch->unlock_shared();
+    else if (mode == LatchExclusive)
+        pageLatch->unlock();
+}
+
+// A page dropped by discardFile while pinned is no longer in the page table; its frame is
+// found by the page it held, and freed once the last pin on it goes
+RC BufferPoolManager::unpinOrphan(const PageId &pageId, LatchMode mode)
+{
+    PageIdEqual samePage;
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        Frame &frame = frames[i];
+        if (frame.orphaned && frame.pinCount > 0 && samePage(frame.pageId, pageId))
+        {
+            unlockPage(frame.pageLatch, mode);
+            if (frame.pinCount == 1)
+                frame.orphaned = false;
+            release(i);
+            return SUCCESS;
+        }
+    }
+    return BPM_PAGE_NOT_PINNED;
+}
+
+// The page latch is taken once the pool latch is let go; the pin keeps the page in its frame meanwhile
+RC BufferPoolManager::pinPage(FileHandle &fileHandle, PageNum pageNum, bool readFromDisk, void *&page, LatchMode mode)
+{
+    PageId pageId;
+    pageId.fileId = fileHandle._fileId;
+    pageId.pageNum = pageNum;
+
+    bool sequential = fileHandle._accessPattern == AccessSequential;
+
+    unique_lock<mutex> lock(latch);
+    while (true)
+    {
+        // Hit: the page is already in a frame
+        unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+        if (it != pageTable.end())
+        {
+            unsigned frameIndex = it->second;
+            Frame &frame = frames[frameIndex];
+            frame.pinCount++;
+            touch(frameIndex, sequential);
+            fileHandle.countPoolAccess(true, false);
+            bool loading = frame.loading;
+            shared_mutex *pageLatch = frame.pageLatch;
+            lock.unlock();
+            if (!loading)
+            {
+                lockPage(pageLatch, mode);
+                page = frame.data;
+                return SUCCESS;
+            }
+
+            // Someone else is reading the page in and holds its latch until it is there
+            LatchMode waitMode = mode == LatchNone ? LatchShared : mode;
+            lockPage(pageLatch, waitMode);
+            lock.lock();
+            if (frame.valid)
+            {
+                lock.unlock();
+                if (mode == LatchNone)
+                    pageLatch->unlock_shared();
+                page = frame.data;
+                return SUCCESS;
+            }
+
+            // The read failed; this thread tries for itself
+            unlockPage(pageLatch, waitMode);
+            release(frameIndex);
+            continue;
+        }
+
+        // Miss: grab a frame and load the page into it.
+        // Frames held by the flusher come free once its writes are done.
+        unsigned frameIndex;
+        bool evicted;
+        RC rc = findVictim(lock, frameIndex, sequential, evicted);
+        while (rc == BPM_NO_FREE_FRAME && waitForWrite(lock, NULL))
+            rc = findVictim(lock, frameIndex, sequential, evicted);
+        if (rc)
+            return rc;
+
+        // Writing the victim back let go of the pool latch, and the page may have come in meanwhile
+        if (pageTable.find(pageId) != pageTable.end())
+        {
+            freeList.push_back(frameIndex);
+            continue;
+        }
+        fileHandle.countPoolAccess(false, evicted);
+
+        // A page larger than any the frame has held so far needs a larger buffer
+        Frame &frame = frames[frameIndex];
+        if (frame.capacity < fileHandle._pageSize)
+        {
+            void *data = NULL;
+            if (posix_memalign(&data, PAGE_SIZE, fileHandle._pageSize) != 0)
+            {
+                freeList.push_back(frameIndex);
+                return BPM_MALLOC_FAILED;
+            }
+            free(frame.data);
+            frame.data = (char*) data;
+            frame.capacity = fileHandle._pageSize;
+        }
+        frame.pageSize = fileHandle._pageSize;
+
+        frame.pageId = pageId;
+        frame.fd = fileHandle._fd;
+        frame.pinCount = 1;
+        frame.dirty = false;
+        frame.writing = false;
+        frame.loading = readFromDisk;
+        frame.valid = true;
+        admit(frameIndex, sequential);
+        pageTable[pageId] = frameIndex;
+
+        page = frame.data;
+        shared_mutex *pageLatch = frame.pageLatch;
+        if (!readFromDisk)
+        {
+            lock.unlock();
+            lockPage(pageLatch, mode);
+            return SUCCESS;
+        }
+
+        // Nobody else had the frame pinned, so its latch is free: trying for it never waits under the pool latch
+        if (!pageLatch->try_lock())
+            rc = BPM_PAGE_PINNED;
+        else
+        {
+            lock.unlock();
+            rc = FileHandle::readFromFile(fileHandle._fd, frame.pageSize, pageNum, frame.data);
+            if (rc == SUCCESS && fileHandle._checksums && fileHandle._options.verifyChecksums && fileHandle.isDataLocation(pageNum)
+                    && !FileHandle::checksumMatches(frame.data, frame.pageSize))
+                rc = BPM_CHECKSUM_FAILED;
+            lock.lock();
+        }
+
+        frame.loading = false;
+        writesDone.notify_all();
+        if (rc)
+        {
+            // Anyone waiting on the latch finds the frame empty
+            unlink(frameIndex);
+            pageTable.erase(pageId);
+            frame.valid = false;
+            frame.referenced = false;
+            release(frameIndex);
+            if (rc != BPM_PAGE_PINNED)
+                pageLatch->unlock();
+            return rc;
+        }
+        pagesRead++;
+        lock.unlock();
+
+        if (mode != LatchExclusive)
+        {
+            pageLatch->unlock();
+            lockPage(pageLatch, mode);
+        }
+        return SUCCESS;
+    }
+}
+
+RC BufferPoolManager::unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty, LatchMode mode)
+{
+    PageId pageId;
+    pageId.fileId = fileHandle._fileId;
+    pageId.pageNum = pageNum;
+
+    unique_lock<mutex> lock(latch);
+
+    unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+    if (it == pageTable.end())
+        return unpinOrphan(pageId, mode);
+
+    Frame &frame = frames[it->second];
+    if (frame.pinCount == 0)
+        return BPM_PAGE_NOT_PINNED;
+
+    // Letting go of a latch never waits, so it is fine under the pool latch
+    unlockPage(frame.pageLatch, mode);
+    frame.pinCount--;
+    if (dirty)
+    {
+        // The page is written back through whichever handle modified it last
+        setDirty(frame, true);
+        frame.fd = fileHandle._fd;
+    }
+
+    if (flusherRunning && dirty)
+    {
+        // Wake the flusher early once a quarter of the pool is dirty, and hold the writer back
+        // at half, until the flusher catches up or shows it can't (everything left is pinned)
+        unsigned capacity = frames.size();
+        if (dirtyFrames >= capacity / 4)
+            flushNeeded.notify_one();
+        while (dirtyFrames >= capacity / 2)
+        {
+            if (writesDone.wait_for(lock, chrono::milliseconds(BPM_FLUSH_INTERVAL_MS)) == cv_status::timeout)
+                break;
+        }
+    }
+    return SUCCESS;
+}
+
+RC BufferPoolManager::flushPage(FileHandle &fileHandle, PageNum pageNum)
+{
+    PageId pageId;
+    pageId.fileId = fileHandle._fileId;
+    pageId.pageNum = pageNum;
+
+    unique_lock<mutex> lock(latch);
+
+    unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+    // Callers flush to make the file current, so a write the flusher has in flight has to land first
+    while (it != pageTable.end() && frames[it->second].writing)
+    {
+        awaitWrite(lock, it->second);
+        it = pageTable.find(pageId);
+    }
+    if (it == pageTable.end())
+        return SUCCESS;
+
+    if (!frames[it->second].dirty)
+        return SUCCESS;
+    return writeBackUnlatched(lock, it->second);
+}
+
+// Writes a dirty page back with the pool latch let go. One more pin keeps the page in its frame,
+// being marked writing keeps evictions, flushes and discards of it waiting, and a shared page
+// latch keeps it from changing meanwhile. It is marked clean before that latch goes, so a change
+// made right after is not lost.
+RC BufferPoolManager::writeBackUnlatched(unique_lock<mutex> &lock, unsigned frameIndex)
+{
+    Frame &frame = frames[frameIndex];
+    frame.pinCount++;
+    frame.writing = true;
+    writingFrames++;
+    int fd = frame.fd;
+    unsigned pageSize = frame.pageSize;
+    PageNum pageNum = frame.pageId.pageNum;
+    lock.unlock();
+
+    frame.pageLatch->lock_shared();
+    RC rc = FileHandle::writeToFile(fd, pageSize, pageNum, frame.data);
+    lock.lock();
+    if (rc == SUCCESS)
+    {
+        setDirty(frame, false);
+        pagesWritten++;
+    }
+    frame.pageLatch->unlock_shared();
+
+    frame.writing = false;
+    writingFrames--;
+    frame.pinCount--;
+    writesDone.notify_all();
+    return rc;
+}
+
+// All the unpinned dirty pages of the file are written back at once, so the device sees a deep queue.
+// Like writeBackUnlatched, each frame is pinned, marked writing and latched shared first, so the
+// pool latch can be let go while the writes are in flight. Pinned pages follow one at a time,
+// each once it can be latched.
+RC BufferPoolManager::flushFile(FileHandle &fileHandle)
+{
+    unique_lock<mutex> lock(latch);
+    waitForWrites(lock, &fileHandle._fileId);
+
+    vector<unsigned> flushed;
+    vector<unsigned> pinned;
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        Frame &frame = frames[i];
+        if (frame.valid && frame.dirty && sameFile(frame.pageId.fileId, fileHandle._fileId))
+        {
+            // An unpinned page's latch is free, unless a holder is just now letting it go
+            if (frame.pinCount > 0 || !frame.pageLatch->try_lock_shared())
+            {
+                pinned.push_back(i);
+                continue;
+            }
+            frame.pinCount++;
+            frame.writing = true;
+            writingFrames++;
+            flushed.push_back(i);
+        }
+    }
+    lock.unlock();
+
+    AsyncIOManager *aio = AsyncIOManager::instance();
+    vector<IOToken> tokens;
+    RC rc = SUCCESS;
+    for (unsigned i = 0; i < flushed.size(); i++)
+    {
+        Frame &frame = frames[flushed[i]];
+        IOToken token;
+        rc = aio->submitWrite(frame.fd, frame.pageSize, frame.pageId.pageNum, 1, frame.data, token);
+        if (rc)
+            break;
+        tokens.push_back(token);
+    }
+    vector<RC> results(tokens.size());
+    for (unsigned i = 0; i < tokens.size(); i++)
+    {
+        results[i] = aio->wait(tokens[i]);
+    }
+
+    // Only pages known to be written are clean
+    lock.lock();
+    for (unsigned i = 0; i < flushed.size(); i++)
+    {
+        Frame &frame = frames[flushed[i]];
+        if (i < results.size() && results[i] == SUCCESS)
+        {
+            setDirty(frame, false);
+            pagesWritten++;
+        }
+        else if (rc == SUCCESS)
+            rc = FH_WRITE_FAILED;
+        frame.pageLatch->unlock_shared();
+        frame.writing = false;
+        writingFrames--;
+        frame.pinCount--;
+    }
+    writesDone.notify_all();
+
+    for (unsigned i = 0; i < pinned.size() && rc == SUCCESS; i++)
+    {
+        // The page may have changed hands while the latch was let go for the one before
+        Frame &frame = frames[pinned[i]];
+        while (frame.writing)
+            awaitWrite(lock, pinned[i]);
+        if (!frame.valid || !frame.dirty || !sameFile(frame.pageId.fileId, fileHandle._fileId))
+            continue;
+        rc = writeBackUnlatched(lock, pinned[i]);
+    }
+    return rc;
+}
+
+RC BufferPoolManager::discardPage(FileHandle &fileHandle, PageNum pageNum)
+{
+    PageId pageId;
+    pageId.fileId = fileHandle._fileId;
+    pageId.pageNum = pageNum;
+
+    unique_lock<mutex> lock(latch);
+
+    unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+    while (it != pageTable.end() && frames[it->second].writing)
+    {
+        awaitWrite(lock, it->second);
+        it = pageTable.find(pageId);
+    }
+    if (it == pageTable.end())
+        return SUCCESS;
+
+    Frame &frame = frames[it->second];
+    if (frame.pinCount > 0)
+        return BPM_PAGE_PINNED;
+
+    unsigned frameIndex = it->second;
+    pageTable.erase(it);
+    setDirty(frame, false);
+    unlink(frameIndex);
+    frame.valid = false;
+    frame.referenced = false;
+    freeList.push_back(frameIndex);
+    return SUCCESS;
+}
+
+RC BufferPoolManager::beginAsyncWrite(const PageId &pageId, uint64_t &ticket, bool &busy)
+{
+    unique_lock<mutex> lock(latch);
+
+    unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+    if (it == pageTable.end() || frames[it->second].pinCount == 0)
+        return BPM_PAGE_NOT_PINNED;
+
+    // A write in flight may be one waiting for the caller's latch, so it can't be waited for here
+    Frame &frame = frames[it->second];
+    busy = frame.writing;
+    if (busy)
+        return SUCCESS;
+
+    // The frame holds what the write takes to disk, so it is clean once the write is in
+    ticket = ++lastTicket;
+    frame.asyncTicket = ticket;
+    frame.asyncToken = 0;
+    frame.writing = true;
+    writingFrames++;
+    setDirty(frame, false);
+    frame.pageLatch->unlock();
+    return SUCCESS;
+}
+
+// The write may already be complete, and the frame handed to another one
+void BufferPoolManager::asyncWriteSubmitted(const PageId &pageId, uint64_t ticket, IOToken token)
+{
+    unique_lock<mutex> lock(latch);
+
+    unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+    if (it == pageTable.end() || frames[it->second].asyncTicket != ticket)
+        return;
+    frames[it->second].asyncToken = token;
+    writesDone.notify_all();
+}
+
+// Called by the async manager with its latch held. A failed write leaves the page dirty,
+// for eviction, sync or close to write again and report.
+void BufferPoolManager::endAsyncWrite(const PageId &pageId, uint64_t ticket, RC result)
+{
+    unique_lock<mutex> lock(latch);
+
+    unordered_map<PageId, unsigned, PageIdHash, PageIdEqual>::iterator it = pageTable.find(pageId);
+    if (it == pageTable.end() || frames[it->second].asyncTicket != ticket)
+        return;
+    Frame &frame = frames[it->second];
+    frame.asyncTicket = 0;
+    frame.asyncToken = 0;
+    frame.writing = false;
+    writingFrames--;
+    frame.pinCount--;
+    if (result)
+        setDirty(frame, true);
+    writesDone.notify_all();
+}
+
+void BufferPoolManager::discardFile(const FileId &fileId)
+{
+    unique_lock<mutex> lock(latch);
+
+    // Pages of the file on their way in or out have to get there first
+    bool busy = true;
+    while (busy)
+    {
+        waitForWrites(lock, &fileId);
+        busy = false;
+        for (unsigned i = 0; i < frames.size() && !busy; i++)
+            busy = frames[i].loading && sameFile(frames[i].pageId.fileId, fileId);
+        if (busy)
+            writesDone.wait(lock);
+    }
+
+    for (unsigned i = 0; i < frames.size(); i++)
+    {
+        Frame &frame = frames[i];
+        if (frame.valid && sameFile(frame.pageId.fileId, fileId))
+        {
+            pageTable.erase(frame.pageId);
+            setDirty(frame, false);
+            unlink(i);
+            frame.valid = false;
+            frame.referenced = false;
+            // Whoever still has the page pinned holds its latch, so the frame is only reused once they let go
+            if (frame.pinCount > 0)
+                frame.orphaned = true;
+            else
+                freeList.push_back(i);
+        }
+    }
+}
+
+void BufferPoolManager::startFlusher()
+{
+    unique_lock<mutex> lock(latch);
+    if (flusherRunning)
+        return;
+
+    if (staging == NULL)
+    {
+        void *buffer = NULL;
+        if (posix_memalign(&buffer, PAGE_SIZE, (size_t) BPM_FLUSH_BATCH * PAGE_SIZE) != 0)
+            return;
+        staging = (char*) buffer;
+    }
+
+    // Without the thread, dirty pages are still written on eviction, sync and close
+    try
+    {
+        flusher = thread(&BufferPoolManager::flushDirtyPages, this);
+    }
+    catch (const system_error &)
+    {
+        return;
+    }
+    flusherRunning = true;
+}
+
+struct FlushOrder
+{
+    const vector<Frame> &frames;
+    FlushOrder(const vector<Frame> &frames) : frames(frames) {}
+    bool operator()(unsigned a, unsigned b) const
+    {
+        const PageId &x = frames[a].pageId;
+        const PageId &y = frames[b].pageId;
+        if (x.fileId.device != y.fileId.device)
+            return x.fileId.device < y.fileId.device;
+        if (x.fileId.inode != y.fileId.inode)
+            return x.fileId.inode < y.fileId.inode;
+        return x.pageNum < y.pageNum;
+    }
+};
+
+// The flusher thread. Each round takes the dirty pages nobody has pinned, copies them out,
+// and writes them in file and page order, one write per run of adjacent pages.
+// However often a page was modified since the last round, it is written once.
+void BufferPoolManager::flushDirtyPages()
+{
+    unique_lock<mutex> lock(latch);
+    while (!stopping)
+    {
+        if (dirtyFrames < frames.size() / 4)
+            flushNeeded.wait_for(lock, chrono::milliseconds(BPM_FLUSH_INTERVAL_MS));
+        if (stopping)
+            break;
+
+        // As many pages as fit in the staging buffer
+        vector<unsigned> batch;
+        size_t batchBytes = 0;
+        for (unsigned i = 0; i < frames.size(); i++)
+        {
+            Frame &frame = frames[i];
+            if (frame.valid && frame.dirty && frame.pinCount == 0 && !frame.writing)
+            {
+                if (batchBytes + frame.pageSize > (size_t) BPM_FLUSH_BATCH * PAGE_SIZE)
+                    break;
+                batch.push_back(i);
+                batchBytes += frame.pageSize;
+            }
+        }
+        if (batch.empty())
+            continue;
+        sort(batch.begin(), batch.end(), FlushOrder(frames));
+
+        // The copies are what gets written, so the pages can be pinned and changed again right away;
+        // a page changed meanwhile is simply dirty again
+        vector<int> fds(batch.size());
+        vector<PageId> pageIds(batch.size());
+        vector<unsigned> pageSizes(batch.size());
+        vector<size_t> offsets(batch.size());
+        size_t offset = 0;
+        for (unsigned i = 0; i < batch.size(); i++)
+        {
+            Frame &frame = frames[batch[i]];
+            memcpy(staging + offset, frame.data, frame.pageSize);
+            fds[i] = frame.fd;
+            pageIds[i] = frame.pageId;
+            pageSizes[i] = frame.pageSize;
+            offsets[i] = offset;
+            offset += frame.pageSize;
+            setDirty(frame, false);
+            frame.writing = true;
+        }
+        writingFrames += batch.size();
+        lock.unlock();
+
+        vector<bool> failed(batch.size(), false);
+        unsigned start = 0;
+        while (start < batch.size())
+        {
+            unsigned end = start + 1;
+            while (end < batch.size() && fds[end] == fds[start]
+                   && sameFile(pageIds[end].fileId, pageIds[start].fileId)
+                   && pageIds[end].pageNum == pageIds[start].pageNum + (end - start))
+                end++;
+            if (FileHandle::writeToFile(fds[start], pageSizes[start], pageIds[start].pageNum, end - start, staging + offsets[start]))
+            {
+                for (unsigned i = start; i < end; i++)
+                    failed[i] = true;
+            }
+            start = end;
+        }
+
+        // Frames being written are never recycled, so batch still names the same pages
+        lock.lock();
+        for (unsigned i = 0; i < batch.size(); i++)
+        {
+            Frame &frame = frames[batch[i]];
+            frame.writing = false;
+            // A failed write leaves the page dirty, for eviction, sync or close to report
+            if (failed[i])
+                setDirty(frame, true);
+            else
+                pagesWritten++;
+        }
+        writingFrames -= batch.size();
+        writesDone.notify_all();
+    }
+}
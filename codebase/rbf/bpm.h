@@ -0,0 +1,198 @@
+#ifndef _bpm_h_
+#define _bpm_h_
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include "pfm.h"
+
+#define BPM_DEFAULT_FRAMES 1024
+#define BPM_RING_FRAMES    16      // frames pages read under AccessSequential are confined to
+
+// Background write-back: the flusher wakes up every BPM_FLUSH_INTERVAL_MS, or as soon as
+// a quarter of the frames are dirty, and writes up to BPM_FLUSH_BATCH pages of PAGE_SIZE bytes a round
+// (fewer if the pages are larger).
+// Writers are held back while half of the frames are dirty.
+#define BPM_FLUSH_INTERVAL_MS   50
+#define BPM_FLUSH_BATCH         256
+
+#define BPM_NO_FREE_FRAME   1
+#define BPM_PAGE_NOT_PINNED 2
+#define BPM_MALLOC_FAILED   3
+#define BPM_POOL_IN_USE     4
+#define BPM_PAGE_PINNED     5
+#define BPM_CHECKSUM_FAILED 6
+
+using namespace std;
+
+// A page in the pool is identified by the file it lives in and its physical page number in that file
+// (so the file header and free-space map pages are cached like any other page).
+// Files are keyed by device and inode so that every handle on the same file shares its frames.
+typedef struct PageId
+{
+    FileId fileId;
+    PageNum pageNum;
+} PageId;
+
+struct PageIdHash
+{
+    size_t operator()(const PageId &pageId) const;
+};
+
+struct PageIdEqual
+{
+    bool operator()(const PageId &a, const PageId &b) const;
+};
+
+// How the pool picks the page to evict
+typedef enum {
+	ReplaceClock = 0,   // CLOCK: second chance for pages referenced since the hand last passed
+	Replace2Q,          // 2Q: pages seen once wait in a small FIFO, pages seen again move to an LRU list
+	ReplaceLRUK         // LRU-2: evict the page whose second most recent access is oldest
+} ReplacementPolicy;
+
+// How a page is latched while it is pinned: readers share it, a writer has it alone
+typedef enum { LatchNone = 0, LatchShared, LatchExclusive } LatchMode;
+
+// Which of the policy's lists a frame is on
+typedef enum { ListNone = 0, ListA1in, ListAm, ListRing } FrameList;
+
+// A page evicted recently: 2Q's A1out queue, and LRU-K's history of evicted pages
+typedef struct Ghost
+{
+    PageId pageId;
+    uint64_t lastUse;
+} Ghost;
+
+typedef struct Frame
+{
+    char *data;
+    unsigned capacity;  // bytes allocated for data: PAGE_SIZE, or more once the frame has held a larger page
+    unsigned pageSize;  // bytes of the page in the frame
+    shared_mutex *pageLatch;    // guards data while the page is pinned; only ever held by a thread that also pins the page
+    PageId pageId;
+    int fd;             // descriptor the page is written back through while dirty
+    unsigned pinCount;
+    bool dirty;
+    bool writing;       // the page is being written back; it stays in the frame until that is done
+    uint64_t asyncTicket;   // the asynchronous write of the page holding the frame, 0 if none
+    IOToken asyncToken;     // its token, once submitted
+    bool loading;       // the page is being read from disk, under the page latch of whoever missed on it
+    bool referenced;    // CLOCK reference bit
+    bool valid;
+    bool orphaned;      // dropped by discardFile while pinned; kept out of use until the holder unpins it
+    uint64_t lastUse;   // LRU-K: the most recent access
+    uint64_t prevUse;   // LRU-K: the access before it, 0 if there was none
+    FrameList onList;
+    list<unsigned>::iterator position;  // where the frame is on its list
+} Frame;
+
+// BufferPoolManager caches pages of every open file in a fixed set of frames.
+// Callers pin a page to get a pointer to its frame and must unpin it when done,
+// telling the pool whether they modified it. Unpinned frames are recycled by the replacement
+// policy, CLOCK unless told otherwise; 2Q and LRU-2 keep pages used more than once over pages
+// a scan touched once. Pages read under AccessSequential only ever take BPM_RING_FRAMES frames.
+// Capacity is counted in frames, whatever the page size: a frame grows to hold a larger page
+// the first time one is read into it, and keeps that size.
+// The pool is shared with the background flusher and any number of threads, so every public
+// method takes the pool latch. Page contents are guarded by per-frame reader/writer latches,
+// taken by pinPage after the pool latch is let go and released by unpinPage: nobody ever waits
+// for a page latch while holding the pool latch. Threads latching several pages take data pages
+// before free-space map pages, and the file header last.
+// Nor is the pool latch held over disk I/O. A miss reserves its frame and publishes it in the page
+// table, loading, then reads the page under the frame's exclusive latch with the pool latch let go;
+// threads after the same page wait on that latch. A dirty page is written back pinned, marked
+// writing and under a shared page latch, so it stays put and unchanged without the pool latch.
+// An asynchronous write of a page through its FileHandle holds the frame pinned and marked writing
+// until the async manager reports it complete, so flushes of later changes to the page land after it.
+class BufferPoolManager
+{
+public:
+	static BufferPoolManager* instance();                                                    // Access to the _bp_manager instance
+
+	RC pinPage(FileHandle &fileHandle, PageNum pageNum, bool readFromDisk, void *&page, LatchMode mode);  // Pin and latch a page, reading it from disk on a miss if asked to
+	RC unpinPage(FileHandle &fileHandle, PageNum pageNum, bool dirty, LatchMode mode);                    // Unlatch and unpin a page, marking it dirty if it was modified
+	RC flushPage(FileHandle &fileHandle, PageNum pageNum);                                  // Write a page back if it is dirty
+	RC flushFile(FileHandle &fileHandle);                                                   // Write back every dirty page of a file
+	void discardFile(const FileId &fileId);                                                 // Drop every page of a file without writing it back
+	RC discardPage(FileHandle &fileHandle, PageNum pageNum);                                // Drop a page without writing it back, unless it is pinned
+
+	// An asynchronous write of a page the caller has pinned and latched exclusively, its new contents in the frame.
+	// Unless a write of the page is already in flight (busy), the pin and the frame go to the write, which is
+	// handed a ticket; once submitted, the write's token is told to the pool, and once complete, its result.
+	RC beginAsyncWrite(const PageId &pageId, uint64_t &ticket, bool &busy);
+	void asyncWriteSubmitted(const PageId &pageId, uint64_t ticket, IOToken token);
+	void endAsyncWrite(const PageId &pageId, uint64_t ticket, RC result);
+
+	RC setCapacity(unsigned frameCount);                                                    // Resize the pool, only allowed when nothing is pinned
+	unsigned getCapacity();                                                                 // Number of frames in the pool
+
+	void startFlusher();                                                                    // Start writing dirty pages back in the background
+	uint64_t getPagesWritten();                                                             // Pages written to disk so far, by any path
+	uint64_t getPagesRead();                                                                // Pages read from disk into the pool so far
+
+	void setPolicy(ReplacementPolicy policy);                                               // Change the replacement policy
+	ReplacementPolicy getPolicy();
+
+protected:
+	BufferPoolManager();                                                                    // Constructor
+	~BufferPoolManager();                                                                   // Destructor
+
+private:
+	static BufferPoolManager *_bp_manager;
+
+	vector<Frame> frames;
+	unordered_map<PageId, unsigned, PageIdHash, PageIdEqual> pageTable;
+	unsigned clockHand;
+	vector<unsigned> freeList;          // frames holding no page
+	ReplacementPolicy policy;
+	uint64_t accessClock;
+	list<unsigned> a1in;                // 2Q: pages seen once, oldest first
+	list<unsigned> am;                  // 2Q: pages seen again, least recently used first
+	list<unsigned> ring;                // pages read under AccessSequential, oldest first
+	list<Ghost> ghosts;                 // oldest first
+	unordered_map<PageId, list<Ghost>::iterator, PageIdHash, PageIdEqual> ghostTable;
+	unsigned dirtyFrames;
+	unsigned writingFrames;
+	uint64_t pagesWritten;
+	uint64_t pagesRead;
+	uint64_t lastTicket;
+
+	mutex latch;
+	condition_variable flushNeeded;     // wakes the flusher early
+	condition_variable writesDone;      // a flusher round, a write-back or a read done without the pool latch has completed
+	thread flusher;
+	bool flusherRunning;
+	bool stopping;
+	char *staging;                      // copies of the pages the flusher is writing
+
+	RC allocateFrames(unsigned frameCount);
+	void freeFrames();
+	RC findVictim(unique_lock<mutex> &lock, unsigned &frameIndex, bool sequential, bool &evicted);
+	RC pickVictim(unsigned &frameIndex, bool sequential, bool &evicted);
+	bool evictable(const Frame &frame);
+	void evict(unsigned frameIndex);
+	bool victimFromList(list<unsigned> &frameList, unsigned &frameIndex);
+	bool clockVictim(unsigned &frameIndex);
+	bool lruKVictim(unsigned &frameIndex, bool fromRing);
+	void admit(unsigned frameIndex, bool sequential);
+	void touch(unsigned frameIndex, bool sequential);
+	void unlink(unsigned frameIndex);
+	void remember(const Frame &frame);
+	void resetPolicy();
+	RC writeBack(Frame &frame);
+	RC writeBackUnlatched(unique_lock<mutex> &lock, unsigned frameIndex);
+	void release(unsigned frameIndex);
+	RC unpinOrphan(const PageId &pageId, LatchMode mode);
+	void setDirty(Frame &frame, bool dirty);
+	void awaitWrite(unique_lock<mutex> &lock, unsigned frameIndex);
+	bool waitForWrite(unique_lock<mutex> &lock, const FileId *fileId);
+	void waitForWrites(unique_lock<mutex> &lock, const FileId *fileId);
+	void flushDirtyPages();
+};
+
+#endif
@@ -0,0 +1,243 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <string.h>
+
+#include "bulkload.h"
+
+double BulkLoadStats::rowsPerSecond() const
+{
+    return nanos == 0 ? 0 : rows * 1e9 / nanos;
+}
+
+double BulkLoadStats::megabytesPerSecond() const
+{
+    return nanos == 0 ? 0 : bytes * 1e9 / nanos / (1024 * 1024);
+}
+
+
+CSVReader::CSVReader(istream &input, const vector<Attribute> &recordDescriptor, char delimiter)
+    : input(input), recordDescriptor(recordDescriptor), delimiter(delimiter)
+{
+    fieldCount = 0;
+    lines = 0;
+    bytes = 0;
+}
+
+unsigned CSVReader::maxRecordSize() const
+{
+    unsigned size = (recordDescriptor.size() + CHAR_BIT - 1) / CHAR_BIT;
+    for (unsigned i = 0; i < recordDescriptor.size(); i++)
+    {
+        if (recordDescriptor[i].type == TypeVarChar)
+            size += VARCHAR_LENGTH_SIZE + recordDescriptor[i].length;
+        else
+            size += INT_SIZE;
+    }
+    return size;
+}
+
+unsigned CSVReader::lineNumber() const
+{
+    return lines;
+}
+
+uint64_t CSVReader::bytesRead() const
+{
+    return bytes;
+}
+
+// The next line, without its line break
+bool CSVReader::readLine()
+{
+    if (!getline(input, line))
+        return false;
+    lines++;
+    bytes += line.size() + (input.eof() ? 0 : 1);
+    if (!line.empty() && line[line.size() - 1] == '\r')
+        line.resize(line.size() - 1);
+    return true;
+}
+
+// Splits the next row into fields, going on to the next lines while a quoted field is open
+RC CSVReader::readFields()
+{
+    do
+    {
+        if (!readLine())
+            return RBFM_EOF;
+    } while (line.empty());
+
+    fieldCount = 0;
+    size_t pos = 0;
+    for (;;)
+    {
+        if (fieldCount == fields.size())
+        {
+            fields.push_back(string());
+            quoted.push_back(false);
+        }
+        string &field = fields[fieldCount];
+        field.clear();
+        quoted[fieldCount] = pos < line.size() && line[pos] == '"';
+
+        if (quoted[fieldCount])
+        {
+            pos++;
+            for (;;)
+            {
+                size_t quote = line.find('"', pos);
+                if (quote == string::npos)
+                {
+                    field.append(line, pos, string::npos);
+                    field += '\n';
+                    if (!readLine())
+                        return RBFM_CSV_PARSE_FAILED;
+                    pos = 0;
+                    continue;
+                }
+                field.append(line, pos, quote - pos);
+                pos = quote + 1;
+                if (pos < line.size() && line[pos] == '"')
+                {
+                    field += '"';
+                    pos++;
+                    continue;
+                }
+                break;
+            }
+            if (pos < line.size() && line[pos] != delimiter)
+                return RBFM_CSV_PARSE_FAILED;
+        }
+        else
+        {
+            size_t end = line.find(delimiter, pos);
+            if (end == string::npos)
+                end = line.size();
+            field.assign(line, pos, end - pos);
+            pos = end;
+        }
+
+        fieldCount++;
+        if (pos >= line.size())
+            return SUCCESS;
+        pos++;
+    }
+}
+
+RC CSVReader::skipRow()
+{
+    RC rc = readFields();
+    return rc == RBFM_EOF ? SUCCESS : rc;
+}
+
+// A row ends at the first line break outside double quotes. The text is cut at the first row end
+// past minBytes, so the rows of a block are the same however the input comes in.
+bool CSVReader::readRows(size_t minBytes, string &text)
+{
+    text.clear();
+    text.swap(pending);
+    size_t rowEnd = string::npos;
+    size_t scanned = 0;
+    bool quoted = false;
+    while (rowEnd == string::npos)
+    {
+        const char *data = text.data();
+        while (scanned < text.size())
+        {
+            const char *lineBreak = (const char *) memchr(data + scanned, '\n', text.size() - scanned);
+            const char *lineEnd = lineBreak == NULL ? data + text.size() : lineBreak;
+            for (const char *quote = (const char *) memchr(data + scanned, '"', lineEnd - data - scanned); quote != NULL;
+                 quote = (const char *) memchr(quote + 1, '"', lineEnd - quote - 1))
+                quoted = !quoted;
+            scanned = lineEnd - data;
+            if (lineBreak == NULL)
+                break;
+            scanned++;
+            if (!quoted && scanned >= minBytes)
+            {
+                rowEnd = scanned;
+                break;
+            }
+        }
+        if (rowEnd != string::npos)
+            break;
+
+        size_t size = text.size();
+        text.resize(size + minBytes);
+        input.read(&text[size], minBytes);
+        text.resize(size + input.gcount());
+        if (input.gcount() == 0)
+            rowEnd = text.size();
+    }
+
+    pending.assign(text, rowEnd, string::npos);
+    text.resize(rowEnd);
+    bytes += text.size();
+    for (const char *lineBreak = (const char *) memchr(text.data(), '\n', text.size()); lineBreak != NULL;
+         lineBreak = (const char *) memchr(lineBreak + 1, '\n', text.data() + text.size() - lineBreak - 1))
+        lines++;
+    if (!text.empty() && text[text.size() - 1] != '\n')
+        lines++;
+    return !text.empty();
+}
+
+RC CSVReader::readRecord(void *record)
+{
+    RC rc = readFields();
+    if (rc)
+        return rc;
+    if (fieldCount != recordDescriptor.size())
+        return RBFM_CSV_PARSE_FAILED;
+
+    unsigned nullIndicatorSize = (recordDescriptor.size() + CHAR_BIT - 1) / CHAR_BIT;
+    char *nullIndicator = (char *) record;
+    char *cursor = nullIndicator + nullIndicatorSize;
+    memset(nullIndicator, 0, nullIndicatorSize);
+
+    for (unsigned i = 0; i < fieldCount; i++)
+    {
+        const string &field = fields[i];
+        if (field.empty() && !quoted[i])
+        {
+            nullIndicator[i / CHAR_BIT] |= 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
+            continue;
+        }
+
+        char *end;
+        errno = 0;
+        switch (recordDescriptor[i].type)
+        {
+            case TypeInt:
+            {
+                long value = strtol(field.c_str(), &end, 10);
+                if (end == field.c_str() || *end != '\0' || errno != 0 || value < INT32_MIN || value > INT32_MAX)
+                    return RBFM_CSV_PARSE_FAILED;
+                int32_t intValue = value;
+                memcpy(cursor, &intValue, INT_SIZE);
+                cursor += INT_SIZE;
+                break;
+            }
+            case TypeReal:
+            {
+                float value = strtof(field.c_str(), &end);
+                if (end == field.c_str() || *end != '\0' || errno != 0)
+                    return RBFM_CSV_PARSE_FAILED;
+                memcpy(cursor, &value, REAL_SIZE);
+                cursor += REAL_SIZE;
+                break;
+            }
+            case TypeVarChar:
+            {
+                uint32_t length = field.size();
+                if (length > recordDescriptor[i].length)
+                    return RBFM_CSV_PARSE_FAILED;
+                memcpy(cursor, &length, VARCHAR_LENGTH_SIZE);
+                memcpy(cursor + VARCHAR_LENGTH_SIZE, field.data(), length);
+                cursor += VARCHAR_LENGTH_SIZE + length;
+                break;
+            }
+        }
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,45 @@
+#ifndef _bulkload_h_
+#define _bulkload_h_
+
+#include <string>
+#include <vector>
+#include <istream>
+#include "rbfm.h"
+
+using namespace std;
+
+// CSVReader reads the rows of a CSV stream one at a time and encodes each into the record format
+// insertRecord takes, following a record descriptor. Lines end in \n or \r\n, and blank lines are
+// skipped. A field in double quotes may hold the delimiter, line breaks and doubled quotes.
+// Rows are either parsed one by one (readRecord) or cut out as text in blocks (readRows), not both.
+class CSVReader
+{
+public:
+	CSVReader(istream &input, const vector<Attribute> &recordDescriptor, char delimiter);
+
+	RC readRecord(void *record);        // Encode the next row into record, of maxRecordSize() bytes; RBFM_EOF past the last row, RBFM_CSV_PARSE_FAILED on a bad one
+	RC skipRow();                       // Pass over the next row, as a header
+	bool readRows(size_t minBytes, string &text);   // Take the text of whole rows, at least minBytes of it but at the end, for another CSVReader to parse; false at the end
+
+	unsigned maxRecordSize() const;     // The most bytes a row can encode to
+	unsigned lineNumber() const;        // Line the last row read ended on, from 1
+	uint64_t bytesRead() const;
+
+private:
+	istream &input;
+	const vector<Attribute> &recordDescriptor;
+	char delimiter;
+
+	string line;
+	string pending;                     // read past the last row readRows handed out
+	vector<string> fields;              // the fields of the last row, kept to reuse their buffers
+	vector<bool> quoted;
+	unsigned fieldCount;
+	unsigned lines;
+	uint64_t bytes;
+
+	bool readLine();
+	RC readFields();
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include <cstring>
+
+#include "checksum.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42
+#endif
+
+#define CRC32C_POLYNOMIAL 0x82F63B78   // reversed bit order
+#define CRC32C_STRIDE 256              // bytes each of the three interleaved streams takes per round
+
+// The tables for the software fallback and for joining interleaved streams. Moving a CRC past
+// n zero bytes is linear in the CRC, so it is done a byte at a time from tables built per n.
+struct Crc32cTables
+{
+    uint32_t bytes[256];                // one entry per byte value
+    uint32_t skipOne[4][256];           // moves a CRC past CRC32C_STRIDE zero bytes
+    uint32_t skipTwo[4][256];           // and past twice that many
+
+    Crc32cTables()
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+            bytes[i] = crc;
+        }
+        buildSkip(skipOne, CRC32C_STRIDE);
+        buildSkip(skipTwo, 2 * CRC32C_STRIDE);
+    }
+
+    void buildSkip(uint32_t skip[4][256], unsigned zeros)
+    {
+        uint32_t bitSkip[32];
+        for (int bit = 0; bit < 32; bit++)
+        {
+            uint32_t crc = 1u << bit;
+            for (unsigned i = 0; i < zeros; i++)
+                crc = bytes[crc & 0xFF] ^ (crc >> 8);
+            bitSkip[bit] = crc;
+        }
+        for (int b = 0; b < 4; b++)
+        {
+            for (uint32_t value = 0; value < 256; value++)
+            {
+                uint32_t crc = 0;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    if (value & (1u << bit))
+                        crc ^= bitSkip[b * 8 + bit];
+                }
+                skip[b][value] = crc;
+            }
+        }
+    }
+};
+
+static const Crc32cTables tables;
+
+static inline uint32_t skipZeros(const uint32_t skip[4][256], uint32_t crc)
+{
+    return skip[0][crc & 0xFF] ^ skip[1][(crc >> 8) & 0xFF] ^ skip[2][(crc >> 16) & 0xFF] ^ skip[3][crc >> 24];
+}
+
+static uint32_t crc32cSoftware(uint32_t crc, const unsigned char *data, size_t length)
+{
+    while (length-- > 0)
+        crc = tables.bytes[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_HAVE_SSE42
+static inline uint64_t loadWord(const unsigned char *data)
+{
+    uint64_t word;
+    memcpy(&word, data, sizeof(uint64_t));
+    return word;
+}
+
+// The crc32 instruction takes three cycles but can start one every cycle, so a page is read as
+// three streams side by side and their CRCs joined after each round
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const unsigned char *data, size_t length)
+{
+    while (length >= 3 * CRC32C_STRIDE)
+    {
+        uint64_t crc0 = crc, crc1 = 0, crc2 = 0;
+        for (unsigned i = 0; i < CRC32C_STRIDE; i += sizeof(uint64_t))
+        {
+            crc0 = _mm_crc32_u64(crc0, loadWord(data + i));
+            crc1 = _mm_crc32_u64(crc1, loadWord(data + CRC32C_STRIDE + i));
+            crc2 = _mm_crc32_u64(crc2, loadWord(data + 2 * CRC32C_STRIDE + i));
+        }
+        crc = skipZeros(tables.skipTwo, (uint32_t) crc0) ^ skipZeros(tables.skipOne, (uint32_t) crc1) ^ (uint32_t) crc2;
+        data += 3 * CRC32C_STRIDE;
+        length -= 3 * CRC32C_STRIDE;
+    }
+
+    uint64_t crc64 = crc;
+    while (length >= sizeof(uint64_t))
+    {
+        crc64 = _mm_crc32_u64(crc64, loadWord(data));
+        data += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+    crc = (uint32_t) crc64;
+    while (length-- > 0)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+uint32_t crc32c(const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char*) data;
+#ifdef CRC32C_HAVE_SSE42
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware)
+        return ~crc32cHardware(~0u, bytes, length);
+#endif
+    return ~crc32cSoftware(~0u, bytes, length);
+}
@@ -0,0 +1,11 @@
+#ifndef _checksum_h_
+#define _checksum_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C (Castagnoli), as used by iSCSI, ext4 and btrfs. Computed with the SSE4.2 crc32
+// instruction where the CPU has it, checked once at startup, and with a lookup table otherwise.
+uint32_t crc32c(const void *data, size_t length);
+
+#endif
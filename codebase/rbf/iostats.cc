@@ -0,0 +1,176 @@
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+#include <time.h>
+#include <inttypes.h>
+
+#include "iostats.h"
+
+static const char *opNames[IOOpCount] = { "read", "write", "append", "sync" };
+
+uint64_t LatencySnapshot::meanNanos() const
+{
+    return count == 0 ? 0 : totalNanos / count;
+}
+
+// The top of the bucket the operation ranked fraction of the way up falls in, but no more than the slowest seen
+uint64_t LatencySnapshot::percentileNanos(double fraction) const
+{
+    if (count == 0)
+        return 0;
+    uint64_t rank = (uint64_t) ceil(fraction * count);
+    rank = max(rank, (uint64_t) 1);
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < IOSTATS_BUCKETS; b++)
+    {
+        seen += buckets[b];
+        if (seen >= rank)
+            return min(LatencyHistogram::bucketLimit(b) - 1, maxNanos);
+    }
+    return maxNanos;
+}
+
+string IOStatsSnapshot::toString() const
+{
+    char line[160];
+    string text;
+    snprintf(line, sizeof(line), "%-8s %12s %12s %12s %12s %12s %12s\n", "op", "count", "mean us", "p50 us", "p99 us", "p999 us", "max us");
+    text += line;
+    for (unsigned op = 0; op < IOOpCount; op++)
+    {
+        const LatencySnapshot &l = latency[op];
+        snprintf(line, sizeof(line), "%-8s %12" PRIu64 " %12.1f %12.1f %12.1f %12.1f %12.1f\n", opNames[op], l.count,
+                 l.meanNanos() / 1e3, l.percentileNanos(0.5) / 1e3, l.percentileNanos(0.99) / 1e3,
+                 l.percentileNanos(0.999) / 1e3, l.maxNanos / 1e3);
+        text += line;
+    }
+    snprintf(line, sizeof(line), "bytes read %" PRIu64 ", written %" PRIu64 "\n", bytesRead, bytesWritten);
+    text += line;
+    uint64_t accesses = poolHits + poolMisses;
+    snprintf(line, sizeof(line), "buffer pool hits %" PRIu64 ", misses %" PRIu64 ", evictions %" PRIu64 " (hit ratio %.1f%%)\n",
+             poolHits, poolMisses, poolEvictions, accesses == 0 ? 0.0 : 100.0 * poolHits / accesses);
+    text += line;
+    return text;
+}
+
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+// Below IOSTATS_SUB_BUCKETS ns a bucket per nanosecond; above, the power of two the latency
+// falls in and which quarter of it
+unsigned LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if (nanos < IOSTATS_SUB_BUCKETS)
+        return nanos;
+    unsigned exponent = 63 - __builtin_clzll(nanos);
+    unsigned quarter = (nanos >> (exponent - 2)) & (IOSTATS_SUB_BUCKETS - 1);
+    return min((exponent - 1) * IOSTATS_SUB_BUCKETS + quarter, (unsigned) IOSTATS_BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucketLimit(unsigned bucket)
+{
+    if (bucket < IOSTATS_SUB_BUCKETS)
+        return bucket + 1;
+    unsigned exponent = bucket / IOSTATS_SUB_BUCKETS + 1;
+    uint64_t width = (uint64_t) 1 << (exponent - 2);
+    return (IOSTATS_SUB_BUCKETS + bucket % IOSTATS_SUB_BUCKETS) * width + width;
+}
+
+void LatencyHistogram::record(uint64_t nanos)
+{
+    count.fetch_add(1, memory_order_relaxed);
+    totalNanos.fetch_add(nanos, memory_order_relaxed);
+    buckets[bucketOf(nanos)].fetch_add(1, memory_order_relaxed);
+    uint64_t slowest = maxNanos.load(memory_order_relaxed);
+    while (nanos > slowest && !maxNanos.compare_exchange_weak(slowest, nanos, memory_order_relaxed))
+        ;
+}
+
+void LatencyHistogram::snapshot(LatencySnapshot &latency) const
+{
+    latency.count = count.load(memory_order_relaxed);
+    latency.totalNanos = totalNanos.load(memory_order_relaxed);
+    latency.maxNanos = maxNanos.load(memory_order_relaxed);
+    for (unsigned b = 0; b < IOSTATS_BUCKETS; b++)
+        latency.buckets[b] = buckets[b].load(memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+{
+    count.store(0, memory_order_relaxed);
+    totalNanos.store(0, memory_order_relaxed);
+    maxNanos.store(0, memory_order_relaxed);
+    for (unsigned b = 0; b < IOSTATS_BUCKETS; b++)
+        buckets[b].store(0, memory_order_relaxed);
+}
+
+
+IOStats::IOStats()
+{
+    reset();
+}
+
+IOStats& IOStats::global()
+{
+    static IOStats stats;
+    return stats;
+}
+
+uint64_t IOStats::now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void IOStats::recordLatency(IOOp op, uint64_t nanos)
+{
+    latency[op].record(nanos);
+}
+
+void IOStats::addBytesRead(uint64_t bytes)
+{
+    bytesRead.fetch_add(bytes, memory_order_relaxed);
+}
+
+void IOStats::addBytesWritten(uint64_t bytes)
+{
+    bytesWritten.fetch_add(bytes, memory_order_relaxed);
+}
+
+// A miss only evicts when the pool has no empty frame left
+void IOStats::countPoolAccess(bool hit, bool evicted)
+{
+    if (hit)
+        poolHits.fetch_add(1, memory_order_relaxed);
+    else
+        poolMisses.fetch_add(1, memory_order_relaxed);
+    if (evicted)
+        poolEvictions.fetch_add(1, memory_order_relaxed);
+}
+
+void IOStats::snapshot(IOStatsSnapshot &stats) const
+{
+    for (unsigned op = 0; op < IOOpCount; op++)
+        latency[op].snapshot(stats.latency[op]);
+    stats.bytesRead = bytesRead.load(memory_order_relaxed);
+    stats.bytesWritten = bytesWritten.load(memory_order_relaxed);
+    stats.poolHits = poolHits.load(memory_order_relaxed);
+    stats.poolMisses = poolMisses.load(memory_order_relaxed);
+    stats.poolEvictions = poolEvictions.load(memory_order_relaxed);
+}
+
+void IOStats::reset()
+{
+    for (unsigned op = 0; op < IOOpCount; op++)
+        latency[op].reset();
+    bytesRead.store(0, memory_order_relaxed);
+    bytesWritten.store(0, memory_order_relaxed);
+    poolHits.store(0, memory_order_relaxed);
+    poolMisses.store(0, memory_order_relaxed);
+    poolEvictions.store(0, memory_order_relaxed);
+}
@@ -0,0 +1,92 @@
+#ifndef _iostats_h_
+#define _iostats_h_
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+
+// Latencies are kept in nanoseconds, in log buckets: four per power of two, so a bucket is at
+// most 25% wide, from 1 ns up to 2^40 ns (about 18 minutes); anything longer lands in the last one.
+#define IOSTATS_SUB_BUCKETS 4
+#define IOSTATS_BUCKETS     160
+
+using namespace std;
+
+// The operations timed, as seen by FileHandle callers
+typedef enum { IORead = 0, IOWrite, IOAppend, IOSync, IOOpCount } IOOp;
+
+// A latency histogram copied out, to look at at leisure
+typedef struct LatencySnapshot
+{
+	uint64_t count;
+	uint64_t totalNanos;
+	uint64_t maxNanos;
+	uint64_t buckets[IOSTATS_BUCKETS];
+
+	uint64_t meanNanos() const;
+	uint64_t percentileNanos(double fraction) const;    // Latency fraction of the operations took at most (0.5 for p50, 0.999 for p999), to within its bucket
+} LatencySnapshot;
+
+// Everything an IOStats keeps, copied out
+typedef struct IOStatsSnapshot
+{
+	LatencySnapshot latency[IOOpCount];
+	uint64_t bytesRead;
+	uint64_t bytesWritten;                              // appends included
+	uint64_t poolHits;                                  // pages found in the buffer pool
+	uint64_t poolMisses;                                // pages the buffer pool had to read or set up
+	uint64_t poolEvictions;                             // pages pushed out of the buffer pool to make room for misses
+
+	string toString() const;                            // A text table: count, mean, p50, p99, p999 and max per operation, then bytes and pool counts
+} IOStatsSnapshot;
+
+// LatencyHistogram counts with relaxed atomics, so any number of threads can record at once
+// without a lock; a snapshot taken meanwhile may be a few operations off.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void record(uint64_t nanos);
+	void snapshot(LatencySnapshot &latency) const;
+	void reset();
+
+	static unsigned bucketOf(uint64_t nanos);
+	static uint64_t bucketLimit(unsigned bucket);       // The lowest latency past the bucket
+
+private:
+	atomic<uint64_t> count;
+	atomic<uint64_t> totalNanos;
+	atomic<uint64_t> maxNanos;
+	atomic<uint64_t> buckets[IOSTATS_BUCKETS];
+};
+
+// IOStats gathers latency histograms of page reads, writes, appends and syncs, the bytes they
+// moved and how the buffer pool served them. Every open file keeps one, shared by its handles,
+// and one more adds up all files (global()).
+class IOStats
+{
+public:
+	IOStats();
+
+	static IOStats& global();
+	static uint64_t now();                              // Monotonic clock, in nanoseconds
+
+	void recordLatency(IOOp op, uint64_t nanos);
+	void addBytesRead(uint64_t bytes);
+	void addBytesWritten(uint64_t bytes);
+	void countPoolAccess(bool hit, bool evicted);
+
+	void snapshot(IOStatsSnapshot &stats) const;
+	void reset();
+
+private:
+	LatencyHistogram latency[IOOpCount];
+	atomic<uint64_t> bytesRead;
+	atomic<uint64_t> bytesWritten;
+	atomic<uint64_t> poolHits;
+	atomic<uint64_t> poolMisses;
+	atomic<uint64_t> poolEvictions;
+};
+
+#endif
@@ -1,16 +1,89 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <deque>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <stdint.h>
 
 #include "pfm.h"
+#include "bpm.h"
+#include "asyncio.h"
+#include "checksum.h"
+
+// A read-only shared mapping of a whole file. Mappings reserve address space past the end
+// of the file, so pages appended later are reachable without mapping the file again.
+#define MMAP_MIN_LENGTH (64 * 1024 * 1024)
+
+struct FileMapping
+{
+    char *base;
+    size_t length;
+
+    FileMapping(char *base, size_t length) : base(base), length(length) {}
+    ~FileMapping() { munmap(base, length); }
+};
+
+// What every handle open on the same file shares. Handles on one file may be used from
+// different threads: appends are serialized by the latch, which also guards the preallocation
+// and free page fields, and the page count can be read at any time.
+// The descriptors are closed once the open-file table and every handle have let go of the state.
+struct FileState
+{
+    FileId fileId;
+    int fd;                     // read/write descriptor every handle goes through
+    int directFd;               // O_DIRECT descriptor, opened for the first handle that asks for direct I/O
+    unsigned handles;           // open handles; the PagedFileManager's latch guards it
+    unsigned pageSize;
+    unsigned flags;             // as the file was created with
+    atomic<unsigned> numPages;  // data pages in the file: the logical end of the data
+    PageNum allocatedPages;     // physical pages with disk space reserved, which may run past the end of the file
+    bool preallocate;           // cleared once the file system turns out not to support preallocation
+    unsigned freePages;         // data pages marked free in the map, as counted in the header
+    unsigned freeGroupHint;     // no group before this one has a free page
+    deque<pair<PageNum, uint64_t> > idleFreePages;  // pages freed in this session, with when, oldest first
+    map<PageNum, uint64_t> freedAt;                 // when each of those was last freed, while it still is
+    IOStats stats;              // of every handle on the file, since it was opened
+    mutex latch;
+
+    FileState() : fd(-1), directFd(-1), handles(0), flags(0), freePages(0), freeGroupHint(0) {}
+    ~FileState()
+    {
+        if (fd >= 0)
+            close(fd);
+        if (directFd >= 0)
+            close(directFd);
+    }
+};
+
+bool FileIdLess::operator()(const FileId &a, const FileId &b) const
+{
+    if (a.device != b.device)
+        return a.device < b.device;
+    return a.inode < b.inode;
+}
+
+static bool sameFile(const FileId &a, const FileId &b)
+{
+    return a.device == b.device && a.inode == b.inode;
+}
 
 PagedFileManager* PagedFileManager::_pf_manager = NULL;
 
 PagedFileManager* PagedFileManager::instance()
 {
-    if(!_pf_manager)
-        _pf_manager = new PagedFileManager();
+    static once_flag created;
+    call_once(created, [] { _pf_manager = new PagedFileManager(); });
 
     return _pf_manager;
 }
@@ -18,6 +91,7 @@ PagedFileManager* PagedFileManager::instance()
 
 PagedFileManager::PagedFileManager()
 {
+    openFileLimit = PFM_DEFAULT_OPEN_FILES;
 }
 
 
@@ -33,51 +107,344 @@ bool fileExists(const string &fileName)
     return stat(fileName.c_str(), &sb) == 0;
 }
 
+// Writes a fresh header page: no data pages yet, so the free-space map directory is empty
+RC PagedFileManager::writeFileHeader(int fd, unsigned pageSize, unsigned flags)
+{
+    // Aligned, since the file may be open for direct I/O
+    void *page = NULL;
+    if (posix_memalign(&page, PAGE_SIZE, pageSize) != 0)
+        return FH_WRITE_FAILED;
+    memset(page, 0, pageSize);
+
+    FileHeader header;
+    header.magic = PFM_FILE_MAGIC;
+    header.version = PFM_FILE_VERSION;
+    header.numPages = 0;
+    header.pageSize = pageSize;
+    header.freePages = 0;
+    header.flags = flags;
+    memcpy(page, &header, sizeof(FileHeader));
+
+    RC rc = FileHandle::writeToFile(fd, pageSize, 0, page);
+    free(page);
+    return rc;
+}
+
+RC PagedFileManager::readFileHeader(int fd, FileHeader &header)
+{
+    void *page = NULL;
+    if (posix_memalign(&page, PAGE_SIZE, PAGE_SIZE) != 0)
+        return PFM_OPEN_FAILED;
+
+    // The header comes first on the header page, whatever the page size
+    RC rc = SUCCESS;
+    if (FileHandle::readFromFile(fd, PAGE_SIZE, 0, page))
+        rc = PFM_OPEN_FAILED;
+    else
+    {
+        memcpy(&header, page, sizeof(FileHeader));
+        if (header.magic != PFM_FILE_MAGIC || header.version != PFM_FILE_VERSION || !validPageSize(header.pageSize))
+            rc = PFM_NOT_PAGED_FILE;
+    }
+    free(page);
+    return rc;
+}
+
+// Number of data pages a file of the given size holds.
+// Take away the header page and one free-space map page per group.
+// Anything past the last page a page number can reach is not counted.
+template <class Layout>
+static unsigned pagesInFile(Layout, off_t size)
+{
+    uint64_t physicalPages = size / Layout::pageSize;
+    if (physicalPages <= 1)
+        return 0;
+    uint64_t groupPages = physicalPages - 1;
+    uint64_t fullGroups = groupPages / (Layout::groupSize + 1);
+    uint64_t rest = groupPages % (Layout::groupSize + 1);
+    uint64_t pages = fullGroups * Layout::groupSize + (rest > 0 ? rest - 1 : 0);
+    return pages < Layout::maxPages ? pages : Layout::maxPages;
+}
+
+shared_ptr<FileState> PagedFileManager::findOpenFile(const FileId &fileId)
+{
+    map<FileId, shared_ptr<FileState>, FileIdLess>::iterator it = openFiles.find(fileId);
+    if (it == openFiles.end())
+        return shared_ptr<FileState>();
+    return it->second;
+}
+
+// Takes a file out of the table. Handles still open on it keep its state and descriptors.
+void PagedFileManager::forgetFile(const FileId &fileId)
+{
+    map<FileId, shared_ptr<FileState>, FileIdLess>::iterator it = openFiles.find(fileId);
+    if (it == openFiles.end())
+        return;
+
+    if (it->second->handles == 0)
+        idleFiles.remove_if([&fileId](const FileId &idle) { return sameFile(idle, fileId); });
+    for (map<string, FileId>::iterator path = openPaths.begin(); path != openPaths.end(); )
+    {
+        if (sameFile(path->second, fileId))
+            openPaths.erase(path++);
+        else
+            ++path;
+    }
+    openFiles.erase(it);
+}
+
+// Closes idle files, least recently used first, until the table is within its limit
+void PagedFileManager::closeIdleFiles()
+{
+    while (openFiles.size() > openFileLimit && !idleFiles.empty())
+    {
+        // A copy, since forgetting the file takes it off the list
+        FileId fileId = idleFiles.front();
+        forgetFile(fileId);
+    }
+}
+
+void PagedFileManager::setOpenFileLimit(unsigned limit)
+{
+    lock_guard<mutex> lock(latch);
+    openFileLimit = limit;
+    closeIdleFiles();
+}
+
+unsigned PagedFileManager::getOpenFileLimit()
+{
+    lock_guard<mutex> lock(latch);
+    return openFileLimit;
+}
+
+unsigned PagedFileManager::getOpenFileCount()
+{
+    lock_guard<mutex> lock(latch);
+    return openFiles.size();
+}
+
+void PagedFileManager::collectStats(IOStatsSnapshot &stats)
+{
+    IOStats::global().snapshot(stats);
+}
+
+void PagedFileManager::resetStats()
+{
+    IOStats::global().reset();
+}
+
+// Device and inode of a file, which is how the buffer pool tells files apart
+static bool getFileId(const string &fileName, FileId &fileId)
+{
+    struct stat sb;
+    if (stat(fileName.c_str(), &sb) != 0)
+        return false;
+    fileId.device = sb.st_dev;
+    fileId.inode = sb.st_ino;
+    return true;
+}
+
 RC PagedFileManager::createFile(const string &fileName)
 {
+    return createFile(fileName, PAGE_SIZE);
+}
+
+
+RC PagedFileManager::createFile(const string &fileName, unsigned pageSize)
+{
+    return createFile(fileName, pageSize, 0);
+}
+
+
+RC PagedFileManager::createFile(const string &fileName, unsigned pageSize, unsigned flags)
+{
+    if (!validPageSize(pageSize))
+        return PFM_BAD_PAGE_SIZE;
+
     // If the file already exists, error
     if (fileExists(fileName))
         return PFM_FILE_EXISTS;
 
-    // Attempt to open the file for writing
-    FILE *pFile = fopen(fileName.c_str(), "wb");
+    // The path may still lead to a file removed behind our back
+    {
+        lock_guard<mutex> lock(latch);
+        map<string, FileId>::iterator path = openPaths.find(fileName);
+        if (path != openPaths.end())
+            forgetFile(path->second);
+    }
+
+    // Attempt to create the file for writing
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
     // Return an error if we fail
-    if (pFile == NULL)
+    if (fd < 0)
+        return errno == EEXIST ? PFM_FILE_EXISTS : PFM_OPEN_FAILED;
+
+    // Every paged file starts with its header page
+    RC rc = writeFileHeader(fd, pageSize, flags & PFM_PAGE_CHECKSUMS);
+    close(fd);
+    if (rc)
         return PFM_OPEN_FAILED;
 
-    fclose (pFile);
+    // The inode may have belonged to a file removed behind our back, so forget any of its pages
+    FileId fileId;
+    if (getFileId(fileName, fileId))
+    {
+        BufferPoolManager::instance()->discardFile(fileId);
+        lock_guard<mutex> lock(latch);
+        forgetFile(fileId);
+    }
+
     return SUCCESS;
 }
 
 
 RC PagedFileManager::destroyFile(const string &fileName)
 {
+    FileId fileId;
+    bool known = getFileId(fileName, fileId);
+
     // If file cannot be successfully removed, error
     if (remove(fileName.c_str()) != 0)
         return PFM_REMOVE_FAILED;
 
+    // Cached pages of a removed file are garbage, dirty or not.
+    // Handles still open on it keep their state, but new opens must not find it.
+    if (known)
+    {
+        BufferPoolManager::instance()->discardFile(fileId);
+        lock_guard<mutex> lock(latch);
+        forgetFile(fileId);
+    }
+
     return SUCCESS;
 }
 
 
 RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
+{
+    FileOptions options;
+    return openFile(fileName, fileHandle, options);
+}
+
+
+RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle, const FileOptions &options)
 {
     // If this handle already has an open file, error
-    if (fileHandle.getfd() != NULL)
+    if (fileHandle.getfd() != -1)
         return PFM_HANDLE_IN_USE;
 
-    // If the file doesn't exist, error
-    if (!fileExists(fileName.c_str()))
-        return PFM_FILE_DN_EXIST;
+    // A file in the open-file table is handed out as is. Opens are serialized from here on,
+    // so two of them never set up state for the same file.
+    unique_lock<mutex> lock(latch);
+    shared_ptr<FileState> state;
+    map<string, FileId>::iterator path = openPaths.find(fileName);
+    if (path != openPaths.end())
+        state = findOpenFile(path->second);
 
-    // Open the file for reading/writing in binary mode
-    FILE *pFile;
-    pFile = fopen(fileName.c_str(), "rb+");
-    // If we fail, error
-    if (pFile == NULL)
-        return PFM_OPEN_FAILED;
+    if (!state)
+    {
+        // If the file doesn't exist, error
+        if (!fileExists(fileName.c_str()))
+            return PFM_FILE_DN_EXIST;
+
+        // Open the file for reading/writing
+        int fd = open(fileName.c_str(), O_RDWR);
+        // If we fail, error
+        if (fd < 0)
+            return PFM_OPEN_FAILED;
+
+        struct stat sb;
+        if (fstat(fd, &sb) != 0)
+        {
+            close(fd);
+            return PFM_OPEN_FAILED;
+        }
+
+        FileId fileId;
+        fileId.device = sb.st_dev;
+        fileId.inode = sb.st_ino;
+
+        // The file may be in the table under another path, in which case its state is shared as is.
+        // Otherwise the state comes from the header: an empty file gets its header now,
+        // anything else must already be a paged file.
+        state = findOpenFile(fileId);
+        if (state)
+            close(fd);
+        else
+        {
+            FileHeader header;
+            RC rc = SUCCESS;
+            if (sb.st_size == 0)
+            {
+                if (writeFileHeader(fd, PAGE_SIZE, 0))
+                    rc = PFM_OPEN_FAILED;
+                header.numPages = 0;
+                header.pageSize = PAGE_SIZE;
+                header.freePages = 0;
+                header.flags = 0;
+            }
+            else
+                rc = readFileHeader(fd, header);
+            if (rc)
+            {
+                close(fd);
+                return rc;
+            }
+
+            state.reset(new FileState());
+            state->fileId = fileId;
+            state->fd = fd;
+            state->pageSize = header.pageSize;
+            state->flags = header.flags;
+            // The header is written back lazily, so pages appended before a crash may be missing from it
+            off_t size = sb.st_size;
+            state->numPages = max(header.numPages,
+                                  withPageLayout(header.pageSize, [size](auto layout) { return pagesInFile(layout, size); }));
+            // Space reserved past the end of the file by an earlier open is not known; reserving it again is harmless
+            state->allocatedPages = min((uint64_t) sb.st_size / header.pageSize, (uint64_t) UINT_MAX);
+            state->freePages = header.freePages;
+            state->preallocate = true;
+            openFiles[fileId] = state;
+        }
+        openPaths[fileName] = fileId;
+    }
 
-    fileHandle.setfd(pFile);
+    // Direct I/O is a request: file systems that refuse O_DIRECT (tmpfs, for one)
+    // get the regular descriptor instead.
+    bool directIO = false;
+#ifdef O_DIRECT
+    if (options.directIO)
+    {
+        if (state->directFd < 0)
+            state->directFd = open(fileName.c_str(), O_RDWR | O_DIRECT);
+        directIO = state->directFd >= 0;
+    }
+#endif
+
+    if (state->handles++ == 0)
+        idleFiles.remove_if([&state](const FileId &idle) { return sameFile(idle, state->fileId); });
+    closeIdleFiles();
+    lock.unlock();
+
+    fileHandle._fileId = state->fileId;
+    fileHandle._state = state;
+    fileHandle._pageSize = state->pageSize;
+    fileHandle._directIO = directIO;
+    fileHandle._checksums = (state->flags & PFM_PAGE_CHECKSUMS) != 0;
+    fileHandle._options = options;
+    fileHandle._accessPattern = AccessNormal;
+    fileHandle._pendingWrites = 0;
+    fileHandle.setfd(directIO ? state->directFd : state->fd);
+
+    if (options.durability == DurabilityWriteBack)
+        BufferPoolManager::instance()->startFlusher();
+
+    // Pages read through the mapping would skip their checksums
+    if (options.mmapReads && !fileHandle._checksums && fileHandle.mapFile((size_t) fileHandle.dataPageLocation(state->numPages) * state->pageSize))
+    {
+        closeFile(fileHandle);
+        return PFM_OPEN_FAILED;
+    }
 
     return SUCCESS;
 }
@@ -85,18 +452,36 @@ RC PagedFileManager::openFile(const string &fileName, FileHandle &fileHandle)
 
 RC PagedFileManager::closeFile(FileHandle &fileHandle)
 {
-    FILE *pFile = fileHandle.getfd();
+    int fd = fileHandle.getfd();
 
     // If not an open file, error
-    if (pFile == NULL)
-        return 1;
+    if (fd == -1)
+        return PFM_FILE_NOT_OPEN;
 
-    // Flush and close the file
-    fclose(pFile);
+    // Write back whatever the buffer pool still holds for this file.
+    // Handles that hold writes back also make them durable now.
+    RC rc;
+    if (fileHandle._options.durability == DurabilityPerWrite)
+        rc = BufferPoolManager::instance()->flushFile(fileHandle);
+    else
+        rc = fileHandle.sync();
 
-    fileHandle.setfd(NULL);
+    // The file stays open in the table, unless it has been taken out of it meanwhile
+    {
+        lock_guard<mutex> lock(latch);
+        shared_ptr<FileState> &state = fileHandle._state;
+        if (--state->handles == 0 && findOpenFile(state->fileId) == state)
+        {
+            idleFiles.push_back(state->fileId);
+            closeIdleFiles();
+        }
+    }
 
-    return SUCCESS;
+    fileHandle.setfd(-1);
+    fileHandle._mapping.reset();
+    fileHandle._state.reset();
+
+    return rc;
 }
 
 FileHandle::FileHandle()
@@ -104,7 +489,15 @@ FileHandle::FileHandle()
     readPageCounter = 0;
     writePageCounter = 0;
     appendPageCounter = 0;
-    _fd = NULL;
+    _fd = -1;
+    _pageSize = PAGE_SIZE;
+    _directIO = false;
+    _checksums = false;
+    _accessPattern = AccessNormal;
+    _pendingWrites = 0;
+    _firstPendingMillis = 0;
+    _fileId.device = 0;
+    _fileId.inode = 0;
 }
 
 
@@ -117,72 +510,669 @@ FileHandle::~FileHandle()
 RC FileHandle::readPage(PageNum pageNum, void *data)
 {
     // If pageNum doesn't exist, error
-    if (getNumberOfPages() < pageNum)
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    // Get the page from the buffer pool, which only goes to disk on a miss
+    uint64_t start = IOStats::now();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    PageNum location = dataPageLocation(pageNum);
+    RC rc = bpm->pinPage(*this, location, true, page, LatchShared);
+    if (rc)
+        return rc == BPM_CHECKSUM_FAILED ? FH_CHECKSUM_FAILED : FH_READ_FAILED;
+    memcpy(data, page, _pageSize);
+    bpm->unpinPage(*this, location, false, LatchShared);
+
+    recordIO(IORead, start, _pageSize);
+    readPageCounter++;
+    return SUCCESS;
+}
+
+// Multi-page reads go around the buffer pool: one read per run of physically adjacent pages,
+// straight into the caller's buffer, without pushing other pages out of the pool.
+// Pages still dirty in the pool are written back first, so the file is current.
+
+// O_DIRECT needs a page-aligned buffer; anything else goes through the pool a page at a time
+static bool alignedForDirectIO(const void *data)
+{
+    return ((uintptr_t) data) % PAGE_SIZE == 0;
+}
+
+RC FileHandle::readPages(PageNum start, unsigned count, void *data)
+{
+    // If any of the pages doesn't exist, error
+    if (count > getNumberOfPages() || start > getNumberOfPages() - count)
         return FH_PAGE_DN_EXIST;
 
-    // Try to seek to the specified page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    if (_directIO && !alignedForDirectIO(data))
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            RC rc = readPage(start + i, (char*) data + (size_t) i * _pageSize);
+            if (rc)
+                return rc;
+        }
+        return SUCCESS;
+    }
+
+    uint64_t startNanos = IOStats::now();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (bpm->flushPage(*this, dataPageLocation(start + i)))
+            return FH_WRITE_FAILED;
+    }
+
+    RC rc = readRun(start, count, data);
+    if (rc)
+        return rc;
 
-    // Try to read the specified page
-    if (fread(data, 1, PAGE_SIZE, _fd) != PAGE_SIZE)
+    recordIO(IORead, startNanos, (uint64_t) count * _pageSize);
+    readPageCounter += count;
+    return SUCCESS;
+}
+
+// Reads consecutive data pages straight from the file, without looking at the buffer pool.
+// Safe to call from any thread.
+RC FileHandle::readRun(PageNum start, unsigned count, void *data)
+{
+    // A run only breaks where a free-space map page sits between two groups
+    unsigned done = 0;
+    while (done < count)
+    {
+        PageNum pageNum = start + done;
+        unsigned run = min(count - done, groupSize() - pageNum % groupSize());
+        char *runData = (char*) data + (size_t) done * _pageSize;
+        if (readFromFile(_fd, _pageSize, dataPageLocation(pageNum), run, runData))
+            return FH_READ_FAILED;
+        if (verifyChecksums(runData, run))
+            return FH_CHECKSUM_FAILED;
+        done += run;
+    }
+    return SUCCESS;
+}
+
+// preadv until every buffer is full
+static RC readVector(int fd, off_t offset, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t n = preadv(fd, iov, iovcnt, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        // A short file means a page isn't there
+        if (n <= 0)
+            return FH_READ_FAILED;
+        offset += n;
+
+        // Skip the buffers filled, and resume a partly filled one where the read stopped
+        while (iovcnt > 0 && (size_t) n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char*) iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return SUCCESS;
+}
+
+struct PageOrder
+{
+    const vector<PageNum> &pageNums;
+    PageOrder(const vector<PageNum> &pageNums) : pageNums(pageNums) {}
+    bool operator()(unsigned a, unsigned b) const { return pageNums[a] < pageNums[b]; }
+};
+
+RC FileHandle::readPages(const vector<PageNum> &pageNums, void *data)
+{
+    unsigned count = pageNums.size();
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (pageNums[i] >= getNumberOfPages())
+            return FH_PAGE_DN_EXIST;
+    }
+    if (count == 0)
+        return SUCCESS;
+
+    if (_directIO && !alignedForDirectIO(data))
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            RC rc = readPage(pageNums[i], (char*) data + (size_t) i * _pageSize);
+            if (rc)
+                return rc;
+        }
+        return SUCCESS;
+    }
+
+    uint64_t start = IOStats::now();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (bpm->flushPage(*this, dataPageLocation(pageNums[i])))
+            return FH_WRITE_FAILED;
+    }
+
+    // Visit the pages in file order, so pages next to each other in the file are read
+    // with a single preadv, each into its own place in the caller's buffer
+    vector<unsigned> order(count);
+    for (unsigned i = 0; i < count; i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), PageOrder(pageNums));
+
+    vector<struct iovec> iov;
+    unsigned i = 0;
+    while (i < count)
+    {
+        PageNum location = dataPageLocation(pageNums[order[i]]);
+        iov.clear();
+        do
+        {
+            struct iovec page;
+            page.iov_base = (char*) data + (size_t) order[i] * _pageSize;
+            page.iov_len = _pageSize;
+            iov.push_back(page);
+            i++;
+        }
+        while (i < count && iov.size() < IOV_MAX && dataPageLocation(pageNums[order[i]]) == location + iov.size());
+
+        if (readVector(_fd, (off_t) location * _pageSize, &iov[0], iov.size()))
+            return FH_READ_FAILED;
+    }
+    if (verifyChecksums(data, count))
+        return FH_CHECKSUM_FAILED;
+
+    recordIO(IORead, start, (uint64_t) count * _pageSize);
+    readPageCounter += count;
+    return SUCCESS;
+}
+
+RC FileHandle::readPageAsync(PageNum pageNum, void *data, IOToken &token)
+{
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+    if (_directIO && !alignedForDirectIO(data))
+        return FH_BUFFER_NOT_ALIGNED;
+
+    // The read goes to the file, which has to be current
+    PageNum location = dataPageLocation(pageNum);
+    if (BufferPoolManager::instance()->flushPage(*this, location))
+        return FH_WRITE_FAILED;
+    AsyncIOManager *aio = AsyncIOManager::instance();
+    RC rc = _checksums && _options.verifyChecksums ? aio->submitVerifiedRead(_fd, _pageSize, location, 1, data, token)
+                                                   : aio->submitRead(_fd, _pageSize, location, 1, data, token);
+    if (rc)
         return FH_READ_FAILED;
 
+    countBytes(IORead, _pageSize);
     readPageCounter++;
     return SUCCESS;
 }
 
+RC FileHandle::writePageAsync(PageNum pageNum, const void *data, IOToken &token)
+{
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+    if (_directIO && !alignedForDirectIO(data))
+        return FH_BUFFER_NOT_ALIGNED;
+
+    // With checksums the caller's page is left as it is: a stamped copy goes to disk, and is freed
+    // once written. It is made first, so nothing fails between the pool taking the page and the submit.
+    void *copy = NULL;
+    if (_checksums)
+    {
+        if (posix_memalign(&copy, PAGE_SIZE, _pageSize) != 0)
+            return FH_WRITE_FAILED;
+        memcpy(copy, data, _pageSize);
+        stampChecksum(copy);
+    }
+
+    // The pool takes the new contents first, so reads issued before the write lands don't go to
+    // the disk for the old page. The frame stays pinned and marked writing until the write completes,
+    // so flushes of later changes to the page wait and land after it. Should another write of the page
+    // be in flight, the new contents are written back through the pool behind it, and taken again.
+    PageNum location = dataPageLocation(pageNum);
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    PageId pageId;
+    pageId.fileId = _fileId;
+    pageId.pageNum = location;
+    uint64_t ticket;
+    while (true)
+    {
+        void *page;
+        if (bpm->pinPage(*this, location, false, page, LatchExclusive))
+        {
+            free(copy);
+            return FH_WRITE_FAILED;
+        }
+        memcpy(page, data, _pageSize);
+        stampChecksum(page);
+        bool busy;
+        RC rc = bpm->beginAsyncWrite(pageId, ticket, busy);
+        if (rc == SUCCESS && !busy)
+            break;
+        RC unpinned = bpm->unpinPage(*this, location, true, LatchExclusive);
+        if (rc || unpinned || bpm->flushPage(*this, location))
+        {
+            free(copy);
+            return FH_WRITE_FAILED;
+        }
+    }
+
+    IOCompletion completion = [bpm, pageId, ticket](RC result) { bpm->endAsyncWrite(pageId, ticket, result); };
+    AsyncIOManager *aio = AsyncIOManager::instance();
+    RC rc = _checksums ? aio->submitOwnedWrite(_fd, _pageSize, location, 1, (char*) copy, completion, token)
+                       : aio->submitWrite(_fd, _pageSize, location, 1, data, completion, token);
+    if (rc)
+    {
+        // The pool must not keep, as clean, contents that never reached the disk
+        bpm->endAsyncWrite(pageId, ticket, FH_WRITE_FAILED);
+        bpm->discardPage(*this, location);
+        return FH_WRITE_FAILED;
+    }
+    bpm->asyncWriteSubmitted(pageId, ticket, token);
+
+    countBytes(IOWrite, _pageSize);
+    writePageCounter++;
+    return SUCCESS;
+}
+
+RC FileHandle::readPagesAsync(const vector<PageNum> &pageNums, void *data, vector<IOToken> &tokens)
+{
+    tokens.clear();
+    for (unsigned i = 0; i < pageNums.size(); i++)
+    {
+        IOToken token;
+        RC rc = readPageAsync(pageNums[i], (char*) data + (size_t) i * _pageSize, token);
+        if (rc)
+            return rc;
+        tokens.push_back(token);
+    }
+    return SUCCESS;
+}
+
+RC FileHandle::writePagesAsync(const vector<PageNum> &pageNums, const void *data, vector<IOToken> &tokens)
+{
+    tokens.clear();
+    for (unsigned i = 0; i < pageNums.size(); i++)
+    {
+        IOToken token;
+        RC rc = writePageAsync(pageNums[i], (const char*) data + (size_t) i * _pageSize, token);
+        if (rc)
+            return rc;
+        tokens.push_back(token);
+    }
+    return SUCCESS;
+}
+
+RC FileHandle::pollIO(IOToken token, bool &done)
+{
+    return AsyncIOManager::instance()->poll(token, done);
+}
+
+RC FileHandle::waitIO(IOToken token)
+{
+    return AsyncIOManager::instance()->wait(token);
+}
+
+RC FileHandle::waitIO(const vector<IOToken> &tokens)
+{
+    return AsyncIOManager::instance()->wait(tokens);
+}
+
 //method writes the given data into a page specified by pageNum.
 // The page should exist. Page numbers start from 0.
 RC FileHandle::writePage(PageNum pageNum, const void *data)
 {
     // Check if the page exists
-    if (getNumberOfPages() < pageNum)
+    if (pageNum >= getNumberOfPages())
         return FH_PAGE_DN_EXIST;
 
-    // Seek to the start of the page
-    if (fseek(_fd, PAGE_SIZE * pageNum, SEEK_SET))
-        return FH_SEEK_FAILED;
+    // The whole page is overwritten, so there is no need to read it on a miss
+    uint64_t start = IOStats::now();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    PageNum location = dataPageLocation(pageNum);
+    if (bpm->pinPage(*this, location, false, page, LatchExclusive))
+        return FH_WRITE_FAILED;
+    memcpy(page, data, _pageSize);
+    stampChecksum(page);
+    bpm->unpinPage(*this, location, true, LatchExclusive);
+
+    // Commit changes to disk as the durability mode asks
+    if (commitWrite(location))
+        return FH_WRITE_FAILED;
+
+    recordIO(IOWrite, start, _pageSize);
+    writePageCounter++;
+    return SUCCESS;
+}
+
+
+RC FileHandle::appendPage(const void *data)
+{
+    return appendPages(1, data);
+}
+
+
+RC FileHandle::appendPages(unsigned count, const void *data)
+{
+    PageNum first;
+    return appendPages(count, data, first);
+}
 
-    // Write the page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+
+RC FileHandle::appendPages(unsigned count, const void *data, PageNum &firstPageNum)
+{
+    if (count == 0)
     {
-        // Immediately commit changes to disk
-        fflush(_fd);
-        writePageCounter++;
+        firstPageNum = getNumberOfPages();
         return SUCCESS;
     }
 
-    return FH_WRITE_FAILED;
+    // Appends to the file, from any handle, go one after another
+    uint64_t start = IOStats::now();
+    unique_lock<mutex> lock(_state->latch);
+    PageNum first = getNumberOfPages();
+    firstPageNum = first;
+    if (count > getMaxNumberOfPages() - first)
+        return FH_FILE_FULL;
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+
+    reserveExtent(dataPageLocation(first + count - 1));
+
+    // A single page goes into the pool, since it is usually read again right away.
+    // A batch is written straight to the file, one write per run of physically adjacent pages,
+    // unless the caller's buffer may be unfit for O_DIRECT or the pages need their checksums set.
+    bool throughPool = count == 1 || _directIO || _checksums;
+    const char *runData = (const char*) data;
+    PageNum runStart = dataPageLocation(first);
+    unsigned runLength = 0;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        PageNum pageNum = first + i;
+        const char *pageData = (const char*) data + (size_t) i * _pageSize;
+
+        // The first page of a group is preceded by the group's free-space map page.
+        // It starts out all zero (no free space known) and reaches disk with the first update.
+        if (pageNum % groupSize() == 0)
+        {
+            if (runLength > 0 && writeToFile(_fd, _pageSize, runStart, runLength, runData))
+                return FH_WRITE_FAILED;
+            runData = pageData;
+            runStart = dataPageLocation(pageNum);
+            runLength = 0;
+
+            if (clearFreeSpaceMap(pageNum / groupSize()))
+                return FH_WRITE_FAILED;
+        }
+
+        if (throughPool)
+        {
+            PageNum location = dataPageLocation(pageNum);
+            if (bpm->pinPage(*this, location, false, page, LatchExclusive))
+                return FH_WRITE_FAILED;
+            memcpy(page, pageData, _pageSize);
+            stampChecksum(page);
+            bpm->unpinPage(*this, location, true, LatchExclusive);
+        }
+        else
+            runLength++;
+    }
+    if (runLength > 0 && writeToFile(_fd, _pageSize, runStart, runLength, runData))
+        return FH_WRITE_FAILED;
+
+    if (addPages(count))
+        return FH_WRITE_FAILED;
+    lock.unlock();
+
+    // Commit the new pages to disk as the durability mode asks.
+    // Pages written straight to the file only count towards a group commit.
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (commitWrite(dataPageLocation(first + i)))
+            return FH_WRITE_FAILED;
+    }
+
+    recordIO(IOAppend, start, (uint64_t) count * _pageSize);
+    appendPageCounter += count;
+    return SUCCESS;
 }
 
+// The free-space map page of a new group starts out all zero (no free space known)
+// and reaches disk with the first update
+RC FileHandle::clearFreeSpaceMap(unsigned group)
+{
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    PageNum fsmLocation = fsmPageLocation(group);
+    if (bpm->pinPage(*this, fsmLocation, false, page, LatchExclusive))
+        return FH_WRITE_FAILED;
+    memset(page, 0, _pageSize);
+    bpm->unpinPage(*this, fsmLocation, true, LatchExclusive);
+    return SUCCESS;
+}
 
-RC FileHandle::appendPage(const void *data)
+// Counts pages just appended, and records the new page count in the header, which is written back lazily
+RC FileHandle::addPages(unsigned count)
 {
-    // Seek to the end of the file
-    if (fseek(_fd, 0, SEEK_END))
-        return FH_SEEK_FAILED;
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    if (bpm->pinPage(*this, 0, true, page, LatchExclusive))
+        return FH_WRITE_FAILED;
+    _state->numPages += count;
+    FileHeader header;
+    memcpy(&header, page, sizeof(FileHeader));
+    header.numPages = _state->numPages;
+    memcpy(page, &header, sizeof(FileHeader));
+    bpm->unpinPage(*this, 0, true, LatchExclusive);
+    return SUCCESS;
+}
 
-    // Write the new page
-    if (fwrite(data, 1, PAGE_SIZE, _fd) == PAGE_SIZE)
+RC FileHandle::pinPage(PageNum pageNum, ReadPageGuard &guard)
+{
+    guard.release();
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    uint64_t start = IOStats::now();
+    void *page;
+    RC rc = BufferPoolManager::instance()->pinPage(*this, dataPageLocation(pageNum), true, page, LatchShared);
+    if (rc)
+        return rc == BPM_CHECKSUM_FAILED ? FH_CHECKSUM_FAILED : FH_READ_FAILED;
+    guard.hold(this, pageNum, page, false, false);
+
+    recordIO(IORead, start, _pageSize);
+    readPageCounter++;
+    return SUCCESS;
+}
+
+RC FileHandle::pinPage(PageNum pageNum, WritePageGuard &guard)
+{
+    guard.release();
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    void *page;
+    RC rc = BufferPoolManager::instance()->pinPage(*this, dataPageLocation(pageNum), true, page, LatchExclusive);
+    if (rc)
+        return rc == BPM_CHECKSUM_FAILED ? FH_CHECKSUM_FAILED : FH_READ_FAILED;
+    guard.hold(this, pageNum, page, true, false);
+    return SUCCESS;
+}
+
+// The page counts as appended right away; it is committed when the guard lets go of it.
+// Other threads that find it meanwhile wait for the guard's latch.
+RC FileHandle::appendPage(WritePageGuard &guard)
+{
+    guard.release();
+    lock_guard<mutex> lock(_state->latch);
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    PageNum pageNum = getNumberOfPages();
+    if (pageNum >= getMaxNumberOfPages())
+        return FH_FILE_FULL;
+    PageNum location = dataPageLocation(pageNum);
+    void *page;
+
+    reserveExtent(location);
+    if (pageNum % groupSize() == 0 && clearFreeSpaceMap(pageNum / groupSize()))
+        return FH_WRITE_FAILED;
+
+    if (bpm->pinPage(*this, location, false, page, LatchExclusive))
+        return FH_WRITE_FAILED;
+    memset(page, 0, _pageSize);
+    if (addPages(1))
     {
-        fflush(_fd);
-        appendPageCounter++;
-        return SUCCESS;
+        bpm->unpinPage(*this, location, false, LatchExclusive);
+        return FH_WRITE_FAILED;
+    }
+    guard.hold(this, pageNum, page, true, true);
+
+    appendPageCounter++;
+    return SUCCESS;
+}
+
+
+PageGuard::PageGuard()
+{
+    _fileHandle = NULL;
+    _pageNum = 0;
+    _data = NULL;
+    _exclusive = false;
+    _dirty = false;
+    _appended = false;
+}
+
+PageGuard::PageGuard(PageGuard &&other)
+{
+    _fileHandle = other._fileHandle;
+    _pageNum = other._pageNum;
+    _data = other._data;
+    _exclusive = other._exclusive;
+    _dirty = other._dirty;
+    _appended = other._appended;
+    other._fileHandle = NULL;
+    other._data = NULL;
+}
+
+PageGuard& PageGuard::operator=(PageGuard &&other)
+{
+    if (this != &other)
+    {
+        release();
+        _fileHandle = other._fileHandle;
+        _pageNum = other._pageNum;
+        _data = other._data;
+        _exclusive = other._exclusive;
+        _dirty = other._dirty;
+        _appended = other._appended;
+        other._fileHandle = NULL;
+        other._data = NULL;
     }
-    return FH_WRITE_FAILED;
+    return *this;
+}
+
+// Callers that need to know whether a change reached the disk call release() themselves
+PageGuard::~PageGuard()
+{
+    release();
+}
+
+bool PageGuard::isPinned() const
+{
+    return _fileHandle != NULL;
+}
+
+PageNum PageGuard::getPageNum() const
+{
+    return _pageNum;
+}
+
+const void* PageGuard::data() const
+{
+    return _data;
+}
+
+// An appended page is new, so it is dirty from the start
+void PageGuard::hold(FileHandle *fileHandle, PageNum pageNum, void *data, bool exclusive, bool appended)
+{
+    _fileHandle = fileHandle;
+    _pageNum = pageNum;
+    _data = data;
+    _exclusive = exclusive;
+    _dirty = appended;
+    _appended = appended;
 }
 
+RC PageGuard::release()
+{
+    if (_fileHandle == NULL)
+        return SUCCESS;
+
+    FileHandle *fileHandle = _fileHandle;
+    void *data = _data;
+    _fileHandle = NULL;
+    _data = NULL;
+
+    // The checksum is set while the page is still latched exclusively
+    PageNum location = fileHandle->dataPageLocation(_pageNum);
+    if (_dirty)
+        fileHandle->stampChecksum(data);
+    BufferPoolManager::instance()->unpinPage(*fileHandle, location, _dirty, _exclusive ? LatchExclusive : LatchShared);
+    if (!_dirty)
+        return SUCCESS;
+
+    // Commit the change to disk as the durability mode asks; that is what the change costs
+    uint64_t start = IOStats::now();
+    if (fileHandle->commitWrite(location))
+        return FH_WRITE_FAILED;
+    fileHandle->recordIO(_appended ? IOAppend : IOWrite, start, fileHandle->_pageSize);
+    if (!_appended)
+        fileHandle->writePageCounter++;
+    return SUCCESS;
+}
 
+void* WritePageGuard::mutableData()
+{
+    _dirty = true;
+    return _data;
+}
+
+
+// Kept in the state shared by every handle on the file, so this costs no system call
 unsigned FileHandle::getNumberOfPages()
 {
-    // Use stat to get the file size
-    struct stat sb;
-    if (fstat(fileno(_fd), &sb) != 0)
-        // On error, return 0
+    if (!_state)
         return 0;
-    // Filesize is always PAGE_SIZE * number of pages
-    return sb.st_size / PAGE_SIZE;
+    return _state->numPages;
+}
+
+PageNum FileHandle::getMaxNumberOfPages()
+{
+    return withPageLayout(_pageSize, [](auto layout) { return decltype(layout)::maxPages; });
+}
+
+unsigned FileHandle::getPageSize()
+{
+    return _pageSize;
+}
+
+unsigned FileHandle::getUsablePageSize()
+{
+    return _checksums ? _pageSize - PFM_CHECKSUM_SIZE : _pageSize;
+}
+
+bool FileHandle::hasChecksums()
+{
+    return _checksums;
 }
 
 
@@ -194,10 +1184,585 @@ RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePage
     return SUCCESS;
 }
 
-void FileHandle::setfd(FILE * fd){
+RC FileHandle::collectStats(IOStatsSnapshot &stats)
+{
+    if (!_state)
+        return PFM_FILE_NOT_OPEN;
+    _state->stats.snapshot(stats);
+    return SUCCESS;
+}
+
+RC FileHandle::resetStats()
+{
+    if (!_state)
+        return PFM_FILE_NOT_OPEN;
+    _state->stats.reset();
+    return SUCCESS;
+}
+
+// Counts an operation that has just succeeded in the file's statistics and the global ones
+void FileHandle::recordIO(IOOp op, uint64_t startNanos, uint64_t bytes)
+{
+    uint64_t nanos = IOStats::now() - startNanos;
+    _state->stats.recordLatency(op, nanos);
+    IOStats::global().recordLatency(op, nanos);
+    countBytes(op, bytes);
+}
+
+void FileHandle::countBytes(IOOp op, uint64_t bytes)
+{
+    if (bytes == 0)
+        return;
+    IOStats &global = IOStats::global();
+    if (op == IORead)
+    {
+        _state->stats.addBytesRead(bytes);
+        global.addBytesRead(bytes);
+    }
+    else
+    {
+        _state->stats.addBytesWritten(bytes);
+        global.addBytesWritten(bytes);
+    }
+}
+
+// Called by the buffer pool for every page this handle pins
+void FileHandle::countPoolAccess(bool hit, bool evicted)
+{
+    _state->stats.countPoolAccess(hit, evicted);
+    IOStats::global().countPoolAccess(hit, evicted);
+}
+
+// Sets the free-space map entry of a page, keeping the per-group maximum in the header up to date.
+// The map is only a hint, so its pages are left dirty in the buffer pool rather than written through.
+RC FileHandle::setPageFreeSpace(PageNum pageNum, unsigned freeBytes)
+{
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    return withPageLayout(_pageSize, [&](auto layout) { return setPageFreeSpace(layout, pageNum, freeBytes); });
+}
+
+template <class Layout>
+RC FileHandle::setPageFreeSpace(Layout layout, PageNum pageNum, unsigned freeBytes)
+{
+    unsigned bucket = freeBytes / Layout::bucketSize;
+    if (bucket >= FSM_FREE_PAGE)
+        bucket = FSM_FREE_PAGE - 1;
+
+    unsigned char oldBucket;
+    return setPageBucket(layout, pageNum, bucket, false, oldBucket);
+}
+
+// Sets the map byte of a page. Only a change of its free mark (freeMark) may set or clear
+// FSM_FREE_PAGE; a free space update to a free page is dropped, since the page is not in use.
+template <class Layout>
+RC FileHandle::setPageBucket(Layout, PageNum pageNum, unsigned char bucket, bool freeMark, unsigned char &oldBucket)
+{
+    unsigned group = pageNum / Layout::groupSize;
+
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    PageNum fsmLocation = Layout::fsmPageLocation(group);
+    if (bpm->pinPage(*this, fsmLocation, true, page, LatchExclusive))
+        return FH_READ_FAILED;
+
+    unsigned char *buckets = (unsigned char*) page;
+    oldBucket = buckets[pageNum % Layout::groupSize];
+    if (oldBucket == bucket || (!freeMark && oldBucket == FSM_FREE_PAGE))
+    {
+        bpm->unpinPage(*this, fsmLocation, false, LatchExclusive);
+        return SUCCESS;
+    }
+    buckets[pageNum % Layout::groupSize] = bucket;
+
+    // Work out the new largest bucket of the group while the map page is pinned
+    unsigned char groupMax = 0;
+    for (unsigned i = 0; i < Layout::groupSize; i++)
+    {
+        if (buckets[i] > groupMax && buckets[i] != FSM_FREE_PAGE)
+            groupMax = buckets[i];
+    }
+    bpm->unpinPage(*this, fsmLocation, true, LatchExclusive);
+
+    // Groups past the end of the header directory are always searched, so there is nothing to keep
+    if (group >= Layout::directorySize)
+        return SUCCESS;
+
+    if (bpm->pinPage(*this, 0, true, page, LatchExclusive))
+        return FH_READ_FAILED;
+    unsigned char *directory = (unsigned char*) page + PFM_HEADER_SIZE;
+    bool changed = directory[group] != groupMax;
+    directory[group] = groupMax;
+    bpm->unpinPage(*this, 0, changed, LatchExclusive);
+
+    return SUCCESS;
+}
+
+// First fit: walk the header directory for a group that has a large enough bucket,
+// then look for the page in that group's map page.
+RC FileHandle::findPageWithFreeSpace(unsigned freeBytes, PageNum &pageNum)
+{
+    return withPageLayout(_pageSize, [&](auto layout) { return findPageWithFreeSpace(layout, freeBytes, pageNum); });
+}
+
+template <class Layout>
+RC FileHandle::findPageWithFreeSpace(Layout, unsigned freeBytes, PageNum &pageNum)
+{
+    unsigned numPages = getNumberOfPages();
+    if (numPages == 0)
+        return FH_NO_FREE_PAGE;
+
+    // Round up, so any page in a matching bucket really has the room
+    unsigned wanted = (freeBytes + Layout::bucketSize - 1) / Layout::bucketSize;
+    if (wanted >= FSM_FREE_PAGE)
+        return FH_NO_FREE_PAGE;
+    if (wanted == 0)
+        wanted = 1;
+
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    if (bpm->pinPage(*this, 0, true, page, LatchShared))
+        return FH_READ_FAILED;
+    // Only as much of the directory as there are groups
+    unsigned groups = (numPages + Layout::groupSize - 1) / Layout::groupSize;
+    unsigned char directory[Layout::directorySize];
+    memcpy(directory, (char*) page + PFM_HEADER_SIZE, groups < Layout::directorySize ? groups : Layout::directorySize);
+    bpm->unpinPage(*this, 0, false, LatchShared);
+
+    for (unsigned group = 0; group < groups; group++)
+    {
+        if (group < Layout::directorySize && directory[group] < wanted)
+            continue;
+
+        PageNum fsmLocation = Layout::fsmPageLocation(group);
+        if (bpm->pinPage(*this, fsmLocation, true, page, LatchShared))
+            return FH_READ_FAILED;
+        unsigned char *buckets = (unsigned char*) page;
+        unsigned first = group * Layout::groupSize;
+        unsigned count = numPages - first < Layout::groupSize ? numPages - first : Layout::groupSize;
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (buckets[i] >= wanted && buckets[i] != FSM_FREE_PAGE)
+            {
+                bpm->unpinPage(*this, fsmLocation, false, LatchShared);
+                pageNum = first + i;
+                return SUCCESS;
+            }
+        }
+        bpm->unpinPage(*this, fsmLocation, false, LatchShared);
+    }
+    return FH_NO_FREE_PAGE;
+}
+
+// Looks for a page marked free, from the first group that may have one. Called with the file latch held.
+template <class Layout>
+RC FileHandle::findFreePage(Layout, PageNum &pageNum)
+{
+    unsigned numPages = getNumberOfPages();
+    unsigned groups = (numPages + Layout::groupSize - 1) / Layout::groupSize;
+
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    for (unsigned group = _state->freeGroupHint; group < groups; group++)
+    {
+        PageNum fsmLocation = Layout::fsmPageLocation(group);
+        if (bpm->pinPage(*this, fsmLocation, true, page, LatchShared))
+            return FH_READ_FAILED;
+        const unsigned char *buckets = (const unsigned char*) page;
+        unsigned first = group * Layout::groupSize;
+        unsigned count = numPages - first < Layout::groupSize ? numPages - first : Layout::groupSize;
+        const unsigned char *found = (const unsigned char*) memchr(buckets, FSM_FREE_PAGE, count);
+        bpm->unpinPage(*this, fsmLocation, false, LatchShared);
+
+        if (found != NULL)
+        {
+            pageNum = first + (found - buckets);
+            _state->freeGroupHint = group;
+            return SUCCESS;
+        }
+    }
+    _state->freeGroupHint = groups;
+    return FH_NO_FREE_PAGE;
+}
+
+PageNum FileHandle::dataPageLocation(PageNum pageNum)
+{
+    return withPageLayout(_pageSize, [pageNum](auto layout) { return layout.dataPageLocation(pageNum); });
+}
+
+PageNum FileHandle::fsmPageLocation(unsigned group)
+{
+    return withPageLayout(_pageSize, [group](auto layout) { return layout.fsmPageLocation(group); });
+}
+
+// A map page has a byte for every data page of its group
+unsigned FileHandle::groupSize()
+{
+    return _pageSize;
+}
+
+// Anything but the header and the free-space map pages
+bool FileHandle::isDataLocation(PageNum location)
+{
+    return withPageLayout(_pageSize, [location](auto layout) {
+        return location != 0 && (location - 1) % (decltype(layout)::groupSize + 1) != 0;
+    });
+}
+
+uint32_t FileHandle::pageChecksum(const void *page, unsigned pageSize)
+{
+    return crc32c(page, pageSize - PFM_CHECKSUM_SIZE);
+}
+
+// A page never written, a hole in the file or a punched free page, reads as all zeros and passes
+bool FileHandle::checksumMatches(const void *page, unsigned pageSize)
+{
+    uint32_t stored;
+    memcpy(&stored, (const char*) page + pageSize - PFM_CHECKSUM_SIZE, sizeof(uint32_t));
+    if (stored == pageChecksum(page, pageSize))
+        return true;
+    const char *bytes = (const char*) page;
+    return bytes[0] == 0 && memcmp(bytes, bytes + 1, pageSize - 1) == 0;
+}
+
+// Sets the checksum of a data page that is about to be let go of, changed
+void FileHandle::stampChecksum(void *page)
+{
+    if (!_checksums)
+        return;
+    uint32_t checksum = pageChecksum(page, _pageSize);
+    memcpy((char*) page + _pageSize - PFM_CHECKSUM_SIZE, &checksum, sizeof(uint32_t));
+}
+
+// Checks count data pages just read from disk, back to back in data
+RC FileHandle::verifyChecksums(const void *data, unsigned count)
+{
+    if (!_checksums || !_options.verifyChecksums)
+        return SUCCESS;
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!checksumMatches((const char*) data + (size_t) i * _pageSize, _pageSize))
+            return FH_CHECKSUM_FAILED;
+    }
+    return SUCCESS;
+}
+
+static uint64_t currentMillis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// A free page keeps its contents until it is handed out again or punched out; the caller is done
+// with it, and may still hold its write guard, so nothing is added to it meanwhile.
+RC FileHandle::freePage(PageNum pageNum)
+{
+    if (pageNum >= getNumberOfPages())
+        return FH_PAGE_DN_EXIST;
+
+    lock_guard<mutex> lock(_state->latch);
+    unsigned char oldBucket;
+    if (withPageLayout(_pageSize, [&](auto layout) { return setPageBucket(layout, pageNum, FSM_FREE_PAGE, true, oldBucket); }))
+        return FH_WRITE_FAILED;
+    if (oldBucket == FSM_FREE_PAGE)
+        return SUCCESS;
+    if (countFreePages(1))
+        return FH_WRITE_FAILED;
+    if (pageNum / groupSize() < _state->freeGroupHint)
+        _state->freeGroupHint = pageNum / groupSize();
+
+    if (_options.punchHoleMillis > 0)
+    {
+        uint64_t now = currentMillis();
+        _state->idleFreePages.push_back(make_pair(pageNum, now));
+        _state->freedAt[pageNum] = now;
+    }
+    punchIdlePages();
+    return SUCCESS;
+}
+
+// The page is taken out of the map under the file latch, and only latched itself after that:
+// a thread that reached it through a stale free-space entry meanwhile finds it zeroed, as
+// free pages are left by their users, and moves on.
+RC FileHandle::allocatePage(WritePageGuard &guard)
+{
+    guard.release();
+    unique_lock<mutex> lock(_state->latch);
+    punchIdlePages();
+    if (_state->freePages == 0)
+    {
+        lock.unlock();
+        return appendPage(guard);
+    }
+
+    PageNum pageNum;
+    RC rc = withPageLayout(_pageSize, [&](auto layout) { return findFreePage(layout, pageNum); });
+    if (rc == FH_NO_FREE_PAGE)
+    {
+        // The header counted pages whose marks never reached the disk
+        countFreePages(-(int) _state->freePages);
+        lock.unlock();
+        return appendPage(guard);
+    }
+    if (rc)
+        return rc;
+
+    unsigned char oldBucket;
+    if (withPageLayout(_pageSize, [&](auto layout) { return setPageBucket(layout, pageNum, 0, true, oldBucket); }))
+        return FH_WRITE_FAILED;
+    _state->freedAt.erase(pageNum);
+    if (countFreePages(-1))
+        return FH_WRITE_FAILED;
+    lock.unlock();
+
+    // Whatever is on the page is overwritten, so there is no need to read it on a miss
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    if (bpm->pinPage(*this, dataPageLocation(pageNum), false, page, LatchExclusive))
+        return FH_WRITE_FAILED;
+    memset(page, 0, _pageSize);
+    guard.hold(this, pageNum, page, true, false);
+    return SUCCESS;
+}
+
+unsigned FileHandle::getNumberOfFreePages()
+{
+    if (!_state)
+        return 0;
+    lock_guard<mutex> lock(_state->latch);
+    return _state->freePages;
+}
+
+// Counts pages freed or handed out in the header, which is written back lazily, as for the page count
+RC FileHandle::countFreePages(int change)
+{
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    void *page;
+    if (bpm->pinPage(*this, 0, true, page, LatchExclusive))
+        return FH_WRITE_FAILED;
+    _state->freePages += change;
+    FileHeader header;
+    memcpy(&header, page, sizeof(FileHeader));
+    header.freePages = _state->freePages;
+    memcpy(page, &header, sizeof(FileHeader));
+    bpm->unpinPage(*this, 0, true, LatchExclusive);
+    return SUCCESS;
+}
+
+// Gives the disk space of pages free for punchHoleMillis back to the file system, without
+// changing the file size. A punched page reads as zeros. Called with the file latch held.
+// Only pages freed through handles asking for it, in this session, are punched.
+void FileHandle::punchIdlePages()
+{
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (_options.punchHoleMillis == 0)
+        return;
+
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    uint64_t now = currentMillis();
+    while (!_state->idleFreePages.empty() && now - _state->idleFreePages.front().second >= _options.punchHoleMillis)
+    {
+        pair<PageNum, uint64_t> idle = _state->idleFreePages.front();
+        _state->idleFreePages.pop_front();
+
+        // Handed out since, or freed again later
+        map<PageNum, uint64_t>::iterator it = _state->freedAt.find(idle.first);
+        if (it == _state->freedAt.end() || it->second != idle.second)
+            continue;
+
+        // A copy in the buffer pool would bring the space back when written; one still pinned waits another round
+        PageNum location = dataPageLocation(idle.first);
+        if (bpm->discardPage(*this, location))
+        {
+            _state->idleFreePages.push_back(make_pair(idle.first, now));
+            it->second = now;
+            continue;
+        }
+        _state->freedAt.erase(it);
+
+        // Not an error: the page just keeps its disk space
+        if (fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) location * _pageSize, _pageSize) != 0
+                && (errno == EOPNOTSUPP || errno == ENOSYS))
+        {
+            _state->idleFreePages.clear();
+            _state->freedAt.clear();
+            return;
+        }
+    }
+#endif
+}
+
+// Called after a page has been modified in the buffer pool
+RC FileHandle::commitWrite(PageNum location)
+{
+    switch (_options.durability)
+    {
+        case DurabilityPerWrite:
+            return BufferPoolManager::instance()->flushPage(*this, location);
+        case DurabilityGroupCommit:
+        {
+            // The time limit is checked as writes come in, so an idle handle holds its writes until the next one
+            uint64_t now = currentMillis();
+            if (_pendingWrites == 0)
+                _firstPendingMillis = now;
+            _pendingWrites++;
+            if (_pendingWrites >= _options.groupCommitPages || now - _firstPendingMillis >= _options.groupCommitMillis)
+                return sync();
+            return SUCCESS;
+        }
+        case DurabilityDeferred:
+        case DurabilityWriteBack:
+            return SUCCESS;
+    }
+    return SUCCESS;
+}
+
+// Barrier: once this returns, every write made to the file so far is on disk
+RC FileHandle::sync()
+{
+    if (_fd == -1)
+        return FH_SYNC_FAILED;
+
+    uint64_t start = IOStats::now();
+    if (BufferPoolManager::instance()->flushFile(*this))
+        return FH_WRITE_FAILED;
+    if (fdatasync(_fd) != 0)
+        return FH_SYNC_FAILED;
+
+    recordIO(IOSync, start, 0);
+    _pendingWrites = 0;
+    return SUCCESS;
+}
+
+// Reserves disk space a whole extent at a time, so a growing file stays contiguous on disk
+// and appends don't each pay for a block allocation. The file size is left alone:
+// it still ends where the data written so far ends.
+void FileHandle::reserveExtent(PageNum location)
+{
+#ifdef FALLOC_FL_KEEP_SIZE
+    unsigned extentPages = _options.extentPages;
+    if (extentPages == 0 || !_state->preallocate || location < _state->allocatedPages)
+        return;
+
+    // The last extent stops at the last page a page number can reach
+    PageNum end = min((uint64_t) (location / extentPages + 1) * extentPages, (uint64_t) UINT_MAX);
+    off_t offset = (off_t) _state->allocatedPages * _pageSize;
+    off_t length = (off_t) (end - _state->allocatedPages) * _pageSize;
+    if (fallocate(_fd, FALLOC_FL_KEEP_SIZE, offset, length) != 0)
+    {
+        // Not an error: the file just grows a page at a time
+        if (errno == EOPNOTSUPP || errno == ENOSYS)
+            _state->preallocate = false;
+        return;
+    }
+    _state->allocatedPages = end;
+#else
+    (void) location;
+#endif
+}
+
+// Maps at least minLength bytes of the file, with room to grow
+RC FileHandle::mapFile(size_t minLength)
+{
+    size_t length = MMAP_MIN_LENGTH;
+    while (length < minLength)
+        length *= 2;
+
+    void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, _fd, 0);
+    if (base == MAP_FAILED)
+        return FH_READ_FAILED;
+
+    // The old mapping goes away once no copy of this handle uses it any more
+    _mapping.reset(new FileMapping((char*) base, length));
+    return SUCCESS;
+}
+
+const void* FileHandle::pageAddress(PageNum pageNum)
+{
+    if (!_mapping || pageNum >= getNumberOfPages())
+        return NULL;
+
+    // A page still dirty in the buffer pool hasn't reached the file yet
+    PageNum location = dataPageLocation(pageNum);
+    if (BufferPoolManager::instance()->flushPage(*this, location))
+        return NULL;
+
+    size_t end = ((size_t) location + 1) * _pageSize;
+    if (end > _mapping->length && mapFile(end))
+        return NULL;
+
+    readPageCounter++;
+    return _mapping->base + (size_t) location * _pageSize;
+}
+
+bool FileHandle::isDirectIO()
+{
+    return _directIO;
+}
+
+bool FileHandle::isReadAhead()
+{
+    return _options.readAhead && !_mapping;
+}
+
+void FileHandle::setAccessPattern(AccessPattern pattern)
+{
+    _accessPattern = pattern;
+}
+
+void FileHandle::setfd(int fd){
     _fd = fd;
 }
 
-FILE* FileHandle::getfd(){
+int FileHandle::getfd(){
     return _fd;
-}
\ No newline at end of file
+}
+
+// Positional reads and writes: no shared file offset and no stdio buffer in between.
+// Both loop, since the kernel may move fewer bytes than asked for.
+RC FileHandle::readFromFile(int fd, unsigned pageSize, PageNum pageNum, void *data)
+{
+    return readFromFile(fd, pageSize, pageNum, 1, data);
+}
+
+RC FileHandle::readFromFile(int fd, unsigned pageSize, PageNum pageNum, unsigned count, void *data)
+{
+    off_t offset = (off_t) pageNum * pageSize;
+    size_t total = (size_t) count * pageSize;
+    size_t done = 0;
+    while (done < total)
+    {
+        ssize_t n = pread(fd, (char*) data + done, total - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        // A short file means the page isn't there
+        if (n <= 0)
+            return FH_READ_FAILED;
+        done += n;
+    }
+    return SUCCESS;
+}
+
+RC FileHandle::writeToFile(int fd, unsigned pageSize, PageNum pageNum, const void *data)
+{
+    return writeToFile(fd, pageSize, pageNum, 1, data);
+}
+
+RC FileHandle::writeToFile(int fd, unsigned pageSize, PageNum pageNum, unsigned count, const void *data)
+{
+    off_t offset = (off_t) pageNum * pageSize;
+    size_t total = (size_t) count * pageSize;
+    size_t done = 0;
+    while (done < total)
+    {
+        ssize_t n = pwrite(fd, (const char*) data + done, total - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return FH_WRITE_FAILED;
+        done += n;
+    }
+    return SUCCESS;
+}
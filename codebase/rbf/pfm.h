@@ -5,7 +5,8 @@ typedef unsigned PageNum;
 typedef int RC;
 typedef char byte;
 
-#define PAGE_SIZE 4096
+#define PAGE_SIZE 4096                  // the default page size, and the smallest
+#define PFM_MAX_PAGE_SIZE 65536
 #define SUCCESS 0
 
 #define PFM_FILE_EXISTS   1
@@ -14,16 +15,162 @@ typedef char byte;
 #define PFM_HANDLE_IN_USE 4
 #define PFM_FILE_DN_EXIST 5
 #define PFM_FILE_NOT_OPEN 6
+#define PFM_NOT_PAGED_FILE 7
+#define PFM_BAD_PAGE_SIZE 8
 
 #define FH_PAGE_DN_EXIST  1
 #define FH_SEEK_FAILED    2
 #define FH_READ_FAILED    3
 #define FH_WRITE_FAILED   4
+#define FH_NO_FREE_PAGE   5
+#define FH_SYNC_FAILED    6
+#define FH_BUFFER_NOT_ALIGNED 7
+#define FH_FILE_FULL      8
+#define FH_CHECKSUM_FAILED 9
+
+// Physical layout of a paged file:
+//   [header page] [FSM page 0] [group size data pages] [FSM page 1] [group size data pages] ...
+// The header and the free-space map (FSM) pages are hidden; page numbers seen through FileHandle
+// only count data pages. Every FSM page keeps one byte per data page of its group, the free space
+// of that page in bucket size units. The header keeps, per group, the largest bucket in it,
+// so finding a page with room costs one FSM page read.
+// A page given back with freePage() is marked FSM_FREE_PAGE in its map byte and counted in the
+// header; new pages come from these before the file grows. A mark in the map, unlike a list
+// threaded through the pages, survives the page's disk space being punched out.
+// Every page of a file has the size the file was created with, one of 4, 8, 16, 32 or 64 KB,
+// and the group size, bucket size and header directory all scale with it (see PageLayout).
+// Page numbers are 32 bits, byte offsets 64 (off_t, with pread/pwrite), so files grow well past 4 GB.
+// A file holds as many data pages as keep every physical page number within 32 bits:
+// about 16 TB with 4 KB pages, 256 TB with 64 KB pages (PageLayout::maxPages).
+// A file created with PFM_PAGE_CHECKSUMS keeps a CRC32C of every data page in the page's last
+// PFM_CHECKSUM_SIZE bytes, which its users leave alone (getUsablePageSize). The checksum is set
+// whenever a changed page is let go of, and checked whenever a page is read from disk; a page found
+// in the buffer pool was checked on its way in. An all-zero page, a hole or a punched free page,
+// passes. Header and free-space map pages are rebuilt or only hints, so they carry none.
+#define PFM_FILE_MAGIC      0x31464250  // "PBF1"
+#define PFM_FILE_VERSION    5
+#define PFM_HEADER_SIZE     64          // bytes reserved for FileHeader before the group directory
+#define PFM_PAGE_CHECKSUMS  0x1         // file flag: data pages end in a checksum
+#define PFM_CHECKSUM_SIZE   4
+
+// The layout of files with the default page size
+#define FSM_GROUP_SIZE      PAGE_SIZE
+#define FSM_BUCKET_SIZE     (PAGE_SIZE / 256)
+#define FSM_DIRECTORY_SIZE  (PAGE_SIZE - PFM_HEADER_SIZE)
+#define FSM_FREE_PAGE       255         // map byte of a free page; free space buckets stop one short of it
+
+#define PFM_DEFAULT_OPEN_FILES 64       // files the open-file table keeps descriptors for, idle ones included
 #include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <climits>
+#include <inttypes.h>
+#include "iostats.h"
 using namespace std;
 
 class FileHandle;
+class ReadPageGuard;
+class WritePageGuard;
+struct FileMapping;
+struct FileState;
+
+typedef struct FileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numPages;      // data pages in the file
+	uint32_t pageSize;      // bytes per page, header and map pages included
+	uint32_t freePages;     // data pages given back with freePage() and not handed out again
+	uint32_t flags;         // PFM_PAGE_CHECKSUMS, as the file was created with
+} FileHeader;
+
+// Page layout arithmetic for one page size. Code on hot paths is instantiated for every
+// supported size through withPageLayout, so divisions by the group size fold into shifts.
+template <unsigned PageBytes>
+struct PageLayout
+{
+	static constexpr unsigned pageSize = PageBytes;
+	static constexpr unsigned groupSize = PageBytes;                        // data pages per FSM page: one byte each
+	static constexpr unsigned bucketSize = PageBytes / 256;                 // free bytes per FSM bucket
+	static constexpr unsigned directorySize = PageBytes - PFM_HEADER_SIZE;  // groups the header keeps the largest bucket of
+	static constexpr PageNum maxPages = (UINT_MAX - 1ULL) / (groupSize + 1) * groupSize;  // data pages in full groups after the header
+
+	// Data page p lives after the header, the map pages of groups 0..p/groupSize and all earlier data pages
+	static PageNum dataPageLocation(PageNum pageNum)
+	{
+		return 1 + (pageNum / groupSize) * (groupSize + 1) + 1 + (pageNum % groupSize);
+	}
+
+	static PageNum fsmPageLocation(unsigned group)
+	{
+		return 1 + group * (groupSize + 1);
+	}
+};
+
+inline bool validPageSize(unsigned pageSize)
+{
+	return pageSize >= PAGE_SIZE && pageSize <= PFM_MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+}
+
+// Calls f with the PageLayout of a page size, which must be valid
+template <typename F>
+auto withPageLayout(unsigned pageSize, F f) -> decltype(f(PageLayout<PAGE_SIZE>()))
+{
+	switch (pageSize)
+	{
+		case 8192:  return f(PageLayout<8192>());
+		case 16384: return f(PageLayout<16384>());
+		case 32768: return f(PageLayout<32768>());
+		case 65536: return f(PageLayout<65536>());
+		default:    return f(PageLayout<PAGE_SIZE>());
+	}
+}
+
+// When page writes made through a FileHandle reach the disk
+typedef enum {
+	DurabilityPerWrite = 0,     // every write is handed to the OS before it returns
+	DurabilityGroupCommit,      // writes are gathered and synced together every groupCommitPages pages or groupCommitMillis ms
+	DurabilityDeferred,         // writes stay in the buffer pool until sync(), closeFile() or eviction
+	DurabilityWriteBack         // writes stay in the buffer pool and a background thread writes them back, coalesced
+} DurabilityMode;
+
+// How a FileHandle is about to read, so the buffer pool can keep a scan from flushing everything else out
+typedef enum {
+	AccessNormal = 0,           // pages are cached under the pool's replacement policy
+	AccessSequential            // pages are read once, in order; they share a small ring of frames
+} AccessPattern;
+
+// Options for PagedFileManager::openFile
+typedef struct FileOptions
+{
+	bool directIO = false;                          // open with O_DIRECT, so pages bypass the OS page cache (falls back if unsupported)
+	DurabilityMode durability = DurabilityPerWrite;
+	unsigned groupCommitPages = 64;                 // group commit: sync once this many page writes are pending
+	unsigned groupCommitMillis = 10;                // group commit: sync once the oldest pending write is this old
+	bool mmapReads = false;                         // map the file, so pageAddress() can hand out pages without copying (not with checksums)
+	unsigned extentPages = 256;                     // disk space is preallocated this many pages at a time as the file grows (0: off)
+	bool readAhead = true;                          // scans read the pages ahead of them on a background thread
+	unsigned punchHoleMillis = 0;                   // free pages left unused this long give their disk space back with a hole (0: never)
+	bool verifyChecksums = true;                    // check the checksum of pages read from disk, in files that have them
+} FileOptions;
+
+// Completion token of an asynchronous request
+typedef uint64_t IOToken;
+
+// Identifies a file on disk independently of the handle (and path) used to open it
+typedef struct FileId
+{
+	uint64_t device;
+	uint64_t inode;
+} FileId;
+
+struct FileIdLess
+{
+	bool operator()(const FileId &a, const FileId &b) const;
+};
 
 class PagedFileManager
 {
@@ -31,19 +178,48 @@ public:
 	static PagedFileManager* instance();                     			// Access to the _pf_manager instance
 
 	RC createFile    (const string &fileName);                         	// Create a new file
+	RC createFile    (const string &fileName, unsigned pageSize);      	// Create a new file with pages of a size other than PAGE_SIZE
+	RC createFile    (const string &fileName, unsigned pageSize, unsigned flags);   // Create a new file with PFM_PAGE_CHECKSUMS
 	RC destroyFile   (const string &fileName);                         	// Destroy a file
 	RC openFile      (const string &fileName, FileHandle &fileHandle); 	// Open a file
+	RC openFile      (const string &fileName, FileHandle &fileHandle, const FileOptions &options);   // Open a file with non-default options
 	RC closeFile     (FileHandle &fileHandle);                         	// Close a file
 
+	void setOpenFileLimit(unsigned limit);                              // Most files to keep open; idle ones past it are closed, least recently used first
+	unsigned getOpenFileLimit();
+	unsigned getOpenFileCount();                                        // Files with a descriptor open, in use or idle
+
+	void collectStats(IOStatsSnapshot &stats);                          // Latencies, bytes and buffer pool counts of every file, since the start or the last reset
+	void resetStats();
+
 protected:
 	PagedFileManager();                                   				// Constructor
 	~PagedFileManager();                                  				// Destructor
 
 private:
 	static PagedFileManager *_pf_manager;
+
+	// The open-file table. Every handle on a file shares its descriptor and state, and a file
+	// stays open after its last handle is closed, so opening it again by the same path costs
+	// no system calls. Idle files are closed once there are more than openFileLimit open files.
+	// Files are expected to be created and removed through the PagedFileManager while in the table.
+	map<FileId, shared_ptr<FileState>, FileIdLess> openFiles;
+	map<string, FileId> openPaths;                                      // paths the files in the table were opened by
+	list<FileId> idleFiles;                                             // open files with no handle, least recently used first
+	unsigned openFileLimit;
+	mutex latch;                                                        // guards the table
+
+	shared_ptr<FileState> findOpenFile(const FileId &fileId);
+	void forgetFile(const FileId &fileId);
+	void closeIdleFiles();
+
+	static RC writeFileHeader(int fd, unsigned pageSize, unsigned flags);
+	static RC readFileHeader(int fd, FileHeader &header);
 };
 
 
+// A FileHandle is used by one thread at a time. Threads working on the same file each open
+// a handle of their own; the handles share the file's page count, free-space map and buffered pages.
 class FileHandle
 {
 public:
@@ -56,20 +232,167 @@ public:
 	~FileHandle();                                                   	// Destructor
 
 	RC readPage(PageNum pageNum, void *data);                           // Get a specific page
+	RC readPages(PageNum start, unsigned count, void *data);            // Get count consecutive pages, back to back into data
+	RC readPages(const vector<PageNum> &pageNums, void *data);          // Get the listed pages, back to back into data in list order
 	RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
 	RC appendPage(const void *data);                                    // Append a specific page
+	RC appendPages(unsigned count, const void *data);                   // Append count pages, stored back to back in data
+	RC appendPages(unsigned count, const void *data, PageNum &firstPageNum);   // The same, telling the page number of the first page appended
+	RC pinPage(PageNum pageNum, ReadPageGuard &guard);                  // Pin a page in the buffer pool, to read it in place
+	RC pinPage(PageNum pageNum, WritePageGuard &guard);                 // Pin a page in the buffer pool, to change it in place
+	RC appendPage(WritePageGuard &guard);                               // Append a zeroed page and pin it, to fill it in place
+	RC allocatePage(WritePageGuard &guard);                             // A zeroed page to fill in place: a free page if there is one, else an appended one
+	RC freePage(PageNum pageNum);                                       // Give back a page that is no longer used, to be handed out again
+	unsigned getNumberOfFreePages();                                    // Pages given back and not handed out again yet
 	unsigned getNumberOfPages();                                        // Get the number of pages in the file
+	PageNum getMaxNumberOfPages();                                      // The most pages the file can grow to, for its page size
+	unsigned getPageSize();                                             // Bytes per page, as the file was created with
+	unsigned getUsablePageSize();                                       // Bytes per page left to the user of a data page: all of it, but for the checksum
+	bool hasChecksums();                                                // Whether the file was created with PFM_PAGE_CHECKSUMS
 	RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);  // Put the current counter values into variables
+	RC collectStats(IOStatsSnapshot &stats);                            // Latencies, bytes and buffer pool counts of the file, through every handle on it
+	RC resetStats();                                                    // Start the file's statistics over
+
+	RC setPageFreeSpace(PageNum pageNum, unsigned freeBytes);           // Record how many bytes are free on a page in the free-space map
+	RC findPageWithFreeSpace(unsigned freeBytes, PageNum &pageNum);     // Find a page the free-space map says has at least freeBytes free
+	bool isDirectIO();                                                  // Whether the file was opened with O_DIRECT
+	bool isReadAhead();                                                 // Whether scans read ahead (asked for, and not served by the file mapping)
+	void setAccessPattern(AccessPattern pattern);                       // Hint how pages will be read through this handle from now on
+	RC sync();                                                          // Write back every dirty page of the file and wait until it is on disk
 
-	// Let PagedFileManager access our private helper methods
+	// With FileOptions.mmapReads, a read-only pointer to the page inside the file mapping, NULL otherwise.
+	// The pointer stays valid until this handle is closed or has to grow its mapping in a later call.
+	const void* pageAddress(PageNum pageNum);
+
+	// Asynchronous page I/O: these return as soon as the request is submitted, with a token to
+	// poll or wait for. The buffer must be left alone until then, and page aligned with O_DIRECT.
+	// A batch stops at the first failure; the tokens of the pages submitted before it are returned.
+	RC readPageAsync(PageNum pageNum, void *data, IOToken &token);                                  // Start reading a page
+	RC writePageAsync(PageNum pageNum, const void *data, IOToken &token);                           // Start writing a page
+	RC readPagesAsync(const vector<PageNum> &pageNums, void *data, vector<IOToken> &tokens);        // Start reading the listed pages, back to back into data
+	RC writePagesAsync(const vector<PageNum> &pageNums, const void *data, vector<IOToken> &tokens); // Start writing the listed pages, back to back from data
+	RC pollIO(IOToken token, bool &done);                                                           // Whether a request has completed, and its result if so
+	RC waitIO(IOToken token);                                                                       // Wait for a request to complete
+	RC waitIO(const vector<IOToken> &tokens);                                                       // Wait for a batch of requests to complete
+
+	// Let PagedFileManager, BufferPoolManager, ReadAhead, AsyncIOManager and PageGuard access our private helper methods
 	friend class PagedFileManager;
+	friend class BufferPoolManager;
+	friend class ReadAhead;
+	friend class AsyncIOManager;
+	friend class PageGuard;
 
 private:
-	FILE *_fd;
+	int _fd;
+	unsigned _pageSize;
+	bool _directIO;
+	bool _checksums;
+	FileId _fileId;
+	FileOptions _options;
+	AccessPattern _accessPattern;
+
+	// Shared with every other handle on the same file
+	shared_ptr<FileState> _state;
+
+	// Shared by copies of the handle, so a scan's copy keeps the mapping it reads from alive
+	shared_ptr<FileMapping> _mapping;
+
+	// Group commit bookkeeping
+	unsigned _pendingWrites;
+	uint64_t _firstPendingMillis;
 
 	// Private helper methods
-	void setfd(FILE *fd);
-	FILE *getfd();
+	void setfd(int fd);
+	int getfd();
+
+	RC commitWrite(PageNum location);
+	RC clearFreeSpaceMap(unsigned group);
+	RC addPages(unsigned count);
+	void reserveExtent(PageNum location);
+	RC mapFile(size_t minLength);
+	RC readRun(PageNum start, unsigned count, void *data);
+	void recordIO(IOOp op, uint64_t startNanos, uint64_t bytes);
+	void countBytes(IOOp op, uint64_t bytes);
+	void countPoolAccess(bool hit, bool evicted);
+	void stampChecksum(void *page);
+	RC verifyChecksums(const void *data, unsigned count);
+
+	template <class Layout> RC setPageFreeSpace(Layout layout, PageNum pageNum, unsigned freeBytes);
+	template <class Layout> RC findPageWithFreeSpace(Layout layout, unsigned freeBytes, PageNum &pageNum);
+	template <class Layout> RC setPageBucket(Layout layout, PageNum pageNum, unsigned char bucket, bool freeMark, unsigned char &oldBucket);
+	template <class Layout> RC findFreePage(Layout layout, PageNum &pageNum);
+	RC countFreePages(int change);
+	void punchIdlePages();
+
+	// Mapping from data page numbers to physical page numbers
+	PageNum dataPageLocation(PageNum pageNum);
+	PageNum fsmPageLocation(unsigned group);
+	unsigned groupSize();
+	bool isDataLocation(PageNum location);
+
+	// Page checksums, in the last PFM_CHECKSUM_SIZE bytes of the page
+	static uint32_t pageChecksum(const void *page, unsigned pageSize);
+	static bool checksumMatches(const void *page, unsigned pageSize);
+
+	// Unbuffered I/O of physical pages, used by the buffer pool on a miss and on write back
+	static RC readFromFile(int fd, unsigned pageSize, PageNum pageNum, void *data);
+	static RC readFromFile(int fd, unsigned pageSize, PageNum pageNum, unsigned count, void *data);
+	static RC writeToFile(int fd, unsigned pageSize, PageNum pageNum, const void *data);
+	static RC writeToFile(int fd, unsigned pageSize, PageNum pageNum, unsigned count, const void *data);
+};
+
+
+// PageGuard keeps a data page pinned in the buffer pool while it is in use, so the page can be
+// read, or changed, where it sits in its frame instead of being copied out and back.
+// A read guard holds the page's latch shared, a write guard holds it exclusively; a thread must
+// not hold guards on two pages at once, nor pin a page it holds a guard on.
+// The pin is dropped when the guard is released, reassigned or destroyed. A write guard whose
+// page was handed out for changing then commits it as writePage() would. Guards move but don't copy.
+// The FileHandle that pinned the page must outlive the guard, and the thread that pinned it releases it.
+class PageGuard
+{
+public:
+	PageGuard();
+	PageGuard(PageGuard &&other);
+	PageGuard& operator=(PageGuard &&other);
+	~PageGuard();
+
+	bool isPinned() const;
+	PageNum getPageNum() const;
+	const void* data() const;                                           // The page in its frame
+	RC release();                                                       // Unpin now, and report how committing a change went
+
+	template <typename T>
+	const T* as(unsigned offset = 0) const                              // A typed view of the page at offset
+	{
+		return (const T*) ((const char*) _data + offset);
+	}
+
+protected:
+	FileHandle *_fileHandle;
+	PageNum _pageNum;
+	void *_data;
+	bool _exclusive;
+	bool _dirty;
+	bool _appended;
+
+	void hold(FileHandle *fileHandle, PageNum pageNum, void *data, bool exclusive, bool appended);
+
+	friend class FileHandle;
+
+private:
+	PageGuard(const PageGuard &);
+	PageGuard& operator=(const PageGuard &);
+};
+
+class ReadPageGuard : public PageGuard
+{
+};
+
+class WritePageGuard : public PageGuard
+{
+public:
+	void* mutableData();                                                // The page in its frame, to change; marks it dirty
 };
 
 #endif
\ No newline at end of file
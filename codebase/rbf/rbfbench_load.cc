@@ -0,0 +1,59 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const string csvFileName = "bench_load.csv";
+const string fileName = "bench_load";
+
+// Loads a generated CSV file of employees into a record-based file and reports the throughput.
+// Usage: rbfbench_load [rows [fill factor [threads]]]
+int main(int argc, char **argv)
+{
+    unsigned rows = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    BulkLoadOptions options;
+    options.header = true;
+    options.fillFactor = argc > 2 ? atof(argv[2]) : 1.0;
+    options.threads = argc > 3 ? strtoul(argv[3], NULL, 10) : 0;
+
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    {
+        ofstream csv(csvFileName.c_str());
+        csv << "EmpName,Age,Height,Salary\n";
+        for (unsigned i = 0; i < rows; i++)
+            csv << "Employee" << i << "," << 20 + i % 50 << "," << 150 + i % 50 << ".5," << 1000 + i % 9000 << "\n";
+    }
+
+    remove(fileName.c_str());
+    RC rc = rbfm->createFile(fileName);
+    FileHandle fileHandle;
+    if (rc == success)
+        rc = rbfm->openFile(fileName, fileHandle);
+    BulkLoadStats stats;
+    if (rc == success)
+        rc = rbfm->bulkLoad(fileHandle, recordDescriptor, csvFileName, options, stats);
+    if (rc != success)
+    {
+        cout << "The load failed with " << rc << " at line " << stats.errorLine << "." << endl;
+        return -1;
+    }
+    rc = rbfm->closeFile(fileHandle);
+
+    printf("loaded %llu rows, %.1f MB, onto %u pages at fill factor %.2f on %u threads in %.3f s\n", (unsigned long long) stats.rows,
+           stats.bytes / 1048576.0, stats.pages, options.fillFactor, options.threads, stats.nanos / 1e9);
+    printf("%.0f rows/s, %.1f MB/s\n", stats.rowsPerSecond(), stats.megabytesPerSecond());
+
+    rbfm->destroyFile(fileName);
+    remove(csvFileName.c_str());
+    return rc;
+}
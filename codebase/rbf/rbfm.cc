@@ -1,105 +1,67 @@
 #include "rbfm.h"
+#include "readahead.h"
+#include "bulkload.h"
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
+#include <fstream>
 #include <string.h>
 #include <iomanip>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <deque>
+#include <sstream>
+#include <system_error>
 
 // helper function
 
-SlotDirectoryHeader RecordBasedFileManager::getSlotDirectoryHeader(void * page)
+SlotDirectoryHeader* RecordBasedFileManager::slotDirectoryHeader(void * page)
 {
-    // Getting the slot directory header.
-    SlotDirectoryHeader slotHeader;
-    memcpy (&slotHeader, page, sizeof(SlotDirectoryHeader));
-    return slotHeader;
+    return (SlotDirectoryHeader*) page;
 }
 
-void RecordBasedFileManager::setSlotDirectoryHeader(void * page, SlotDirectoryHeader slotHeader)
+const SlotDirectoryHeader* RecordBasedFileManager::slotDirectoryHeader(const void * page)
 {
-    // Setting the slot directory header.
-    memcpy (page, &slotHeader, sizeof(SlotDirectoryHeader));
+    return (const SlotDirectoryHeader*) page;
 }
 
-SlotDirectoryRecordEntry RecordBasedFileManager::getSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber)
+SlotDirectory RecordBasedFileManager::slotDirectory(void * page)
 {
-    // Getting the slot directory entry data.
-    SlotDirectoryRecordEntry recordEntry;
-    memcpy  (
-            &recordEntry,
-            ((char*) page + sizeof(SlotDirectoryHeader) + recordEntryNumber * sizeof(SlotDirectoryRecordEntry)),
-            sizeof(SlotDirectoryRecordEntry)
-    );
+    return (SlotDirectory) ((char*) page + sizeof(SlotDirectoryHeader));
+}
 
-    return recordEntry;
+const SlotDirectoryRecordEntry* RecordBasedFileManager::slotDirectory(const void * page)
+{
+    return (const SlotDirectoryRecordEntry*) ((const char*) page + sizeof(SlotDirectoryHeader));
 }
 
-void RecordBasedFileManager::setSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber, SlotDirectoryRecordEntry recordEntry)
+static inline bool slotDeleted(const SlotDirectoryRecordEntry &entry)
 {
-    // Setting the slot directory entry data.
-    memcpy  (
-            ((char*) page + sizeof(SlotDirectoryHeader) + recordEntryNumber * sizeof(SlotDirectoryRecordEntry)),
-            &recordEntry,
-            sizeof(SlotDirectoryRecordEntry)
-    );
+    return entry.offset > 0 && entry.length == 0;
+}
+
+static inline bool slotForwarded(const SlotDirectoryRecordEntry &entry)
+{
+    return entry.offset <= 0;
 }
 
 // Configures a new record based page, and puts it in "page".
-void RecordBasedFileManager::newRecordBasedPage(void * page)
+void RecordBasedFileManager::newRecordBasedPage(void * page, unsigned pageSize)
 {
-    memset(page, 0, PAGE_SIZE);
+    memset(page, 0, pageSize);
     // Writes the slot directory header.
     SlotDirectoryHeader slotHeader;
-    slotHeader.freeSpaceOffset = PAGE_SIZE;
+    slotHeader.freeSpaceOffset = pageSize;
     slotHeader.recordEntriesNumber = 0;
     memcpy (page, &slotHeader, sizeof(SlotDirectoryHeader));
 }
 
-unsigned RecordBasedFileManager::getRecordSize(const vector<Attribute> &recordDescriptor, const void *data)
-{
-    // Read in the null indicator
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
-    char nullIndicator[nullIndicatorSize];
-    memset(nullIndicator, 0, nullIndicatorSize);
-    memcpy(nullIndicator, (char*) data, nullIndicatorSize);
-
-    // Offset into *data. Start just after null indicator
-    unsigned offset = nullIndicatorSize;
-    // Running count of size. Initialize to size of header
-    unsigned size = sizeof (RecordLength) + (recordDescriptor.size()) * sizeof(ColumnOffset) + nullIndicatorSize;
-
-    for (unsigned i = 0; i < (unsigned) recordDescriptor.size(); i++)
-    {
-        // Skip null fields
-        if (fieldIsNull(nullIndicator, i))
-            continue;
-        switch (recordDescriptor[i].type)
-        {
-            case TypeInt:
-                size += INT_SIZE;
-                offset += INT_SIZE;
-                break;
-            case TypeReal:
-                size += REAL_SIZE;
-                offset += REAL_SIZE;
-                break;
-            case TypeVarChar:
-                uint32_t varcharSize;
-                // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                memcpy(&varcharSize, (char*) data + offset, VARCHAR_LENGTH_SIZE);
-                size += varcharSize;
-                offset += varcharSize + VARCHAR_LENGTH_SIZE;
-                break;
-        }
-    }
-
-    return size;
-}
-
 // Calculate actual bytes for nulls-indicator for the given field counts
 int RecordBasedFileManager::getNullIndicatorSize(int fieldCount)
 {
-    return int(ceil((double) fieldCount / CHAR_BIT));
+    return (fieldCount + CHAR_BIT - 1) / CHAR_BIT;
 }
 
 bool RecordBasedFileManager::fieldIsNull(char *nullIndicator, int i)
@@ -110,140 +72,288 @@ bool RecordBasedFileManager::fieldIsNull(char *nullIndicator, int i)
 }
 
 // Computes the free space of a page (function of the free space pointer and the slot directory size).
-unsigned RecordBasedFileManager::getPageFreeSpaceSize(void * page)
+unsigned RecordBasedFileManager::getPageFreeSpaceSize(const void * page)
 {
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(page);
-    return slotHeader.freeSpaceOffset - slotHeader.recordEntriesNumber * sizeof(SlotDirectoryRecordEntry) - sizeof(SlotDirectoryHeader);
+    const SlotDirectoryHeader *slotHeader = slotDirectoryHeader(page);
+    return slotHeader->freeSpaceOffset - slotHeader->recordEntriesNumber * sizeof(SlotDirectoryRecordEntry) - sizeof(SlotDirectoryHeader);
 }
 
-// Support header size and null indicator. If size is less than recordDescriptor size, then trailing records are null
-// Memset null indicator as 1?
-void RecordBasedFileManager::getRecordAtOffset(void *page, unsigned offset, const vector<Attribute> &recordDescriptor, void *data)
+// Pages given back to the file are zeroed, and a record-based page never has its free space at offset 0
+bool RecordBasedFileManager::isFreePage(const void * page)
 {
-    // Pointer to start of record
-    char *start = (char*) page + offset;
+    return slotDirectoryHeader(page)->freeSpaceOffset == 0;
+}
 
-    // Allocate space for null indicator. The returned null indicator may be larger than
-    // the null indicator in the table has had fields added to it
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
-    char nullIndicator[nullIndicatorSize];
-    memset(nullIndicator, 0, nullIndicatorSize);
+// Field codecs. Ints and reals take four bytes in both formats; a VarChar is preceded by its length
+// in the insertRecord format, and its length on a page follows from the column offsets.
 
-    // Get number of columns and size of the null indicator for this record
-    RecordLength len = 0;
-    memcpy (&len, start, sizeof(RecordLength));
-    int recordNullIndicatorSize = getNullIndicatorSize(len);
+static unsigned measureFixed(const char *&field)
+{
+    field += INT_SIZE;
+    return INT_SIZE;
+}
 
-    // Read in the existing null indicator
-    memcpy (nullIndicator, start + sizeof(RecordLength), recordNullIndicatorSize);
+static void encodeFixed(const char *&field, char *&stored)
+{
+    memcpy(stored, field, INT_SIZE);
+    field += INT_SIZE;
+    stored += INT_SIZE;
+}
 
-    // If this new recordDescriptor has had fields added to it, we set all of the new fields to null
-    for (unsigned i = len; i < recordDescriptor.size(); i++)
-    {
-        int indicatorIndex = (i+1) / CHAR_BIT;
-        int indicatorMask  = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-        nullIndicator[indicatorIndex] |= indicatorMask;
-    }
-    // Write out null indicator
-    memcpy(data, nullIndicator, nullIndicatorSize);
-
-    // Initialize some offsets
-    // rec_offset: points to data in the record. We move this forward as we read data from our record
-    unsigned rec_offset = sizeof(RecordLength) + recordNullIndicatorSize + len * sizeof(ColumnOffset);
-    // data_offset: points to our current place in the output data. We move this forward as we write data to data.
-    unsigned data_offset = nullIndicatorSize;
-    // directory_base: points to the start of our directory of indices
-    char *directory_base = start + sizeof(RecordLength) + recordNullIndicatorSize;
-
-    for (unsigned i = 0; i < recordDescriptor.size(); i++)
-    {
-        if (fieldIsNull(nullIndicator, i))
-            continue;
+static void decodeFixed(const char *stored, unsigned, char *&field)
+{
+    memcpy(field, stored, INT_SIZE);
+    field += INT_SIZE;
+}
 
-        // Grab pointer to end of this column
-        ColumnOffset endPointer;
-        memcpy(&endPointer, directory_base + i * sizeof(ColumnOffset), sizeof(ColumnOffset));
+static unsigned measureVarChar(const char *&field)
+{
+    uint32_t length;
+    memcpy(&length, field, VARCHAR_LENGTH_SIZE);
+    field += VARCHAR_LENGTH_SIZE + length;
+    return length;
+}
 
-        // rec_offset keeps track of start of column, so end-start = total size
-        uint32_t fieldSize = endPointer - rec_offset;
+static void encodeVarChar(const char *&field, char *&stored)
+{
+    uint32_t length;
+    memcpy(&length, field, VARCHAR_LENGTH_SIZE);
+    memcpy(stored, field + VARCHAR_LENGTH_SIZE, length);
+    field += VARCHAR_LENGTH_SIZE + length;
+    stored += length;
+}
 
-        // Special case for varchar, we must give data the size of varchar first
-        if (recordDescriptor[i].type == TypeVarChar)
+static void decodeVarChar(const char *stored, unsigned storedSize, char *&field)
+{
+    uint32_t length = storedSize;
+    memcpy(field, &length, VARCHAR_LENGTH_SIZE);
+    memcpy(field + VARCHAR_LENGTH_SIZE, stored, length);
+    field += VARCHAR_LENGTH_SIZE + length;
+}
+
+static const FieldCodec fixedCodec = { measureFixed, encodeFixed, decodeFixed };
+static const FieldCodec varCharCodec = { measureVarChar, encodeVarChar, decodeVarChar };
+
+static inline bool isNullField(const char *nullIndicator, unsigned i)
+{
+    return (nullIndicator[i / CHAR_BIT] & (1 << (CHAR_BIT - 1 - i % CHAR_BIT))) != 0;
+}
+
+RecordLayout::RecordLayout()
+{
+    nullIndicatorSize = 0;
+    headerSize = sizeof(RecordLength);
+    fixedFields = 0;
+    fixedOffsets.push_back(0);
+    fixedHeader.assign(sizeof(RecordLength), 0);
+}
+
+RecordLayout::RecordLayout(const vector<Attribute> &recordDescriptor)
+    : attributes(recordDescriptor)
+{
+    nullIndicatorSize = (attributes.size() + CHAR_BIT - 1) / CHAR_BIT;
+    headerSize = sizeof(RecordLength) + nullIndicatorSize + attributes.size() * sizeof(ColumnOffset);
+    fixedFields = 0;
+    fixedOffsets.push_back(0);
+    fieldIndex.reserve(attributes.size());
+    for (unsigned i = 0; i < attributes.size(); i++)
+    {
+        bool varChar = attributes[i].type == TypeVarChar;
+        codecs.push_back(varChar ? varCharCodec : fixedCodec);
+        // The first attribute of a name is the one found, as with a search from the front
+        fieldIndex.insert(make_pair(attributes[i].name, i));
+        if (!varChar && fixedFields == i)
         {
-            memcpy((char*) data + data_offset, &fieldSize, VARCHAR_LENGTH_SIZE);
-            data_offset += VARCHAR_LENGTH_SIZE;
+            fixedFields++;
+            fixedOffsets.push_back(fixedOffsets.back() + INT_SIZE);
         }
-        // Next we copy bytes equal to the size of the field and increase our offsets
-        memcpy((char*) data + data_offset, start + rec_offset, fieldSize);
-        rec_offset += fieldSize;
-        data_offset += fieldSize;
+    }
+
+    // With no field NULL, the column offsets of the fixed fields are the same for every record
+    RecordLength fieldCount = attributes.size();
+    fixedHeader.assign(sizeof(RecordLength) + nullIndicatorSize + fixedFields * sizeof(ColumnOffset), 0);
+    memcpy(fixedHeader.data(), &fieldCount, sizeof(RecordLength));
+    for (unsigned i = 0; i < fixedFields; i++)
+    {
+        ColumnOffset end = headerSize + fixedOffsets[i + 1];
+        memcpy(fixedHeader.data() + sizeof(RecordLength) + nullIndicatorSize + i * sizeof(ColumnOffset), &end, sizeof(ColumnOffset));
     }
 }
 
-void RecordBasedFileManager::setRecordAtOffset(void *page, unsigned offset, const vector<Attribute> &recordDescriptor, const void *data)
+bool RecordLayout::anyNull(const char *nullIndicator) const
 {
-    // Read in the null indicator
-    int nullIndicatorSize = getNullIndicatorSize(recordDescriptor.size());
-    char nullIndicator[nullIndicatorSize];
-    memset (nullIndicator, 0, nullIndicatorSize);
-    memcpy(nullIndicator, (char*) data, nullIndicatorSize);
+    for (unsigned b = 0; b < nullIndicatorSize; b++)
+    {
+        if (nullIndicator[b] != 0)
+            return true;
+    }
+    return false;
+}
 
-    // Points to start of record
-    char *start = (char*) page + offset;
+const vector<Attribute>& RecordLayout::getAttributes() const
+{
+    return attributes;
+}
 
-    // Offset into *data
-    unsigned data_offset = nullIndicatorSize;
-    // Offset into page header
-    unsigned header_offset = 0;
+unsigned RecordLayout::getFieldCount() const
+{
+    return attributes.size();
+}
 
-    RecordLength len = recordDescriptor.size();
-    memcpy(start + header_offset, &len, sizeof(len));
-    header_offset += sizeof(len);
+unsigned RecordLayout::getNullIndicatorSize() const
+{
+    return nullIndicatorSize;
+}
 
-    memcpy(start + header_offset, nullIndicator, nullIndicatorSize);
-    header_offset += nullIndicatorSize;
+int RecordLayout::getFieldIndex(const string &name) const
+{
+    unordered_map<string, unsigned>::const_iterator found = fieldIndex.find(name);
+    return found == fieldIndex.end() ? -1 : (int) found->second;
+}
 
-    // Keeps track of the offset of each record
-    // Offset is relative to the start of the record and points to the END of a field
-    ColumnOffset rec_offset = header_offset + (recordDescriptor.size()) * sizeof(ColumnOffset);
+bool RecordLayout::matches(const vector<Attribute> &recordDescriptor) const
+{
+    if (recordDescriptor.size() != attributes.size())
+        return false;
+    for (unsigned i = 0; i < attributes.size(); i++)
+    {
+        if (recordDescriptor[i].type != attributes[i].type || recordDescriptor[i].length != attributes[i].length
+                || recordDescriptor[i].name != attributes[i].name)
+            return false;
+    }
+    return true;
+}
 
+// On a page, a record is its field count, its null indicator, the offset each field ends at,
+// then the values of the fields that are not NULL. With no field NULL, the fixed-width fields
+// up front take the same room in every record; a table of ints and reals is all of them.
+unsigned RecordLayout::recordSize(const void *data) const
+{
+    const char *nullIndicator = (const char *) data;
+    const char *field = nullIndicator + nullIndicatorSize;
+    unsigned size = headerSize;
     unsigned i = 0;
-    for (i = 0; i < recordDescriptor.size(); i++)
+    if (!anyNull(nullIndicator))
     {
-        if (!fieldIsNull(nullIndicator, i))
-        {
-            // Points to current position in *data
-            char *data_start = (char*) data + data_offset;
-
-            // Read in the data for the next column, point rec_offset to end of newly inserted data
-            switch (recordDescriptor[i].type)
-            {
-                case TypeInt:
-                    memcpy (start + rec_offset, data_start, INT_SIZE);
-                    rec_offset += INT_SIZE;
-                    data_offset += INT_SIZE;
-                    break;
-                case TypeReal:
-                    memcpy (start + rec_offset, data_start, REAL_SIZE);
-                    rec_offset += REAL_SIZE;
-                    data_offset += REAL_SIZE;
-                    break;
-                case TypeVarChar:
-                    unsigned varcharSize;
-                    // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-                    memcpy(&varcharSize, data_start, VARCHAR_LENGTH_SIZE);
-                    memcpy(start + rec_offset, data_start + VARCHAR_LENGTH_SIZE, varcharSize);
-                    // We also have to account for the overhead given by that integer.
-                    rec_offset += varcharSize;
-                    data_offset += VARCHAR_LENGTH_SIZE + varcharSize;
-                    break;
-            }
-        }
-        // Copy offset into record header
-        // Offset is relative to the start of the record and points to END of field
-        memcpy(start + header_offset, &rec_offset, sizeof(ColumnOffset));
-        header_offset += sizeof(ColumnOffset);
+        field += fixedOffsets[fixedFields];
+        size += fixedOffsets[fixedFields];
+        i = fixedFields;
+    }
+    for (; i < attributes.size(); i++)
+    {
+        if (!isNullField(nullIndicator, i))
+            size += codecs[i].measure(field);
+    }
+    return size;
+}
+
+// With no field NULL, the start of the header and the fixed-width values are each copied at once
+void RecordLayout::encode(const void *data, void *record) const
+{
+    const char *nullIndicator = (const char *) data;
+    const char *field = nullIndicator + nullIndicatorSize;
+    char *start = (char *) record;
+
+    // Each column offset is relative to the start of the record and points to the END of its field
+    char *columnOffsets = start + sizeof(RecordLength) + nullIndicatorSize;
+    char *stored = start + headerSize;
+    unsigned i = 0;
+    if (!anyNull(nullIndicator))
+    {
+        memcpy(start, fixedHeader.data(), fixedHeader.size());
+        memcpy(stored, field, fixedOffsets[fixedFields]);
+        field += fixedOffsets[fixedFields];
+        stored += fixedOffsets[fixedFields];
+        i = fixedFields;
+    }
+    else
+    {
+        RecordLength fieldCount = attributes.size();
+        memcpy(start, &fieldCount, sizeof(RecordLength));
+        memcpy(start + sizeof(RecordLength), nullIndicator, nullIndicatorSize);
     }
+    for (; i < attributes.size(); i++)
+    {
+        if (!isNullField(nullIndicator, i))
+            codecs[i].encode(field, stored);
+        ColumnOffset end = stored - start;
+        memcpy(columnOffsets + i * sizeof(ColumnOffset), &end, sizeof(ColumnOffset));
+    }
+}
+
+// A record written before the table had fields added has fewer than the layout: those read as NULL.
+void RecordLayout::decode(const void *record, void *data) const
+{
+    const char *start = (const char *) record;
+    RecordLength recordFields;
+    memcpy(&recordFields, start, sizeof(RecordLength));
+    unsigned recordNullIndicatorSize = (recordFields + CHAR_BIT - 1) / CHAR_BIT;
+
+    char *nullIndicator = (char *) data;
+    char *field = nullIndicator + nullIndicatorSize;
+    unsigned begin = sizeof(RecordLength) + recordNullIndicatorSize + recordFields * sizeof(ColumnOffset);
+    unsigned i = 0;
+    if (recordFields == attributes.size() && !anyNull(start + sizeof(RecordLength)))
+    {
+        memset(nullIndicator, 0, nullIndicatorSize);
+        memcpy(field, start + begin, fixedOffsets[fixedFields]);
+        field += fixedOffsets[fixedFields];
+        begin += fixedOffsets[fixedFields];
+        i = fixedFields;
+    }
+    else
+    {
+        memset(nullIndicator, 0, nullIndicatorSize);
+        memcpy(nullIndicator, start + sizeof(RecordLength), min(recordNullIndicatorSize, nullIndicatorSize));
+        for (unsigned j = recordFields; j < attributes.size(); j++)
+            nullIndicator[j / CHAR_BIT] |= 1 << (CHAR_BIT - 1 - j % CHAR_BIT);
+    }
+
+    const char *columnOffsets = start + sizeof(RecordLength) + recordNullIndicatorSize;
+    unsigned fields = min((unsigned) recordFields, (unsigned) attributes.size());
+    for (; i < fields; i++)
+    {
+        ColumnOffset end;
+        memcpy(&end, columnOffsets + i * sizeof(ColumnOffset), sizeof(ColumnOffset));
+        if (!isNullField(nullIndicator, i))
+            codecs[i].decode(start + begin, end - begin, field);
+        begin = end;
+    }
+}
+
+int RecordLayout::decodeField(const void *record, unsigned index, void *field) const
+{
+    const char *start = (const char *) record;
+    RecordLength recordFields;
+    memcpy(&recordFields, start, sizeof(RecordLength));
+    unsigned recordNullIndicatorSize = (recordFields + CHAR_BIT - 1) / CHAR_BIT;
+    if (index >= recordFields || isNullField(start + sizeof(RecordLength), index))
+        return -1;
+
+    const char *columnOffsets = start + sizeof(RecordLength) + recordNullIndicatorSize;
+    ColumnOffset begin;
+    ColumnOffset end;
+    if (index > 0)
+        memcpy(&begin, columnOffsets + (index - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
+    else
+        begin = sizeof(RecordLength) + recordNullIndicatorSize + recordFields * sizeof(ColumnOffset);
+    memcpy(&end, columnOffsets + index * sizeof(ColumnOffset), sizeof(ColumnOffset));
+
+    char *out = (char *) field;
+    codecs[index].decode(start + begin, end - begin, out);
+    return out - (char *) field;
+}
+
+// The layout for calls given a descriptor, as a fallback for callers that do not keep their own:
+// the last one compiled on the thread is kept, and compared to the descriptor field by field on
+// every call. The reference is to that one layout, which the next call on the thread with another
+// descriptor overwrites, so it is passed straight to the layout overload and not held past it.
+const RecordLayout& RecordBasedFileManager::layoutOf(const vector<Attribute> &recordDescriptor)
+{
+    static thread_local RecordLayout layout;
+    if (!layout.matches(recordDescriptor))
+        layout = RecordLayout(recordDescriptor);
+    return layout;
 }
 
 //start
@@ -252,14 +362,16 @@ PagedFileManager *RecordBasedFileManager::_pf_manager = NULL;
 
 RecordBasedFileManager* RecordBasedFileManager::instance()
 {
-    if(!_rbf_manager)
-        _rbf_manager = new RecordBasedFileManager();
+    static once_flag created;
+    call_once(created, [] { _rbf_manager = new RecordBasedFileManager(); });
 
     return _rbf_manager;
 }
 
 RecordBasedFileManager::RecordBasedFileManager()
 {
+    // The paged file manager now keeps per-file state, so it has to be the real instance
+    _pf_manager = PagedFileManager::instance();
 }
 
 RecordBasedFileManager::~RecordBasedFileManager()
@@ -267,22 +379,32 @@ RecordBasedFileManager::~RecordBasedFileManager()
 }
 
 RC RecordBasedFileManager::createFile(const string &fileName) {
+    return createFile(fileName, PAGE_SIZE);
+}
+
+RC RecordBasedFileManager::createFile(const string &fileName, unsigned pageSize) {
+    return createFile(fileName, pageSize, 0);
+}
+
+RC RecordBasedFileManager::createFile(const string &fileName, unsigned pageSize, unsigned flags) {
     // Creating a new paged file.
-    if (_pf_manager->createFile(fileName))
+    if (_pf_manager->createFile(fileName, pageSize, flags))
         return RBFM_CREATE_FAILED;
 
-    // Setting up the first page.
-    void * firstPageData = calloc(PAGE_SIZE, 1);
+    FileHandle handle;
+    if (_pf_manager->openFile(fileName.c_str(), handle))
+        return RBFM_OPEN_FAILED;
+
+    // Setting up the first page, short of the checksum if the file keeps them.
+    void * firstPageData = calloc(pageSize, 1);
     if (firstPageData == NULL)
         return RBFM_MALLOC_FAILED;
-    newRecordBasedPage(firstPageData);
+    newRecordBasedPage(firstPageData, handle.getUsablePageSize());
 
     // Adds the first record based page.
-    FileHandle handle;
-    if (_pf_manager->openFile(fileName.c_str(), handle))
-        return RBFM_OPEN_FAILED;
     if (handle.appendPage(firstPageData))
         return RBFM_APPEND_FAILED;
+    handle.setPageFreeSpace(0, getPageFreeSpaceSize(firstPageData));
     _pf_manager->closeFile(handle);
 
     free(firstPageData);
@@ -298,95 +420,390 @@ RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHand
     return _pf_manager->openFile(fileName.c_str(), fileHandle);
 }
 
+RC RecordBasedFileManager::openFile(const string &fileName, FileHandle &fileHandle, const FileOptions &options) {
+    return _pf_manager->openFile(fileName.c_str(), fileHandle, options);
+}
+
 RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
     return _pf_manager->closeFile(fileHandle);
 }
 
 RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid) {
-    // Gets the size of the record.
-    unsigned recordSize = getRecordSize(recordDescriptor, data);
+    return insertRecord(fileHandle, layoutOf(recordDescriptor), data, rid);
+}
 
-    // Cycles through pages looking for enough free space for the new entry.
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    bool pageFound = false;
-    unsigned i;
-    unsigned numPages = fileHandle.getNumberOfPages();
-    for (i = 0; i < numPages; i++)
+RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, RID &rid) {
+    // Gets the size of the record.
+    unsigned recordSize = layout.recordSize(data);
+
+    // Space taken on the page, accounting also for the size that will be added to the slot directory.
+    unsigned spaceNeeded = sizeof(SlotDirectoryRecordEntry) + recordSize;
+
+    // Asks the free-space map for a page with enough room. The map is only a hint,
+    // so the page itself is checked, and a stale entry is corrected before asking again.
+    // The record is written straight into the page's buffer frame; holding the page's
+    // write latch from the check on keeps other writers from taking the room meanwhile.
+    WritePageGuard page;
+    PageNum i;
+    while (fileHandle.findPageWithFreeSpace(spaceNeeded, i) == SUCCESS)
     {
-        if (fileHandle.readPage(i, pageData))
+        if (fileHandle.pinPage(i, page))
             return RBFM_READ_FAILED;
 
-        // When we find a page with enough space (accounting also for the size that will be added to the slot directory), we stop the loop.
-        if (getPageFreeSpaceSize(pageData) >= sizeof(SlotDirectoryRecordEntry) + recordSize)
+        // A page emptied and given back meanwhile is all zeros, and no longer in the map
+        if (isFreePage(page.data()))
         {
-            pageFound = true;
-            break;
+            page.release();
+            continue;
         }
+
+        unsigned freeSpace = getPageFreeSpaceSize(page.data());
+        if (freeSpace >= spaceNeeded)
+            break;
+        page.release();
+        fileHandle.setPageFreeSpace(i, freeSpace);
     }
 
-    // If we can't find a page with enough space, we create a new one
-    if(!pageFound)
+    // If we can't find a page with enough space, we take a free one, or create a new one
+    if (!page.isPinned())
     {
-        newRecordBasedPage(pageData);
+        if (fileHandle.allocatePage(page))
+            return RBFM_APPEND_FAILED;
+        i = page.getPageNum();
+        newRecordBasedPage(page.mutableData(), fileHandle.getUsablePageSize());
     }
 
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
+    void *pageData = page.mutableData();
+    SlotDirectoryHeader *slotHeader = slotDirectoryHeader(pageData);
 
     // Setting the return RID.
     rid.pageNum = i;
-    rid.slotNum = slotHeader.recordEntriesNumber;
+    rid.slotNum = slotHeader->recordEntriesNumber;
 
     // Adding the new record reference in the slot directory.
-    SlotDirectoryRecordEntry newRecordEntry;
+    SlotDirectoryRecordEntry &newRecordEntry = slotDirectory(pageData)[rid.slotNum];
     newRecordEntry.length = recordSize;
-    newRecordEntry.offset = slotHeader.freeSpaceOffset - recordSize;
-    setSlotDirectoryRecordEntry(pageData, rid.slotNum, newRecordEntry);
+    newRecordEntry.offset = slotHeader->freeSpaceOffset - recordSize;
 
     // Updating the slot directory header.
-    slotHeader.freeSpaceOffset = newRecordEntry.offset;
-    slotHeader.recordEntriesNumber += 1;
-    setSlotDirectoryHeader(pageData, slotHeader);
+    slotHeader->freeSpaceOffset = newRecordEntry.offset;
+    slotHeader->recordEntriesNumber += 1;
 
     // Adding the record data.
-    setRecordAtOffset (pageData, newRecordEntry.offset, recordDescriptor, data);
+    layout.encode(data, (char *) pageData + newRecordEntry.offset);
+    unsigned freeSpace = getPageFreeSpaceSize(pageData);
 
     // Writing the page to disk.
-    if (pageFound)
-    {
-        if (fileHandle.writePage(i, pageData))
-            return RBFM_WRITE_FAILED;
+    if (page.release())
+        return RBFM_WRITE_FAILED;
+    fileHandle.setPageFreeSpace(i, freeSpace);
+
+    return SUCCESS;
+}
+
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                                         const vector<const void*> &records, vector<RID> &rids) {
+    return insertRecords(fileHandle, recordDescriptor, records, rids, 1);
+}
+
+// Blocks of RBFM_LOAD_BLOCK_RECORDS records are packed onto pages built in memory and each goes to the
+// end of the file with one append: no page already in the file is searched, read or written but for its
+// free-space map entry, so room left on those pages is not used. A record's page number is counted from
+// its block's first page until the block is appended. If a block fails, the records before it, and those
+// of it that were packed, are in the file with their RIDs set, and the rest are not.
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                                         const vector<const void*> &records, vector<RID> &rids, unsigned threads) {
+    rids.resize(records.size());
+    RecordLayout layout(recordDescriptor);
+    size_t next = 0;
+    auto readBlock = [&](LoadBlock &block) {
+        if (next == records.size())
+            return RBFM_EOF;
+        block.firstRecord = next;
+        block.endRecord = min(next + RBFM_LOAD_BLOCK_RECORDS, records.size());
+        next = block.endRecord;
+        return SUCCESS;
+    };
+    auto packBlock = [&](LoadBlock &block) {
+        for (size_t r = block.firstRecord; r < block.endRecord; r++) {
+            RC rc = packRecord(block.pages, layout, records[r], rids[r]);
+            if (rc)
+                return rc;
+            block.rows++;
+        }
+        return SUCCESS;
+    };
+    auto placeBlock = [&](LoadBlock &block, PageNum firstPageNum) {
+        for (size_t r = block.firstRecord; r < block.firstRecord + block.rows; r++)
+            rids[r].pageNum += firstPageNum;
+    };
+    return loadBlocks(fileHandle, threads, 1.0, readBlock, packBlock, placeBlock);
+}
+
+// The caller's thread cuts the input into blocks of whole rows, and workers parse and pack them.
+// No RIDs are kept: a load may run to many more rows than would fit in memory.
+RC RecordBasedFileManager::bulkLoad(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, istream &input,
+                                    const BulkLoadOptions &options, BulkLoadStats &stats) {
+    memset(&stats, 0, sizeof(stats));
+    uint64_t start = IOStats::now();
+
+    RecordLayout layout(recordDescriptor);
+    CSVReader reader(input, recordDescriptor, options.delimiter);
+    RC rc = options.header ? reader.skipRow() : SUCCESS;
+    if (rc == SUCCESS) {
+        auto readBlock = [&](LoadBlock &block) {
+            block.firstLine = reader.lineNumber() + 1;
+            return reader.readRows(RBFM_LOAD_BLOCK_BYTES, block.text) ? SUCCESS : RBFM_EOF;
+        };
+        auto packBlock = [&](LoadBlock &block) {
+            istringstream text(block.text);
+            CSVReader rows(text, recordDescriptor, options.delimiter);
+            void *record = malloc(rows.maxRecordSize());
+            if (record == NULL)
+                return RBFM_MALLOC_FAILED;
+            RID rid;
+            RC rc;
+            while ((rc = rows.readRecord(record)) == SUCCESS) {
+                if ((rc = packRecord(block.pages, layout, record, rid)))
+                    break;
+                block.rows++;
+            }
+            free(record);
+            if (rc == RBFM_EOF)
+                return SUCCESS;
+            if (rc == RBFM_CSV_PARSE_FAILED || rc == RBFM_RECORD_TOO_LARGE)
+                block.errorLine = block.firstLine + rows.lineNumber() - 1;
+            return rc;
+        };
+        auto placeBlock = [&](LoadBlock &block, PageNum) {
+            stats.rows += block.rows;
+            stats.pages += block.pages.pages;
+            stats.errorLine = block.errorLine;
+        };
+        rc = loadBlocks(fileHandle, options.threads, options.fillFactor, readBlock, packBlock, placeBlock);
     }
-    else
-    {
-        if (fileHandle.appendPage(pageData))
-            return RBFM_APPEND_FAILED;
+    else if (rc == RBFM_CSV_PARSE_FAILED)
+        stats.errorLine = reader.lineNumber();
+
+    stats.bytes = reader.bytesRead();
+    stats.nanos = IOStats::now() - start;
+    return rc;
+}
+
+RC RecordBasedFileManager::bulkLoad(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const string &csvFileName,
+                                    const BulkLoadOptions &options, BulkLoadStats &stats) {
+    ifstream input(csvFileName.c_str(), ios::in | ios::binary);
+    if (!input) {
+        memset(&stats, 0, sizeof(stats));
+        return RBFM_OPEN_FAILED;
+    }
+    return bulkLoad(fileHandle, recordDescriptor, input, options, stats);
+}
+
+// An empty chunk for the file's pages; its buffer is only taken once a record is packed
+RC RecordBasedFileManager::newPageChunk(FileHandle &fileHandle, double fillFactor, PageChunk &chunk) {
+    if (!(fillFactor > 0 && fillFactor <= 1))
+        return RBFM_BAD_FILL_FACTOR;
+    chunk.data = NULL;
+    chunk.capacity = 0;
+    chunk.pageSize = fileHandle.getPageSize();
+    chunk.usablePageSize = fileHandle.getUsablePageSize();
+    chunk.reservedBytes = (unsigned) ((1 - fillFactor) * (chunk.usablePageSize - sizeof(SlotDirectoryHeader)));
+    chunk.pages = 0;
+    return SUCCESS;
+}
+
+// Places the record as insertRecord does, on the chunk's last page or a new one, giving the page number
+// within the chunk. The first record on a page goes in whatever the fill factor.
+RC RecordBasedFileManager::packRecord(PageChunk &chunk, const RecordLayout &layout, const void *data, RID &rid) {
+    unsigned recordSize = layout.recordSize(data);
+    unsigned spaceNeeded = sizeof(SlotDirectoryRecordEntry) + recordSize;
+    if (spaceNeeded > chunk.usablePageSize - sizeof(SlotDirectoryHeader))
+        return RBFM_RECORD_TOO_LARGE;
+
+    char *pageData = chunk.pages == 0 ? NULL : chunk.data + (size_t) (chunk.pages - 1) * chunk.pageSize;
+    if (pageData == NULL || getPageFreeSpaceSize(pageData) < spaceNeeded + chunk.reservedBytes) {
+        if (chunk.pages == chunk.capacity) {
+            unsigned capacity = chunk.capacity == 0 ? RBFM_LOAD_BLOCK_PAGES : 2 * chunk.capacity;
+            void *grown;
+            if (posix_memalign(&grown, PAGE_SIZE, (size_t) capacity * chunk.pageSize) != 0)
+                return RBFM_MALLOC_FAILED;
+            if (chunk.pages > 0)
+                memcpy(grown, chunk.data, (size_t) chunk.pages * chunk.pageSize);
+            free(chunk.data);
+            chunk.data = (char *) grown;
+            chunk.capacity = capacity;
+        }
+        pageData = chunk.data + (size_t) chunk.pages * chunk.pageSize;
+        newRecordBasedPage(pageData, chunk.usablePageSize);
+        chunk.pages++;
     }
 
-    free(pageData);
+    SlotDirectoryHeader *slotHeader = slotDirectoryHeader(pageData);
+    rid.pageNum = chunk.pages - 1;
+    rid.slotNum = slotHeader->recordEntriesNumber;
+    SlotDirectoryRecordEntry &newRecordEntry = slotDirectory(pageData)[slotHeader->recordEntriesNumber];
+    newRecordEntry.length = recordSize;
+    newRecordEntry.offset = slotHeader->freeSpaceOffset - recordSize;
+    slotHeader->freeSpaceOffset = newRecordEntry.offset;
+    slotHeader->recordEntriesNumber += 1;
+    layout.encode(data, pageData + newRecordEntry.offset);
     return SUCCESS;
 }
 
+// Appends the chunk's pages with one write, so they are numbered in a row even with other appenders
+// about, and notes their free space in the free-space map
+RC RecordBasedFileManager::appendPageChunk(FileHandle &fileHandle, PageChunk &chunk, PageNum &firstPageNum) {
+    if (fileHandle.appendPages(chunk.pages, chunk.data, firstPageNum))
+        return RBFM_APPEND_FAILED;
+    for (unsigned p = 0; p < chunk.pages; p++)
+        fileHandle.setPageFreeSpace(firstPageNum + p, getPageFreeSpaceSize(chunk.data + (size_t) p * chunk.pageSize));
+    return SUCCESS;
+}
+
+// Runs a load block by block. The caller's thread cuts the input into blocks (readBlock, RBFM_EOF past
+// the last) while worker threads pack them onto pages of their own (packBlock), and the caller's thread
+// appends each block's pages in input order and tells placeBlock where they start. With one thread the
+// caller's packs every block itself. A block that fails ends the load: its packed rows are appended,
+// but the blocks after it are dropped.
+RC RecordBasedFileManager::loadBlocks(FileHandle &fileHandle, unsigned threads, double fillFactor,
+                                      const function<RC(LoadBlock&)> &readBlock, const function<RC(LoadBlock&)> &packBlock,
+                                      const function<void(LoadBlock&, PageNum)> &placeBlock) {
+    PageChunk emptyChunk;
+    RC rc = newPageChunk(fileHandle, fillFactor, emptyChunk);
+    if (rc)
+        return rc;
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1u);
+
+    mutex latch;
+    condition_variable blockQueued;
+    condition_variable blockPacked;
+    deque<LoadBlock*> queue;    // blocks read, waiting for a worker
+    bool stopping = false;
+    auto work = [&]() {
+        unique_lock<mutex> lock(latch);
+        for (;;) {
+            blockQueued.wait(lock, [&] { return !queue.empty() || stopping; });
+            if (queue.empty())
+                return;
+            LoadBlock *block = queue.front();
+            queue.pop_front();
+            lock.unlock();
+            RC packRc = packBlock(*block);
+            lock.lock();
+            block->rc = packRc;
+            block->packed = true;
+            blockPacked.notify_all();
+        }
+    };
+    vector<thread> workers;
+    try {
+        while (threads > 1 && workers.size() < threads)
+            workers.push_back(thread(work));
+    } catch (const system_error &) {
+        // Go on with the workers there are, if any
+    }
+
+    // Every worker has a block to pack and one more waiting, while the oldest is appended
+    deque<LoadBlock*> order;    // blocks read and not appended yet, in input order
+    bool reading = true;
+    while (reading || !order.empty()) {
+        while (reading && order.size() < 2 * workers.size() + 1) {
+            LoadBlock *block = new LoadBlock();
+            block->pages = emptyChunk;
+            RC readRc = readBlock(*block);
+            if (readRc) {
+                delete block;
+                reading = false;
+                if (readRc != RBFM_EOF)
+                    rc = readRc;
+                break;
+            }
+            order.push_back(block);
+            if (workers.empty()) {
+                block->rc = packBlock(*block);
+                block->packed = true;
+            } else {
+                lock_guard<mutex> lock(latch);
+                queue.push_back(block);
+                blockQueued.notify_one();
+            }
+        }
+        if (order.empty())
+            break;
+
+        LoadBlock *block = order.front();
+        order.pop_front();
+        {
+            unique_lock<mutex> lock(latch);
+            blockPacked.wait(lock, [&] { return block->packed; });
+        }
+        if (rc == SUCCESS) {
+            PageNum firstPageNum;
+            rc = appendPageChunk(fileHandle, block->pages, firstPageNum);
+            if (rc == SUCCESS) {
+                placeBlock(*block, firstPageNum);
+                rc = block->rc;
+            }
+        }
+        free(block->pages.data);
+        delete block;
+
+        // Blocks no worker has taken yet are dropped unpacked
+        if (rc) {
+            reading = false;
+            lock_guard<mutex> lock(latch);
+            for (LoadBlock *queued : queue)
+                queued->packed = true;
+            queue.clear();
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(latch);
+        stopping = true;
+    }
+    blockQueued.notify_all();
+    for (thread &worker : workers)
+        worker.join();
+    return rc;
+}
+
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data) {
-    // Retrieve the specific page
-    void * pageData = malloc(PAGE_SIZE);
-    if (fileHandle.readPage(rid.pageNum, pageData))
-        return RBFM_READ_FAILED;
+    return readRecord(fileHandle, layoutOf(recordDescriptor), rid, data);
+}
 
-    // Checks if the specific slot id exists in the page
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
+RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, void *data) {
+    // Retrieve the specific page. A memory-mapped file hands out the page itself, otherwise it is read in its buffer frame.
+    ReadPageGuard page;
+    const void * pageData = fileHandle.pageAddress(rid.pageNum);
+    if (pageData == NULL)
+    {
+        if (fileHandle.pinPage(rid.pageNum, page))
+            return RBFM_READ_FAILED;
+        pageData = page.data();
+    }
 
-    if(slotHeader.recordEntriesNumber < rid.slotNum)
+    // Checks if the specific slot id exists in the page
+    if(slotDirectoryHeader(pageData)->recordEntriesNumber <= rid.slotNum)
         return RBFM_SLOT_NO_EXIST;
 
     // Gets the slot directory record entry data
-    SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
+    const SlotDirectoryRecordEntry &recordEntry = slotDirectory(pageData)[rid.slotNum];
+    if (slotDeleted(recordEntry))
+        return RBFM_RECORD_DELETE;
+    if (slotForwarded(recordEntry)) {
+        RID newrid;
+        newrid.pageNum = recordEntry.length;
+        newrid.slotNum = -recordEntry.offset;
+        page.release();
+        return readRecord(fileHandle, layout, newrid, data);
+    }
 
     // Retrieve the actual entry data
-    getRecordAtOffset(pageData, recordEntry.offset, recordDescriptor, data);
+    layout.decode((const char *) pageData + recordEntry.offset, data);
 
-    free(pageData);
     return SUCCESS;
 }
 
@@ -456,70 +873,97 @@ RC RecordBasedFileManager::printRecord(const vector<Attribute> &recordDescriptor
 
 RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid) {
     //find the page rid = page id, slot id
-    //put to mem
+    //pin it in the buffer pool, and change it in place
     //delete record data, update slot directory header (offset, length = -1),
     //rearrange page, when a record is deleted, you need to move up all the records after it, so that there are no gaps
     //rid not change ,  the information in their slots changes
-    // filehandler writing the page to disk write back
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    if (fileHandle.readPage(rid.pageNum, pageData)){
-        free(pageData);
+    // releasing the page guard writes the page back
+    WritePageGuard page;
+    if (fileHandle.pinPage(rid.pageNum, page))
         return RBFM_READ_FAILED;
-    }
 
     // Checks if the specific slot id exists in the page
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
-
-    if(slotHeader.recordEntriesNumber < rid.slotNum){
-        free(pageData);
+    if(slotDirectoryHeader(page.data())->recordEntriesNumber <= rid.slotNum)
         return RBFM_SLOT_NO_EXIST;
-    }
-
 
-    // Gets the slot directory record entry data
-    SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
-    if (recordEntry.length == 0){
-        free(pageData);
+    const SlotDirectoryRecordEntry &currentEntry = slotDirectory(page.data())[rid.slotNum];
+    if (slotDeleted(currentEntry))
         return RBFM_DELETE_FAILED;
-    }
-    else if (recordEntry.offset <= 0) {
+
+    // A moved record is deleted where it lives, then its forwarding address here.
+    // Only one page is latched at a time, so this one is let go meanwhile.
+    if (slotForwarded(currentEntry)) {
         RID newrid;
-        newrid.pageNum = recordEntry.length;
-        newrid.slotNum = -recordEntry.offset;
+        newrid.pageNum = currentEntry.length;
+        newrid.slotNum = -currentEntry.offset;
+        page.release();
 
         if (deleteRecord(fileHandle, recordDescriptor, newrid)) {
-            free(pageData);
             return RBFM_DELETE_FAILED;
         }
-        recordEntry.length = 0;
-        setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+        if (fileHandle.pinPage(rid.pageNum, page))
+            return RBFM_READ_FAILED;
+        // The end of the page, where no record starts, marks the slot deleted rather than forwarded
+        SlotDirectoryRecordEntry &forward = slotDirectory(page.mutableData())[rid.slotNum];
+        forward.length = 0;
+        forward.offset = fileHandle.getPageSize();
+        return releaseAfterDelete(fileHandle, page, rid.pageNum);
     }
-    else {
-        for (int i = rid.slotNum + 1; i < recordDescriptor.size(); i++) {
-            // update the slot directory record entry data
-            SlotDirectoryRecordEntry moveEntry = getSlotDirectoryRecordEntry(pageData, i);
-            moveEntry.offset += recordEntry.length;
-            setSlotDirectoryRecordEntry(pageData, i, moveEntry);
-        }
 
-        // Updating the slot directory header.
-        slotHeader.freeSpaceOffset += recordEntry.length;
-        slotHeader.recordEntriesNumber -= 1;
-        setSlotDirectoryHeader(pageData, slotHeader);
+    // The slot is kept, emptied
+    shrinkRecord(page.mutableData(), rid.slotNum, 0);
+    return releaseAfterDelete(fileHandle, page, rid.pageNum);
+}
 
-        // set deleted recordentry length  = 0
-        recordEntry.length = 0;
-        setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+// Records are packed down from the end of the page. A record shrinking keeps where it ends, and
+// the ones stored below it move up by as much, so the free space stays in one piece. Its first
+// newLength bytes are left for the caller to fill in; at 0 it is gone.
+void RecordBasedFileManager::shrinkRecord(void * page, unsigned slotNum, unsigned newLength) {
+    SlotDirectoryHeader *slotHeader = slotDirectoryHeader(page);
+    SlotDirectory slots = slotDirectory(page);
+    SlotDirectoryRecordEntry &recordEntry = slots[slotNum];
+
+    unsigned reduced = recordEntry.length - newLength;
+    int32_t offset = recordEntry.offset;
+    memmove((char *) page + slotHeader->freeSpaceOffset + reduced, (char *) page + slotHeader->freeSpaceOffset,
+            offset - slotHeader->freeSpaceOffset);
+    for (unsigned i = 0; i < slotHeader->recordEntriesNumber; i++) {
+        // update the slot directory record entry data
+        if (slots[i].length > 0 && slots[i].offset > 0 && slots[i].offset < offset)
+            slots[i].offset += reduced;
     }
-    // Writing the page to disk.
 
-    if (fileHandle.writePage(rid.pageNum, pageData)){
-        return RBFM_WRITE_FAILED;
+    // Updating the slot directory header.
+    slotHeader->freeSpaceOffset += reduced;
+    recordEntry.offset = offset + reduced;
+    recordEntry.length = newLength;
+}
+
+// A page left without records is zeroed and given back to the file, to be reused for the next
+// page needed; otherwise the free-space map learns of the room made
+RC RecordBasedFileManager::releaseAfterDelete(FileHandle &fileHandle, WritePageGuard &page, PageNum pageNum) {
+    void *pageData = page.mutableData();
+    const SlotDirectoryHeader *slotHeader = slotDirectoryHeader(pageData);
+    const SlotDirectoryRecordEntry *slots = slotDirectory(pageData);
+    bool empty = true;
+    for (unsigned i = 0; i < slotHeader->recordEntriesNumber && empty; i++) {
+        empty = slotDeleted(slots[i]);
+    }
+
+    if (empty) {
+        memset(pageData, 0, fileHandle.getPageSize());
+        if (fileHandle.freePage(pageNum))
+            return RBFM_DELETE_FAILED;
+        if (page.release())
+            return RBFM_WRITE_FAILED;
+        return SUCCESS;
     }
 
-    free(pageData);
+    unsigned freeSpace = getPageFreeSpaceSize(pageData);
+    if (page.release())
+        return RBFM_WRITE_FAILED;
+    fileHandle.setPageFreeSpace(pageNum, freeSpace);
+
     return SUCCESS;
 
 }
@@ -528,80 +972,64 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const vector<Att
 //when a record is updated to have a different length, that can be treated as a delete
 // (with compaction) plus an insert if the record fits in the free space now on the page.
 RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid) {
+    return updateRecord(fileHandle, layoutOf(recordDescriptor), data, rid);
+}
 
-    void *pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL)
-        return RBFM_MALLOC_FAILED;
-    if (fileHandle.readPage(rid.pageNum, pageData)){
-        free(pageData);
+RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, const RID &rid) {
+
+    WritePageGuard page;
+    if (fileHandle.pinPage(rid.pageNum, page))
         return RBFM_READ_FAILED;
-    }
 
 
     // Checks if the specific slot id exists in the page
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
-
-    if(slotHeader.recordEntriesNumber < rid.slotNum) {
-        free(pageData);
+    if(slotDirectoryHeader(page.data())->recordEntriesNumber <= rid.slotNum)
         return RBFM_SLOT_NO_EXIST;
-    }
 
     // Gets the slot directory record entry data
-    SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
-    if (recordEntry.length == 0){
-        free(pageData);
+    const SlotDirectoryRecordEntry &currentEntry = slotDirectory(page.data())[rid.slotNum];
+    if (slotDeleted(currentEntry)){
         return RBFM_DELETE_FAILED;
     }
-    if (recordEntry.offset <= 0) {
+    if (slotForwarded(currentEntry)) {
         RID newrid;
-        newrid.pageNum = recordEntry.length;
-        newrid.slotNum = -recordEntry.offset;
-        free(pageData);
-        return updateRecord(fileHandle, recordDescriptor, data, newrid);
+        newrid.pageNum = currentEntry.length;
+        newrid.slotNum = -currentEntry.offset;
+        page.release();
+        return updateRecord(fileHandle, layout, data, newrid);
     }
+
+    void *pageData = page.mutableData();
+    SlotDirectoryHeader *slotHeader = slotDirectoryHeader(pageData);
+    SlotDirectoryRecordEntry &recordEntry = slotDirectory(pageData)[rid.slotNum];
+
     // if updated record length stays the same, update it and done
-    unsigned newrecordSize = getRecordSize(recordDescriptor, data);
+    unsigned newrecordSize = layout.recordSize(data);
     if (newrecordSize == recordEntry.length) {
         // Adding the record data.
-        setRecordAtOffset (pageData, recordEntry.offset, recordDescriptor, data);
+        layout.encode(data, (char *) pageData + recordEntry.offset);
     }
         // if updated record length become smaller, update it and compact the page
         // move other records.
     else if (newrecordSize < recordEntry.length) {
-        setRecordAtOffset (pageData, recordEntry.offset, recordDescriptor, data);
-        unsigned reducedlength = recordEntry.length - newrecordSize;
-        recordEntry.length = newrecordSize;
-        for (int i = rid.slotNum + 1; i < recordDescriptor.size(); i++) {
-            // update the slot directory record entry data
-            SlotDirectoryRecordEntry moveEntry = getSlotDirectoryRecordEntry(pageData, i);
-            moveEntry.offset += reducedlength;
-            setSlotDirectoryRecordEntry(pageData, i, moveEntry);
-        }
-        // Updating the slot directory header.
-        slotHeader.freeSpaceOffset += reducedlength;
-        setSlotDirectoryHeader(pageData, slotHeader);
+        shrinkRecord(pageData, rid.slotNum, newrecordSize);
+        layout.encode(data, (char *) pageData + recordEntry.offset);
     }
-    // if record become bigger, check if the record fits in the free space now on the page
-    // if yes, delete the record and insert the record
+    // if record become bigger, check if the record fits in the free space now on the page,
+    // the room of its old copy included; if yes, put it there under the same slot
     else {
-        if (deleteRecord(fileHandle, recordDescriptor, rid)) {
-            free(pageData);
-            return RBFM_UPDATE_FAILED;
-        }
-        if (getPageFreeSpaceSize(pageData) >= newrecordSize) {
+        if (getPageFreeSpaceSize(pageData) + recordEntry.length >= newrecordSize) {
+            shrinkRecord(pageData, rid.slotNum, 0);
+
             // Adding the new record reference in the slot directory.
-            SlotDirectoryRecordEntry newRecordEntry;
-            newRecordEntry.length = newrecordSize;
-            newRecordEntry.offset = slotHeader.freeSpaceOffset - newrecordSize;
-            setSlotDirectoryRecordEntry(pageData, rid.slotNum, newRecordEntry);
+            recordEntry.length = newrecordSize;
+            recordEntry.offset = slotHeader->freeSpaceOffset - newrecordSize;
 
             // Updating the slot directory header.
-            slotHeader.freeSpaceOffset = newRecordEntry.offset;
-            slotHeader.recordEntriesNumber += 1;
-            setSlotDirectoryHeader(pageData, slotHeader);
+            slotHeader->freeSpaceOffset = recordEntry.offset;
 
             // Adding the record data.
-            setRecordAtOffset(pageData, newRecordEntry.offset, recordDescriptor, data);
+            layout.encode(data, (char *) pageData + recordEntry.offset);
         }
         else{
             //if no the record must be migrated to a new page that has enough free space.
@@ -611,76 +1039,75 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const vector<Att
             //migrated to a new page that has enough free space
 
             //find a page with enough space
+            //only one page is latched at a time, so this one is let go while the record is inserted
+            page.release();
             RID new_rid;
-            RC rc = insertRecord(fileHandle, recordDescriptor, data, new_rid);
+            RC rc = insertRecord(fileHandle, layout, data, new_rid);
             if (rc) {
-                free(pageData);
                 return rc;
             }
             //moved
-            recordEntry.length = new_rid.pageNum;
-            recordEntry.offset = -new_rid.slotNum;
-            setSlotDirectoryRecordEntry(pageData, rid.slotNum, recordEntry);
+            if (fileHandle.pinPage(rid.pageNum, page))
+                return RBFM_READ_FAILED;
+            pageData = page.mutableData();
+            SlotDirectoryRecordEntry &forward = slotDirectory(pageData)[rid.slotNum];
+            // The old copy gives its room back
+            if (forward.length > 0 && forward.offset > 0)
+                shrinkRecord(pageData, rid.slotNum, 0);
+            forward.length = new_rid.pageNum;
+            forward.offset = -new_rid.slotNum;
             }
     }
-    // Writing the page to disk.
+    unsigned freeSpace = getPageFreeSpaceSize(pageData);
 
-    if (fileHandle.writePage(rid.pageNum, pageData)){
-        free(pageData);
+    // Writing the page to disk.
+    if (page.release()){
         return RBFM_WRITE_FAILED;
     }
+    fileHandle.setPageFreeSpace(rid.pageNum, freeSpace);
 
-    free(pageData);
     return SUCCESS;
     }
 
 //Given a record descriptor, read a specific attribute of a record identified by a given rid.
 RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string &attributeName, void *data) {
-    Attribute attr;
-    unsigned i;
-    for (i = 0; i < recordDescriptor.size(); i++) {
-        if (recordDescriptor[i].name == attributeName) {
-            attr = recordDescriptor[i];
-            break;
-        }
-    }
-    if (i == recordDescriptor.size()) {
+    return readAttribute(fileHandle, layoutOf(recordDescriptor), rid, attributeName, data);
+}
+
+// The value comes after a byte that is 1 if it is NULL, and 0 if not
+RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, const string &attributeName, void *data) {
+    int i = layout.getFieldIndex(attributeName);
+    if (i < 0) {
         return RBFM_READ_FAILED;
     }
-    // Retrieve the specific page
-    void * pageData = malloc(PAGE_SIZE);
-    if (pageData == NULL) {
-        return RBFM_MALLOC_FAILED;
-    }
-    if (fileHandle.readPage(rid.pageNum, pageData)){
-        free(pageData);
+    // Retrieve the specific page, in its buffer frame
+    ReadPageGuard page;
+    if (fileHandle.pinPage(rid.pageNum, page)){
         return RBFM_READ_FAILED;
     }
+    const void * pageData = page.data();
 
     // Checks if the specific slot id exists in the page
-    SlotDirectoryHeader slotHeader = getSlotDirectoryHeader(pageData);
-
-    if(slotHeader.recordEntriesNumber < rid.slotNum)
+    if(slotDirectoryHeader(pageData)->recordEntriesNumber <= rid.slotNum)
         return RBFM_SLOT_NO_EXIST;
 
     // Gets the slot directory record entry data
-    SlotDirectoryRecordEntry recordEntry = getSlotDirectoryRecordEntry(pageData, rid.slotNum);
+    const SlotDirectoryRecordEntry &recordEntry = slotDirectory(pageData)[rid.slotNum];
     //deleted
-    if (recordEntry.length == 0) {
-        free(pageData);
+    if (slotDeleted(recordEntry)) {
         return RBFM_RECORD_DELETE;
     }
     //moved
-    if (recordEntry.offset < 0) {
+    if (slotForwarded(recordEntry)) {
         RID newrid;
         newrid.pageNum = recordEntry.length;
-        newrid.slotNum = recordEntry.offset;
-        free(pageData);
-        return readAttribute(fileHandle, recordDescriptor, newrid, attributeName, data);
+        newrid.slotNum = -recordEntry.offset;
+        page.release();
+        return readAttribute(fileHandle, layout, newrid, attributeName, data);
     }
 
-    readAttributeFromRecord(pageData, recordEntry.offset, i, attr.type, data);
-    free(pageData);
+    char *nullFlag = (char *) data;
+    *nullFlag = layout.decodeField((const char *) pageData + recordEntry.offset, i, nullFlag + 1) < 0;
 
 /*
     void * recordData = malloc(recordEntry.length);
@@ -707,9 +1134,20 @@ RBFM_ScanIterator:: RBFM_ScanIterator() {
     currslot = 0;
     totalpage = 0;
     totalslot = 0;
+    pageData = NULL;
+    pageBuffer = NULL;
+    chunkStart = 0;
+    chunkPages = 0;
+    readAhead = NULL;
+    projectionNullIndicatorSize = 0;
     rbfm = RecordBasedFileManager::instance();
 }
 
+// A scan left open still stops its read-ahead thread and frees its chunk
+RBFM_ScanIterator::~RBFM_ScanIterator() {
+    close();
+}
+
 
 
 // Scan returns an iterator to allow the caller to go through the results one by one.
@@ -721,12 +1159,28 @@ RBFM_ScanIterator:: RBFM_ScanIterator() {
 
 
 RC RBFM_ScanIterator::getCurrPage() {
-    if (filehandle.readPage(currpage, pageData)) {
-        return RBFM_READ_FAILED;
+    // Read straight from the file mapping when there is one
+    pageData = filehandle.pageAddress(currpage);
+    if (pageData == NULL && readAhead != NULL) {
+        if (readAhead->getPage(currpage, pageData)) {
+            return RBFM_READ_FAILED;
+        }
+    }
+    if (pageData == NULL) {
+        // Otherwise read the file a chunk at a time. Pages later in the chunk are as of the read,
+        // so records changed there in the meantime show up as they were.
+        if (currpage < chunkStart || currpage >= chunkStart + chunkPages) {
+            chunkStart = currpage;
+            chunkPages = min(totalpage - currpage, (uint32_t) RBFM_SCAN_CHUNK_PAGES);
+            if (filehandle.readPages(chunkStart, chunkPages, pageBuffer)) {
+                chunkPages = 0;
+                return RBFM_READ_FAILED;
+            }
+        }
+        pageData = (char *) pageBuffer + (size_t) (currpage - chunkStart) * filehandle.getPageSize();
     }
 
-    SlotDirectoryHeader header = rbfm->getSlotDirectoryHeader(pageData);
-    totalslot = header.recordEntriesNumber;
+    totalslot = rbfm->slotDirectoryHeader(pageData)->recordEntriesNumber;
     return SUCCESS;
 }
 
@@ -744,8 +1198,8 @@ RC RBFM_ScanIterator::getNextSlot() {
         }
     }
 
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currslot);
-    if (recordEntry.length == 0 || recordEntry.offset <= 0 || !conditionmeet()) {
+    const SlotDirectoryRecordEntry &recordEntry = rbfm->slotDirectory(pageData)[currslot];
+    if (slotDeleted(recordEntry) || slotForwarded(recordEntry) || !conditionmeet()) {
         currslot++;
         return getNextSlot();
 
@@ -816,102 +1270,42 @@ bool RBFM_ScanIterator::checkScanCondition(char* recordChar, CompOp compOp, cons
     }
 }
 
-void RecordBasedFileManager::readAttributeFromRecord(void *pageData, unsigned offset, unsigned attrIndex, AttrType type, void *data) {
-
-    //get the attribute and put it in data
-    char *start = (char *) pageData + offset;
-    unsigned data_offset = 0;
-
-    //get number of columns
-    RecordLength n;
-    memcpy(&n, start, sizeof(RecordLength));
-
-    //get null indicator
-    int recordNullIndicatorSize = getNullIndicatorSize(n);
-    char recordNullIndicator[recordNullIndicatorSize];
-
-    memcpy(recordNullIndicator, start + sizeof(RecordLength), recordNullIndicatorSize);
-
-    char resultNullIndicator = 0;
-
-    //if result is null, set null indicator for result
-
-    if (fieldIsNull(recordNullIndicator, attrIndex)) {
-        resultNullIndicator = 1;
-    }
-    memcpy(data, &resultNullIndicator, 1); // copy field null indicator to data
-    data_offset += 1;
-    if (resultNullIndicator) { return; }
-
-    //if result is not null, put it to data
-    // find attribute in page, put into data. data has one bit for null indicator, then attribute data.
-    // if type is varchar, also need to copy varchar size
-    unsigned attr_offset = sizeof(RecordLength) + recordNullIndicatorSize;
-    // want to find attribute real length to copy, and start_offset to copy
-    ColumnOffset start_offset;
-    ColumnOffset end_offset;
-
-    if (attrIndex > 0) {
-        memcpy(&start_offset, start + attr_offset + (attrIndex - 1) * sizeof(ColumnOffset), sizeof(ColumnOffset));
-    } else {
-        start_offset = attr_offset + n * sizeof(ColumnOffset);
-    }
-
-    memcpy(&end_offset, start + attr_offset + attrIndex * sizeof(ColumnOffset), sizeof(ColumnOffset));
-
-    unsigned attrlen = end_offset - start_offset;
-
-    if (type == TypeVarChar) {
-        memcpy((char *) data + data_offset, &attrlen, sizeof(VARCHAR_LENGTH_SIZE));
-        data_offset += VARCHAR_LENGTH_SIZE;
-    }
-
-    memcpy((char *) data + data_offset, start + start_offset, attrlen);
-}
-
 bool RBFM_ScanIterator::conditionmeet(){
     if (compOp == NO_OP) {return true;}
     if (value == NULL)  {return false;}
 
-    Attribute attr = recordDescriptor[attrIndex];
-
-    //allocate memory for calculation
-    void *data = malloc(1 + attr.length);
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currslot);
+    const Attribute &attr = layout.getAttributes()[attrIndex];
 
-    rbfm->readAttributeFromRecord(pageData, recordEntry.offset, attrIndex, attr.type, data);
+    // room for the attribute
+    char data[VARCHAR_LENGTH_SIZE + attr.length];
+    const SlotDirectoryRecordEntry &recordEntry = rbfm->slotDirectory(pageData)[currslot];
 
-    // now attribute information is in data
-    char nullind;
     bool result = false;
-    memcpy(&nullind, data, 1); // 1 is null, 0 is not  null
-
-    if (nullind) {
+    if (layout.decodeField((const char *) pageData + recordEntry.offset, attrIndex, data) < 0) {
         result =  false;
     }
 
     else if (attr.type == TypeInt) {
         int32_t recordInt;
-        memcpy(&recordInt, (char *) data + 1, INT_SIZE);
+        memcpy(&recordInt, data, INT_SIZE);
         result = checkScanCondition(recordInt, compOp, value);
     }
 
     else if (attr.type == TypeReal) {
         float recordReal;
-        memcpy(&recordReal, (char *) data + 1, REAL_SIZE);
+        memcpy(&recordReal, data, REAL_SIZE);
         result = checkScanCondition(recordReal, compOp, value);
     }
     else if (attr.type == TypeVarChar) {
         uint32_t varCharlen;
-        memcpy(&varCharlen, (char *) data + 1, VARCHAR_LENGTH_SIZE);
+        memcpy(&varCharlen, data, VARCHAR_LENGTH_SIZE);
         char recordChar[varCharlen + 1];
-        memcpy(recordChar, (char *) data + 1 + VARCHAR_LENGTH_SIZE, varCharlen);
+        memcpy(recordChar, data + VARCHAR_LENGTH_SIZE, varCharlen);
         recordChar[varCharlen] = '\0';
 
         result = checkScanCondition(recordChar, compOp, value);
 
     }
-    free(data);
     return result;
 
 }
@@ -928,61 +1322,25 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
         return SUCCESS;
     }
 
-    //prepare null indicator
-    unsigned nullIndicatorSize = rbfm->getNullIndicatorSize(attributeNames.size());
-    char nullIndicator[nullIndicatorSize];
-    memset(nullIndicator, 0, nullIndicatorSize);
+    // null indicator followed by the projected fields, each decoded straight into data
+    char *nullIndicator = (char *) data;
+    memset(nullIndicator, 0, projectionNullIndicatorSize);
+    char *field = nullIndicator + projectionNullIndicatorSize;
 
-    SlotDirectoryRecordEntry recordEntry = rbfm->getSlotDirectoryRecordEntry(pageData, currslot);
+    const SlotDirectoryRecordEntry &recordEntry = rbfm->slotDirectory(pageData)[currslot];
+    const char *record = (const char *) pageData + recordEntry.offset;
 
-    //just show put into data, null indicator follow by field, varChar use 4 bytes to store the length of characters
-    //only projected attribute
-    void *buffer = malloc(PAGE_SIZE);
-    if (buffer == NULL) {
-        return RBFM_MALLOC_FAILED;
-    }
-
-    unsigned dataoffset = nullIndicatorSize;
-
-    for (unsigned i = 0; i < attributeNames.size(); i++) {
-        Attribute attr;
-        unsigned j;
-        for (j = 0; j < recordDescriptor.size(); j++) {
-            if (recordDescriptor[j].name == attributeNames[i]) {
-                attr = recordDescriptor[j];
-                break;
-            }
-        }
-        if (j == recordDescriptor.size()) {
+    for (unsigned i = 0; i < projection.size(); i++) {
+        if (projection[i] < 0) {
             return RBFM_READ_FAILED;
         }
-        type = attr.type;
-        rbfm->readAttributeFromRecord(pageData, recordEntry.offset, j, type, buffer);
-
-        char nullInd;
-        memcpy(&nullInd, buffer, 1);
-        if (nullInd) {
-            int indicator_index = i / CHAR_BIT;
-            char indicator_mask = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-            nullIndicator[indicator_index] |= indicator_mask;
-        } else if (type == TypeInt) {
-            memcpy((char *) data + dataoffset, (char *) buffer + 1, INT_SIZE);
-            dataoffset += INT_SIZE;
-        } else if (type == TypeReal) {
-            memcpy((char *) data + dataoffset, (char *) buffer + 1, REAL_SIZE);
-            dataoffset += REAL_SIZE;
-        } else if (type == TypeVarChar) {
-            uint32_t varcharSize;
-            // We have to get the size of the VarChar field by reading the integer that precedes the string value itself
-            memcpy(&varcharSize, (char *) buffer + 1, VARCHAR_LENGTH_SIZE);
-            memcpy((char *) data + dataoffset, &varcharSize, VARCHAR_LENGTH_SIZE);
-            dataoffset += VARCHAR_LENGTH_SIZE;
-            memcpy((char *) data + dataoffset, (char *) buffer + 1 + VARCHAR_LENGTH_SIZE, varcharSize);
-            dataoffset += varcharSize;
+        int size = layout.decodeField(record, projection[i], field);
+        if (size < 0) {
+            nullIndicator[i / CHAR_BIT] |= 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
+        } else {
+            field += size;
         }
     }
-    memcpy((char *) data, nullIndicator, nullIndicatorSize);
-    free(buffer);
     rid.pageNum = currpage;
     rid.slotNum = currslot++;
     return SUCCESS;
@@ -990,7 +1348,12 @@ RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
 
 
 RC RBFM_ScanIterator::close(){
-    free(pageData);
+    delete readAhead;
+    readAhead = NULL;
+    free(pageBuffer);
+    pageBuffer = NULL;
+    pageData = NULL;
+    chunkPages = 0;
     return SUCCESS;
 }
 
@@ -1001,59 +1364,91 @@ RC RecordBasedFileManager::scan(FileHandle &fileHandle,
         const void *value,                    // used in the comparison
         const vector<string> &attributeNames, // a list of projected attributes
         RBFM_ScanIterator &rbfm_ScanIterator) {
-    return rbfm_ScanIterator.scanInit(fileHandle, recordDescriptor, conditionAttribute, compOp, value, attributeNames);
+    return scan(fileHandle, layoutOf(recordDescriptor), conditionAttribute, compOp, value, attributeNames, rbfm_ScanIterator);
+}
+
+// The iterator keeps a copy of the layout, so it outlives the call
+RC RecordBasedFileManager::scan(FileHandle &fileHandle,
+        const RecordLayout &layout,
+        const string &conditionAttribute,
+        const CompOp compOp,
+        const void *value,
+        const vector<string> &attributeNames,
+        RBFM_ScanIterator &rbfm_ScanIterator) {
+    return rbfm_ScanIterator.scanInit(fileHandle, layout, conditionAttribute, compOp, value, attributeNames);
 }
 
 
 
 
 RC RBFM_ScanIterator ::scanInit(FileHandle &fh,
-                                const vector<Attribute> &recordD,
+                                const RecordLayout &recordLayout,
                                 const string &conditionA, // Specifically, the parameter conditionAttribute here is the attribute's name that you are going to apply the filter on
                                 const CompOp comp,                  // comparision type such as "<" and "="
                                 const void *val,                    // used in the comparison
                                 const vector<string> &attributes) {
+    // An iterator reused for another scan lets go of the last one first
+    close();
+
     //scan starts from the first page first slot
     currpage = 0;
     currslot = 0;
     totalpage = 0;
     totalslot = 0;
 
-    pageData = malloc(PAGE_SIZE);
+    chunkStart = 0;
+    chunkPages = 0;
+
+    // Page aligned, so chunks can be read into it even with O_DIRECT
+    if (posix_memalign(&pageBuffer, PAGE_SIZE, (size_t) RBFM_SCAN_CHUNK_PAGES * fh.getPageSize()) != 0) {
+        pageBuffer = NULL;
+        return RBFM_MALLOC_FAILED;
+    }
+    pageData = pageBuffer;
 
+    // The scan reads every page once; whatever it pulls into the buffer pool shouldn't push out the rest
     filehandle = fh;
-    recordDescriptor = recordD;
+    filehandle.setAccessPattern(AccessSequential);
+    layout = recordLayout;
     conditionAttribute = conditionA;
     compOp = comp;
     value = val;
     attributeNames = attributes;
 
+    // Projected attributes are looked up once, not per record
+    projection.clear();
+    for (unsigned i = 0; i < attributeNames.size(); i++) {
+        projection.push_back(layout.getFieldIndex(attributeNames[i]));
+    }
+    projectionNullIndicatorSize = rbfm->getNullIndicatorSize(attributeNames.size());
+
     totalpage = filehandle.getNumberOfPages();
+
+    // A scan longer than a chunk reads ahead; should the thread not start, it reads a chunk at a time
+    if (filehandle.isReadAhead() && totalpage > RBFM_SCAN_CHUNK_PAGES) {
+        readAhead = new ReadAhead();
+        if (readAhead->start(filehandle, totalpage, RBFM_SCAN_CHUNK_PAGES)) {
+            delete readAhead;
+            readAhead = NULL;
+        }
+    }
+
     if (totalpage > 0) {
-        if(filehandle.readPage(0, pageData)) {
-            return RBFM_READ_FAILED;
+        RC rc = getCurrPage();
+        if (rc) {
+            return rc;
         }
-        SlotDirectoryHeader slotDirectoryHeader = rbfm->getSlotDirectoryHeader(pageData);
-        totalslot = slotDirectoryHeader.recordEntriesNumber;
 
         if (comp == NO_OP) {
             return SUCCESS;
         }
 
-        Attribute attr;
-        unsigned i;
-        for (i = 0; i < recordDescriptor.size(); i++) {
-            if (recordDescriptor[i].name == conditionAttribute) {
-                attr = recordDescriptor[i];
-                break;
-            }
-        }
-
-        if (i == recordDescriptor.size()) {
+        int i = layout.getFieldIndex(conditionAttribute);
+        if (i < 0) {
             return RBFM_ScanIterator_ERROR;
         }
         attrIndex = i;
-        type = attr.type;
+        type = layout.getAttributes()[i].type;
 
         return SUCCESS;
 
@@ -3,6 +3,9 @@
 
 #include <string>
 #include <vector>
+#include <istream>
+#include <functional>
+#include <unordered_map>
 #include <climits>
 #include <inttypes.h>
 #include "../rbf/pfm.h"
@@ -23,6 +26,9 @@
 #define RBFM_ScanIterator_ERROR 10
 #define RBFM_RECORD_DELETE 11
 #define RM_CANNOT_DELETE_SYS 12;
+#define RBFM_RECORD_TOO_LARGE 13
+#define RBFM_BAD_FILL_FACTOR  14
+#define RBFM_CSV_PARSE_FAILED 15
 
 using namespace std;
 
@@ -57,12 +63,17 @@ typedef enum { EQ_OP = 0, // no condition// =
 
 // Slot directory headers for page organization
 // See chapter 9.6.2 of the cow book or lecture 3 slide 17 for more information
+// The free space offset of an empty page is the page size, which takes more than 16 bits on 64 KB pages.
 typedef struct SlotDirectoryHeader
 {
-    uint16_t freeSpaceOffset;
-    uint16_t recordEntriesNumber;
+    uint32_t freeSpaceOffset;
+    uint32_t recordEntriesNumber;
 } SlotDirectoryHeader;
 
+// A slot holds one of:
+//  a record:               offset > 0, where it starts; length > 0
+//  a forwarding address:   offset <= 0, minus the slot the record moved to; length, the page it is on (0 included)
+//  nothing, once deleted:  offset > 0; length 0
 typedef struct SlotDirectoryRecordEntry
 {
     uint32_t length;
@@ -74,12 +85,115 @@ typedef SlotDirectoryRecordEntry* SlotDirectory;
 typedef uint16_t ColumnOffset;
 
 typedef uint16_t RecordLength;
+
+// How one type of field moves between the insertRecord format and a record on a page
+typedef struct FieldCodec
+{
+    unsigned (*measure)(const char *&field);                                // bytes the value takes on the page, stepping past it
+    void (*encode)(const char *&field, char *&stored);                      // copies the value onto the page, stepping past it in both
+    void (*decode)(const char *stored, unsigned storedSize, char *&field);  // copies it back, stepping past it in field
+} FieldCodec;
+
+// RecordLayout is a record descriptor compiled once: the null-indicator size, the offsets of the
+// fixed-width fields before the first VarChar, a hash from attribute name to index, and a codec
+// per field. The calls that take a layout use it as is, and a caller that reuses a schema keeps
+// its own. Those that take a descriptor fall back on the last layout compiled on the thread,
+// checked against the descriptor each call and compiled again when it differs.
+class RecordLayout
+{
+public:
+    RecordLayout();
+    explicit RecordLayout(const vector<Attribute> &recordDescriptor);
+
+    const vector<Attribute>& getAttributes() const;
+    unsigned getFieldCount() const;
+    unsigned getNullIndicatorSize() const;
+    int getFieldIndex(const string &name) const;                    // -1 if there is no such attribute
+    bool matches(const vector<Attribute> &recordDescriptor) const;  // compiled from the same attributes
+
+    unsigned recordSize(const void *data) const;                    // bytes a record in the insertRecord format takes on a page
+    void encode(const void *data, void *record) const;              // writes it as a record on a page
+    void decode(const void *record, void *data) const;              // and reads it back; fields the record was written without are NULL
+    int decodeField(const void *record, unsigned index, void *field) const;    // one value, in the insertRecord format; its size, or -1 if NULL
+
+private:
+    vector<Attribute> attributes;
+    vector<FieldCodec> codecs;
+    unordered_map<string, unsigned> fieldIndex;
+    unsigned nullIndicatorSize;
+    unsigned headerSize;            // field count, null indicator and column offsets of a record on a page
+    unsigned fixedFields;           // fields before the first VarChar
+    vector<unsigned> fixedOffsets;  // where each of them starts in the insertRecord format past the null indicator, with none NULL; then where they end
+    vector<char> fixedHeader;       // the start of a record with none NULL: field count, null indicator and the fixed fields' column offsets
+
+    bool anyNull(const char *nullIndicator) const;
+};
 /********************************************************************************
 The scan iterator is NOT required to be implemented for the part 1 of the project
 ********************************************************************************/
 
 # define RBFM_EOF (-1)  // end of a scan operator
 
+// Pages a scan reads from the file at a time
+#define RBFM_SCAN_CHUNK_PAGES 32
+
+// insertRecords and bulkLoad cut their rows into blocks, and each block is packed onto pages of its
+// own by one thread, then appended with one write. A bulkLoad block holds the whole rows that reach
+// RBFM_LOAD_BLOCK_BYTES of text, an insertRecords block RBFM_LOAD_BLOCK_RECORDS records. Blocks are
+// cut the same for any number of threads, so the rows land on the same pages whatever the number.
+#define RBFM_LOAD_BLOCK_BYTES   (1 << 20)
+#define RBFM_LOAD_BLOCK_RECORDS 4096
+
+// Pages a block's buffer starts with, doubling whenever it runs out
+#define RBFM_LOAD_BLOCK_PAGES   32
+
+// Record-based pages built in memory, to append to a file all at once
+typedef struct PageChunk
+{
+    char *data;
+    unsigned capacity;          // pages data has room for
+    unsigned pageSize;
+    unsigned usablePageSize;
+    unsigned reservedBytes;     // room a page keeps free once it holds a record, as the fill factor asks
+    unsigned pages;             // pages started, the last one still taking records
+} PageChunk;
+
+// A block of a load, packed by a worker thread
+typedef struct LoadBlock
+{
+    string text;                // bulkLoad: whole rows of CSV
+    unsigned firstLine;         // bulkLoad: line of the input the text starts on
+    size_t firstRecord;         // insertRecords: the records [firstRecord, endRecord)
+    size_t endRecord;
+    PageChunk pages;
+    uint64_t rows;              // rows packed
+    unsigned errorLine;         // bulkLoad: line of the row that could not be packed, or 0
+    RC rc;
+    bool packed;
+} LoadBlock;
+
+// How bulkLoad reads its input
+typedef struct BulkLoadOptions
+{
+    char delimiter = ',';
+    bool header = false;        // the first row names the columns, and is skipped
+    double fillFactor = 1.0;    // share of each page to fill, in (0, 1]; the rest is left for records to grow into
+    unsigned threads = 0;       // threads parsing and packing rows, 0 for one per core
+} BulkLoadOptions;
+
+// What a bulkLoad did, and how fast
+typedef struct BulkLoadStats
+{
+    uint64_t rows;              // records loaded
+    uint64_t bytes;             // input read
+    unsigned pages;             // pages appended
+    uint64_t nanos;             // time taken, parsing included
+    unsigned errorLine;         // line of the row that stopped the load, or 0
+
+    double rowsPerSecond() const;
+    double megabytesPerSecond() const;
+} BulkLoadStats;
+
 // RBFM_ScanIterator is an iterator to go through records
 // The way to use it is like the following:
 //  RBFM_ScanIterator rbfmScanIterator;
@@ -89,6 +203,7 @@ The scan iterator is NOT required to be implemented for the part 1 of the projec
 //  }
 //  rbfmScanIterator.close();
 class RBFM_ScanIterator;
+class ReadAhead;
 
 class RecordBasedFileManager
 {
@@ -97,10 +212,16 @@ public:
 
     RC createFile(const string &fileName);
 
+    RC createFile(const string &fileName, unsigned pageSize);
+
+    RC createFile(const string &fileName, unsigned pageSize, unsigned flags);   // flags as for PagedFileManager::createFile
+
     RC destroyFile(const string &fileName);
 
     RC openFile(const string &fileName, FileHandle &fileHandle);
 
+    RC openFile(const string &fileName, FileHandle &fileHandle, const FileOptions &options);
+
     RC closeFile(FileHandle &fileHandle);
 
     //  Format of the data passed into the function is the following:
@@ -118,8 +239,24 @@ public:
     //  !!! The same format is used for updateRecord(), the returned data of readRecord(), and readAttribute().
     // For example, refer to the Q8 of the Project1 document.
     RC insertRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, RID &rid);
+    RC insertRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, RID &rid);
+
+    // Inserts many records at once, in the same format, onto new pages appended to the file; rids[i] is where records[i] went
+    RC insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void*> &records, vector<RID> &rids);
+
+    // The same, packing the records on as many threads, 0 for one per core
+    RC insertRecords(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const vector<const void*> &records, vector<RID> &rids,
+                     unsigned threads);
+
+    // Loads the rows of a CSV file, a field per attribute, onto new pages appended to the file. An empty field is NULL;
+    // a field in double quotes may hold the delimiter, line breaks and doubled quotes, and "" is an empty string.
+    // Rows are read, encoded and packed as they stream in, so the input can be any size. A row that does not parse
+    // stops the load with RBFM_CSV_PARSE_FAILED and stats.errorLine set; the rows before it stay loaded.
+    RC bulkLoad(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, istream &input, const BulkLoadOptions &options, BulkLoadStats &stats);
+    RC bulkLoad(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const string &csvFileName, const BulkLoadOptions &options, BulkLoadStats &stats);
 
     RC readRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, void *data);
+    RC readRecord(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, void *data);
 
     // This method will be mainly used for debugging/testing.
     // The format is as follows:
@@ -135,8 +272,10 @@ IMPORTANT, PLEASE READ: All methods below this comment (other than the construct
 
     // Assume the RID does not change after an update
     RC updateRecord(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const void *data, const RID &rid);
+    RC updateRecord(FileHandle &fileHandle, const RecordLayout &layout, const void *data, const RID &rid);
 
     RC readAttribute(FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, const RID &rid, const string &attributeName, void *data);
+    RC readAttribute(FileHandle &fileHandle, const RecordLayout &layout, const RID &rid, const string &attributeName, void *data);
 
     // Scan returns an iterator to allow the caller to go through the results one by one.
     RC scan(FileHandle &fileHandle,
@@ -146,6 +285,13 @@ IMPORTANT, PLEASE READ: All methods below this comment (other than the construct
             const void *value,                    // used in the comparison
             const vector<string> &attributeNames, // a list of projected attributes
             RBFM_ScanIterator &rbfm_ScanIterator);
+    RC scan(FileHandle &fileHandle,
+            const RecordLayout &layout,
+            const string &conditionAttribute,
+            const CompOp compOp,
+            const void *value,
+            const vector<string> &attributeNames,
+            RBFM_ScanIterator &rbfm_ScanIterator);
 
 public:
     friend class RBFM_ScanIterator;
@@ -160,31 +306,35 @@ private:
 
     // Private helper methods
 
-    void newRecordBasedPage(void * page);
-
-    SlotDirectoryHeader getSlotDirectoryHeader(void * page);
-    void setSlotDirectoryHeader(void * page, SlotDirectoryHeader slotHeader);
+    void newRecordBasedPage(void * page, unsigned pageSize);
 
-    SlotDirectoryRecordEntry getSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber);
-    void setSlotDirectoryRecordEntry(void * page, unsigned recordEntryNumber, SlotDirectoryRecordEntry recordEntry);
+    // The slot directory, read and written in place (pages in buffer frames and scan chunks are page aligned)
+    SlotDirectoryHeader* slotDirectoryHeader(void * page);
+    const SlotDirectoryHeader* slotDirectoryHeader(const void * page);
+    SlotDirectory slotDirectory(void * page);
+    const SlotDirectoryRecordEntry* slotDirectory(const void * page);
 
-    unsigned getPageFreeSpaceSize(void * page);
-    unsigned getRecordSize(const vector<Attribute> &recordDescriptor, const void *data);
+    unsigned getPageFreeSpaceSize(const void * page);
+    bool isFreePage(const void * page);
+    void shrinkRecord(void * page, unsigned slotNum, unsigned newLength);
+    RC releaseAfterDelete(FileHandle &fileHandle, WritePageGuard &page, PageNum pageNum);
+    const RecordLayout& layoutOf(const vector<Attribute> &recordDescriptor);
 
     int getNullIndicatorSize(int fieldCount);
     bool fieldIsNull(char *nullIndicator, int i);
 
-    void readAttributeFromRecord(void *pageData, unsigned offset, unsigned attrIndex, AttrType type, void *data);
-
-    void setRecordAtOffset(void *page, unsigned offset, const vector<Attribute> &recordDescriptor, const void *data);
-    void getRecordAtOffset(void *record, unsigned offset, const vector<Attribute> &recordDescriptor, void *data);
+    RC newPageChunk(FileHandle &fileHandle, double fillFactor, PageChunk &chunk);
+    RC packRecord(PageChunk &chunk, const RecordLayout &layout, const void *data, RID &rid);
+    RC appendPageChunk(FileHandle &fileHandle, PageChunk &chunk, PageNum &firstPageNum);
+    RC loadBlocks(FileHandle &fileHandle, unsigned threads, double fillFactor, const function<RC(LoadBlock&)> &readBlock,
+                  const function<RC(LoadBlock&)> &packBlock, const function<void(LoadBlock&, PageNum)> &placeBlock);
 };
 
 
 class RBFM_ScanIterator {
 public:
     RBFM_ScanIterator();
-    ~RBFM_ScanIterator() {};
+    ~RBFM_ScanIterator();
 
     // Never keep the results in the memory. When getNextRecord() is called,
     // a satisfying record needs to be fetched from the file.
@@ -201,16 +351,22 @@ private:
     uint32_t totalpage;
     uint32_t totalslot;
 
-    void *pageData;
+    const void *pageData;   // the current page: inside pageBuffer, or inside the file mapping
+    void *pageBuffer;       // the chunk of up to RBFM_SCAN_CHUNK_PAGES pages read last
+    uint32_t chunkStart;
+    uint32_t chunkPages;
+    ReadAhead *readAhead;   // reads the chunks after the current one in the background, if the scan is long enough
     AttrType type;
     unsigned attrIndex;
 
     FileHandle filehandle;
-    vector<Attribute> recordDescriptor;
+    RecordLayout layout;
     string conditionAttribute;
     CompOp compOp;
     const void* value;
     vector<string> attributeNames;
+    vector<int> projection;         // the field index of each of attributeNames, -1 if none
+    unsigned projectionNullIndicatorSize;
 
 
     RC getCurrPage();
@@ -220,7 +376,7 @@ private:
     bool checkScanCondition(char* recordChar, CompOp compOp, const void*  value);
     bool conditionmeet();
     RC scanInit(FileHandle &fh,
-                const vector<Attribute> &recordD,
+                const RecordLayout &recordLayout,
                 const string &conditionA, // Specifically, the parameter conditionAttribute here is the attribute's name that you are going to apply the filter on
                 const CompOp comp,                  // comparision type such as "<" and "="
                 const void *val,                    // used in the comparison
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_13(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File
+    // 3. Insert Multiple Records (free-space map keeps page reads per insert constant)
+    // 4. Read Multiple Records
+    // 5. Close Record-Based File
+    // 6. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 13 *****" << endl;
+
+    RC rc;
+    string fileName = "test13";
+
+    unsigned readPageCount = 0;
+    unsigned writePageCount = 0;
+    unsigned appendPageCount = 0;
+    unsigned readPageCount1 = 0;
+    unsigned writePageCount1 = 0;
+    unsigned appendPageCount1 = 0;
+
+    // Create a file named "test13"
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    // Open the file "test13"
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    RID rid;
+    void *record = malloc(1000);
+    void *returnedData = malloc(1000);
+    int numRecords = 2000;
+
+    vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor(recordDescriptor);
+
+    // NULL field indicator
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    rc = fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(rc == success && "Collecting the counter values should not fail.");
+
+    // Insert 2000 records into file
+    vector<RID> rids;
+    vector<int> sizes;
+    for(int i = 0; i < numRecords; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+
+        rids.push_back(rid);
+        sizes.push_back(size);
+    }
+
+    rc = fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1);
+    assert(rc == success && "Collecting the counter values should not fail.");
+    cout << "before:R W A - " << readPageCount << " " << writePageCount << " " << appendPageCount << " after:R W A - " << readPageCount1 << " " << writePageCount1 << " " << appendPageCount1 << endl;
+
+    // Scanning the file for room would take a read per page per insert.
+    // With the free-space map, an insert reads at most the page it lands on.
+    if (readPageCount1 - readPageCount > (unsigned) numRecords)
+    {
+        cout << "[FAIL] Inserting " << numRecords << " records took " << readPageCount1 - readPageCount << " page reads. Test Case 13 Failed!" << endl << endl;
+        rbfm->closeFile(fileHandle);
+        free(record);
+        free(returnedData);
+        free(nullsIndicator);
+        return -1;
+    }
+
+    // Every record must still be where its RID says
+    for(int i = 0; i < numRecords; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        memset(returnedData, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+
+        if(memcmp(returnedData, record, sizes[i]) != 0)
+        {
+            cout << "[FAIL] Test Case 13 Failed!" << endl << endl;
+            rbfm->closeFile(fileHandle);
+            free(record);
+            free(returnedData);
+            free(nullsIndicator);
+            return -1;
+        }
+    }
+
+    // Close the file "test13"
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 13 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test13");
+
+    RC rcmain = RBFTest_13(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,130 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_14(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File with direct I/O
+    // 3. Append Page
+    // 4. Write Page
+    // 5. Read Page (from disk, after the buffer pool has been emptied)
+    // 6. Close File
+    // 7. Destroy File
+    cout << endl << "***** In RBF Test Case 14 *****" << endl;
+
+    RC rc;
+    string fileName = "test14";
+
+    // Create the file named "test14"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    // Open the file "test14", bypassing the OS page cache where the file system allows it
+    FileOptions options;
+    options.directIO = true;
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+    cout << "Direct I/O " << (fileHandle.isDirectIO() ? "enabled" : "not supported here, using buffered I/O") << endl;
+
+    // Append 50 pages. The caller's buffer is deliberately not page aligned.
+    char *block = (char *) malloc(PAGE_SIZE + 1);
+    void *data = block + 1;
+    for(unsigned j = 0; j < 50; j++)
+    {
+        for(unsigned i = 0; i < PAGE_SIZE; i++)
+        {
+            *((char *)data+i) = i % (j+1) + 32;
+        }
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    // Update the 20th page
+    for(unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)data+i) = i % 77 + 32;
+    }
+    rc = fileHandle.writePage(19, data);
+    assert(rc == success && "Writing a page should not fail.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Empty the buffer pool, so the pages below really come from the file
+    rc = BufferPoolManager::instance()->setCapacity(BufferPoolManager::instance()->getCapacity());
+    assert(rc == success && "Emptying the buffer pool should not fail.");
+
+    rc = pfm->openFile(fileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned count = fileHandle.getNumberOfPages();
+    assert(count == (unsigned)50 && "The count should be 50 at this moment.");
+
+    void *buffer = malloc(PAGE_SIZE);
+    for(unsigned j = 0; j < 50; j++)
+    {
+        for(unsigned i = 0; i < PAGE_SIZE; i++)
+        {
+            *((char *)data+i) = j == 19 ? i % 77 + 32 : i % (j+1) + 32;
+        }
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+
+        if(memcmp(buffer, data, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << j << " is corrupted. Test Case 14 Failed!" << endl << endl;
+            pfm->closeFile(fileHandle);
+            free(block);
+            free(buffer);
+            return -1;
+        }
+    }
+    cout << "The data in all 50 pages is correct!" << endl;
+
+    // Close the file "test14"
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(block);
+    free(buffer);
+
+    cout << "RBF Test Case 14 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test14");
+
+    RC rcmain = RBFTest_14(pfm);
+    return rcmain;
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Inserts numRecords records through a handle opened with the given durability mode
+// and returns their RIDs and sizes.
+void insertWithDurability(RecordBasedFileManager *rbfm, const string &fileName, const FileOptions &options,
+                          const vector<Attribute> &recordDescriptor, int numRecords, vector<RID> &rids, vector<int> &sizes)
+{
+    RC rc;
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *record = malloc(1000);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    for(int i = 0; i < numRecords; i++)
+    {
+        RID rid;
+        int size = 0;
+        memset(record, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+
+        rids.push_back(rid);
+        sizes.push_back(size);
+    }
+
+    // Explicit barrier half way through the life of the handle; the rest is made durable by closeFile
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    free(record);
+    free(nullsIndicator);
+}
+
+int RBFTest_15(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File with group commit and with deferred durability
+    // 3. Insert Multiple Records
+    // 4. Sync and Close Record-Based File
+    // 5. Read Multiple Records (from disk, after the buffer pool has been emptied)
+    // 6. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 15 *****" << endl;
+
+    RC rc;
+    string fileName = "test15";
+
+    // Create a file named "test15"
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor(recordDescriptor);
+
+    vector<RID> rids;
+    vector<int> sizes;
+
+    FileOptions groupCommit;
+    groupCommit.durability = DurabilityGroupCommit;
+    groupCommit.groupCommitPages = 16;
+    insertWithDurability(rbfm, fileName, groupCommit, recordDescriptor, 500, rids, sizes);
+
+    FileOptions deferred;
+    deferred.durability = DurabilityDeferred;
+    insertWithDurability(rbfm, fileName, deferred, recordDescriptor, 500, rids, sizes);
+
+    // Empty the buffer pool, so the records below really come from the file
+    rc = BufferPoolManager::instance()->setCapacity(BufferPoolManager::instance()->getCapacity());
+    assert(rc == success && "Emptying the buffer pool should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *record = malloc(1000);
+    void *returnedData = malloc(1000);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    for(unsigned i = 0; i < rids.size(); i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        memset(returnedData, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i % 500, record, &size);
+
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+
+        if(memcmp(returnedData, record, sizes[i]) != 0)
+        {
+            cout << "[FAIL] Test Case 15 Failed!" << endl << endl;
+            rbfm->closeFile(fileHandle);
+            free(record);
+            free(returnedData);
+            free(nullsIndicator);
+            return -1;
+        }
+    }
+    cout << "All " << rids.size() << " records are correct on disk!" << endl;
+
+    // Close the file "test15"
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 15 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test15");
+
+    RC rcmain = RBFTest_15(rbfm);
+    return rcmain;
+}
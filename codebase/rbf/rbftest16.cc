@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_16(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File with a memory-mapped read path
+    // 3. Insert Multiple Records (the file grows past its first mapping)
+    // 4. Read Multiple Records
+    // 5. Scan
+    // 6. Close Record-Based File
+    // 7. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 16 *****" << endl;
+
+    RC rc;
+    string fileName = "test16";
+
+    // Create a file named "test16"
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    // Open the file "test16" with mmap reads
+    FileOptions options;
+    options.mmapReads = true;
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+
+    assert(fileHandle.pageAddress(0) != NULL && "A mapped file should hand out page addresses.");
+
+    RID rid;
+    void *record = malloc(1000);
+    void *returnedData = malloc(1000);
+    int numRecords = 2000;
+
+    vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor(recordDescriptor);
+
+    // NULL field indicator
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    // Insert 2000 records into file
+    vector<RID> rids;
+    vector<int> sizes;
+    for(int i = 0; i < numRecords; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+
+        rids.push_back(rid);
+        sizes.push_back(size);
+    }
+
+    // Read them back through the mapping
+    for(int i = 0; i < numRecords; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        memset(returnedData, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+
+        if(memcmp(returnedData, record, sizes[i]) != 0)
+        {
+            cout << "[FAIL] Record " << i << " is corrupted. Test Case 16 Failed!" << endl << endl;
+            rbfm->closeFile(fileHandle);
+            free(record);
+            free(returnedData);
+            free(nullsIndicator);
+            return -1;
+        }
+    }
+    cout << "All " << numRecords << " records are correct!" << endl;
+
+    // A full scan sees every record exactly once
+    vector<string> attributeNames;
+    attributeNames.push_back(recordDescriptor[0].name);
+    RBFM_ScanIterator scanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+
+    int scanned = 0;
+    while(scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+        scanned++;
+    scanIterator.close();
+
+    if(scanned != numRecords)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records. Test Case 16 Failed!" << endl << endl;
+        rbfm->closeFile(fileHandle);
+        free(record);
+        free(returnedData);
+        free(nullsIndicator);
+        return -1;
+    }
+    cout << "The scan returned all " << scanned << " records!" << endl;
+
+    // Close the file "test16"
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 16 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test16");
+
+    RC rcmain = RBFTest_16(rbfm);
+    return rcmain;
+}
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_17(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File twice
+    // 3. Append Page through both handles
+    // 4. Get Number Of Pages (seen by both handles, and kept in the file header)
+    // 5. Close File
+    // 6. Destroy File
+    cout << endl << "***** In RBF Test Case 17 *****" << endl;
+
+    RC rc;
+    string fileName = "test17";
+
+    // Create the file named "test17"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    // Open the file "test17" through two handles
+    FileHandle fileHandle1;
+    rc = pfm->openFile(fileName, fileHandle1);
+    assert(rc == success && "Opening the file should not fail.");
+
+    FileHandle fileHandle2;
+    rc = pfm->openFile(fileName, fileHandle2);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Append 30 pages, alternating between the handles
+    void *data = malloc(PAGE_SIZE);
+    for(unsigned j = 0; j < 30; j++)
+    {
+        for(unsigned i = 0; i < PAGE_SIZE; i++)
+        {
+            *((char *)data+i) = i % (j+1) + 32;
+        }
+        rc = (j % 2 == 0 ? fileHandle1 : fileHandle2).appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    if(fileHandle1.getNumberOfPages() != 30 || fileHandle2.getNumberOfPages() != 30)
+    {
+        cout << "[FAIL] The handles disagree on the number of pages. Test Case 17 Failed!" << endl << endl;
+        pfm->closeFile(fileHandle1);
+        pfm->closeFile(fileHandle2);
+        free(data);
+        return -1;
+    }
+    cout << "Both handles see all 30 pages!" << endl;
+
+    rc = pfm->closeFile(fileHandle1);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(fileHandle2);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Empty the buffer pool, so the count below comes from the file header
+    rc = BufferPoolManager::instance()->setCapacity(BufferPoolManager::instance()->getCapacity());
+    assert(rc == success && "Emptying the buffer pool should not fail.");
+
+    rc = pfm->openFile(fileName, fileHandle1);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned count = fileHandle1.getNumberOfPages();
+    assert(count == (unsigned)30 && "The count should be 30 at this moment.");
+
+    void *buffer = malloc(PAGE_SIZE);
+    rc = fileHandle1.readPage(29, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+
+    for(unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)data+i) = i % 30 + 32;
+    }
+    rc = memcmp(buffer, data, PAGE_SIZE);
+    assert(rc == success && "Checking the integrity of a page should not fail.");
+    cout << "The data in the last page is correct!" << endl;
+
+    // Close the file "test17"
+    rc = pfm->closeFile(fileHandle1);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(data);
+    free(buffer);
+
+    cout << "RBF Test Case 17 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test17");
+
+    RC rcmain = RBFTest_17(pfm);
+    return rcmain;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fills a page with a pattern that depends on its page number
+void fillPage(void *page, unsigned pageNum)
+{
+    for(unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)page+i) = (i + pageNum) % 95 + 32;
+    }
+    memcpy(page, &pageNum, sizeof(unsigned));
+}
+
+int RBFTest_18(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append Pages (a batch spanning two free-space map groups)
+    // 4. Append Page
+    // 5. Get Number Of Pages
+    // 6. Read Page (from disk, after the buffer pool has been emptied)
+    // 7. Close File
+    // 8. Destroy File
+    cout << endl << "***** In RBF Test Case 18 *****" << endl;
+
+    RC rc;
+    string fileName = "test18";
+
+    // Create the file named "test18"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    // Open the file "test18"
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // One page on its own, then a batch that runs into a second group, then one more page
+    unsigned batch = FSM_GROUP_SIZE + 10;
+    unsigned total = batch + 2;
+    char *pages = (char *) malloc((size_t) batch * PAGE_SIZE);
+
+    fillPage(pages, 0);
+    rc = fileHandle.appendPage(pages);
+    assert(rc == success && "Appending a page should not fail.");
+
+    for(unsigned j = 0; j < batch; j++)
+    {
+        fillPage(pages + (size_t) j * PAGE_SIZE, j + 1);
+    }
+    rc = fileHandle.appendPages(batch, pages);
+    assert(rc == success && "Appending pages should not fail.");
+
+    fillPage(pages, total - 1);
+    rc = fileHandle.appendPage(pages);
+    assert(rc == success && "Appending a page should not fail.");
+
+    unsigned count = fileHandle.getNumberOfPages();
+    assert(count == total && "The count should match the number of pages appended.");
+    cout << total << " Pages have been successfully appended!" << endl;
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Empty the buffer pool, so the pages below really come from the file
+    rc = BufferPoolManager::instance()->setCapacity(BufferPoolManager::instance()->getCapacity());
+    assert(rc == success && "Emptying the buffer pool should not fail.");
+
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    count = fileHandle.getNumberOfPages();
+    assert(count == total && "The count should survive closing the file.");
+
+    void *buffer = malloc(PAGE_SIZE);
+    void *expected = malloc(PAGE_SIZE);
+    for(unsigned j = 0; j < total; j++)
+    {
+        fillPage(expected, j);
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+
+        if(memcmp(buffer, expected, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << j << " is corrupted. Test Case 18 Failed!" << endl << endl;
+            pfm->closeFile(fileHandle);
+            free(pages);
+            free(buffer);
+            free(expected);
+            return -1;
+        }
+    }
+    cout << "The data in all " << total << " pages is correct!" << endl;
+
+    // Close the file "test18"
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(pages);
+    free(buffer);
+    free(expected);
+
+    cout << "RBF Test Case 18 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test18");
+
+    RC rcmain = RBFTest_18(pfm);
+    return rcmain;
+}
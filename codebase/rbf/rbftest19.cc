@@ -0,0 +1,143 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fills a page with a pattern that depends on its page number
+void fillPage(void *page, unsigned pageNum)
+{
+    for(unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)page+i) = (i + pageNum) % 95 + 32;
+    }
+    memcpy(page, &pageNum, sizeof(unsigned));
+}
+
+int RBFTest_19(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File (with deferred durability, so updates stay in the buffer pool)
+    // 3. Append Pages
+    // 4. Write Page
+    // 5. Read Pages (a range across two free-space map groups, and a scattered list)
+    // 6. Close File
+    // 7. Destroy File
+    cout << endl << "***** In RBF Test Case 19 *****" << endl;
+
+    RC rc;
+    string fileName = "test19";
+
+    // Create the file named "test19"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    FileOptions options;
+    options.durability = DurabilityDeferred;
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned total = FSM_GROUP_SIZE + 40;
+    char *pages = (char *) malloc((size_t) total * PAGE_SIZE);
+    for(unsigned j = 0; j < total; j++)
+    {
+        fillPage(pages + (size_t) j * PAGE_SIZE, j);
+    }
+    rc = fileHandle.appendPages(total, pages);
+    assert(rc == success && "Appending pages should not fail.");
+
+    // Update a page in the middle of the range read below; it is only in the buffer pool so far
+    PageNum updated = FSM_GROUP_SIZE - 3;
+    fillPage(pages + (size_t) updated * PAGE_SIZE, updated + 1000);
+    rc = fileHandle.writePage(updated, pages + (size_t) updated * PAGE_SIZE);
+    assert(rc == success && "Writing a page should not fail.");
+
+    // Read 32 pages across the end of the first group
+    unsigned count = 32;
+    PageNum start = FSM_GROUP_SIZE - 16;
+    char *buffer = (char *) malloc((size_t) count * PAGE_SIZE);
+    rc = fileHandle.readPages(start, count, buffer);
+    assert(rc == success && "Reading pages should not fail.");
+
+    if(memcmp(buffer, pages + (size_t) start * PAGE_SIZE, (size_t) count * PAGE_SIZE) != 0)
+    {
+        cout << "[FAIL] The range read returned the wrong data. Test Case 19 Failed!" << endl << endl;
+        pfm->closeFile(fileHandle);
+        free(pages);
+        free(buffer);
+        return -1;
+    }
+    cout << "The range read is correct!" << endl;
+
+    rc = fileHandle.readPages(total - 10, count, buffer);
+    assert(rc != success && "Reading pages past the end of the file should fail.");
+
+    // Read a scattered list: out of order, with neighbours, across both groups and with a repeat
+    vector<PageNum> pageNums;
+    pageNums.push_back(FSM_GROUP_SIZE + 5);
+    pageNums.push_back(3);
+    pageNums.push_back(4);
+    pageNums.push_back(updated);
+    pageNums.push_back(FSM_GROUP_SIZE - 1);
+    pageNums.push_back(FSM_GROUP_SIZE);
+    pageNums.push_back(2);
+    pageNums.push_back(3);
+    rc = fileHandle.readPages(pageNums, buffer);
+    assert(rc == success && "Reading pages should not fail.");
+
+    for(unsigned i = 0; i < pageNums.size(); i++)
+    {
+        if(memcmp(buffer + (size_t) i * PAGE_SIZE, pages + (size_t) pageNums[i] * PAGE_SIZE, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << pageNums[i] << " of the scattered read is wrong. Test Case 19 Failed!" << endl << endl;
+            pfm->closeFile(fileHandle);
+            free(pages);
+            free(buffer);
+            return -1;
+        }
+    }
+    cout << "The scattered read is correct!" << endl;
+
+    // Close the file "test19"
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(pages);
+    free(buffer);
+
+    cout << "RBF Test Case 19 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test19");
+
+    RC rcmain = RBFTest_19(pfm);
+    return rcmain;
+}
@@ -0,0 +1,159 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <map>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_20(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File (scans read ahead by default)
+    // 3. Insert Multiple Records
+    // 4. Scan (every record comes back intact)
+    // 5. Scan closed half way, with reads still in flight
+    // 6. Close Record-Based File
+    // 7. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 20 *****" << endl;
+
+    RC rc;
+    string fileName = "test20";
+
+    // Create a file named "test20"
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    // Open the file "test20"
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    assert(fileHandle.isReadAhead() && "Scans should read ahead by default.");
+
+    RID rid;
+    void *record = malloc(1000);
+    void *returnedData = malloc(1000);
+    int numRecords = 5000;
+
+    vector<Attribute> recordDescriptor;
+    createLargeRecordDescriptor(recordDescriptor);
+
+    // NULL field indicator
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    // Insert 5000 records into file, enough for several hundred pages.
+    // Smaller records may fill gaps on earlier pages, so remember where each one went.
+    map<pair<unsigned, unsigned>, int> recordAt;
+    for(int i = 0; i < numRecords; i++)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        prepareLargeRecord(recordDescriptor.size(), nullsIndicator, i, record, &size);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        recordAt[make_pair(rid.pageNum, rid.slotNum)] = i;
+    }
+    cout << numRecords << " records over " << fileHandle.getNumberOfPages() << " pages have been inserted!" << endl;
+
+    // Project every attribute, so the scan returns the records exactly as inserted
+    vector<string> attributeNames;
+    for(unsigned i = 0; i < recordDescriptor.size(); i++)
+    {
+        attributeNames.push_back(recordDescriptor[i].name);
+    }
+
+    RBFM_ScanIterator scanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+
+    int scanned = 0;
+    while(scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        int size = 0;
+        memset(record, 0, 1000);
+        map<pair<unsigned, unsigned>, int>::iterator it = recordAt.find(make_pair(rid.pageNum, rid.slotNum));
+        if(it != recordAt.end())
+        {
+            prepareLargeRecord(recordDescriptor.size(), nullsIndicator, it->second, record, &size);
+        }
+        if(it == recordAt.end() || memcmp(returnedData, record, size) != 0)
+        {
+            cout << "[FAIL] Record " << scanned << " of the scan is wrong. Test Case 20 Failed!" << endl << endl;
+            scanIterator.close();
+            rbfm->closeFile(fileHandle);
+            free(record);
+            free(returnedData);
+            free(nullsIndicator);
+            return -1;
+        }
+        scanned++;
+    }
+    scanIterator.close();
+
+    if(scanned != numRecords)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records. Test Case 20 Failed!" << endl << endl;
+        rbfm->closeFile(fileHandle);
+        free(record);
+        free(returnedData);
+        free(nullsIndicator);
+        return -1;
+    }
+    cout << "The scan returned all " << scanned << " records intact!" << endl;
+
+    // Stop a second scan early; the pages read ahead for it are simply dropped
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    for(int i = 0; i < 100; i++)
+    {
+        rc = scanIterator.getNextRecord(rid, returnedData);
+        assert(rc == success && "Getting the next record should not fail.");
+    }
+    rc = scanIterator.close();
+    assert(rc == success && "Closing the scan should not fail.");
+
+    // Close the file "test20"
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 20 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test20");
+
+    RC rcmain = RBFTest_20(rbfm);
+    return rcmain;
+}
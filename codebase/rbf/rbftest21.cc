@@ -0,0 +1,268 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "asyncio.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+// Fills a page with a pattern that depends on its page number and a version
+void fillPage(void *page, unsigned pageNum, unsigned version)
+{
+    for(unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)page+i) = (i + pageNum + version) % 95 + 32;
+    }
+    memcpy(page, &pageNum, sizeof(unsigned));
+}
+
+int asyncRoundTrip(PagedFileManager *pfm, const string &fileName, FileHandle &fileHandle, unsigned numPages, unsigned version)
+{
+    RC rc;
+    char *pages = (char *) malloc((size_t) numPages * PAGE_SIZE);
+    char *buffer = (char *) malloc((size_t) numPages * PAGE_SIZE);
+
+    // Read every page once, so the buffer pool holds copies the writes below make stale
+    for(unsigned j = 0; j < numPages; j++)
+    {
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+
+    // Rewrite the odd pages, in one batch
+    vector<PageNum> pageNums;
+    for(unsigned j = 1; j < numPages; j += 2)
+    {
+        fillPage(pages + (size_t) pageNums.size() * PAGE_SIZE, j, version);
+        pageNums.push_back(j);
+    }
+    vector<IOToken> tokens;
+    rc = fileHandle.writePagesAsync(pageNums, pages, tokens);
+    assert(rc == success && "Submitting writes should not fail.");
+    rc = fileHandle.waitIO(tokens);
+    assert(rc == success && "Writing pages should not fail.");
+
+    // Read every page back, in reverse order, polling rather than waiting
+    pageNums.clear();
+    for(unsigned j = numPages; j > 0; j--)
+    {
+        pageNums.push_back(j - 1);
+    }
+    rc = fileHandle.readPagesAsync(pageNums, buffer, tokens);
+    assert(rc == success && "Submitting reads should not fail.");
+
+    unsigned pending = tokens.size();
+    vector<bool> done(tokens.size(), false);
+    while(pending > 0)
+    {
+        for(unsigned i = 0; i < tokens.size(); i++)
+        {
+            if(done[i])
+                continue;
+            bool complete = false;
+            rc = fileHandle.pollIO(tokens[i], complete);
+            assert(rc == success && "Reading a page should not fail.");
+            if(complete)
+            {
+                done[i] = true;
+                pending--;
+            }
+        }
+    }
+
+    // A token is forgotten once collected
+    bool complete;
+    rc = fileHandle.pollIO(tokens[0], complete);
+    assert(rc != success && "Polling a collected token should fail.");
+
+    int result = 0;
+    void *expected = malloc(PAGE_SIZE);
+    for(unsigned i = 0; i < pageNums.size(); i++)
+    {
+        PageNum j = pageNums[i];
+        fillPage(expected, j, j % 2 == 1 ? version : 0);
+        if(memcmp(buffer + (size_t) i * PAGE_SIZE, expected, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << j << " read asynchronously is wrong." << endl;
+            result = -1;
+            break;
+        }
+    }
+
+    // Synchronous reads see the new pages too
+    for(unsigned j = 1; j < numPages && result == 0; j += 2)
+    {
+        fillPage(expected, j, version);
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        if(memcmp(buffer, expected, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << j << " read from the buffer pool is stale." << endl;
+            result = -1;
+        }
+    }
+
+    // A read issued before a write lands already sees it, and so do reads after
+    fillPage(expected, 1, version + 10);
+    IOToken token;
+    rc = fileHandle.writePageAsync(1, expected, token);
+    assert(rc == success && "Submitting a write should not fail.");
+    for(unsigned k = 0; k < 2 && result == 0; k++)
+    {
+        rc = fileHandle.readPage(1, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        if(memcmp(buffer, expected, PAGE_SIZE) != 0)
+        {
+            cout << "[FAIL] Page 1 read " << (k == 0 ? "during" : "after") << " its asynchronous write is stale." << endl;
+            result = -1;
+        }
+        if(k == 0)
+        {
+            rc = fileHandle.waitIO(token);
+            assert(rc == success && "Writing a page should not fail.");
+        }
+    }
+
+    // Pages written again while their asynchronous writes are in flight end up on disk as written last,
+    // which here puts back the pages as they were appended
+    tokens.clear();
+    for(unsigned j = 0; j < numPages && result == 0; j++)
+    {
+        fillPage(pages, j, version + 20);
+        fillPage(expected, j, 0);
+        rc = fileHandle.writePageAsync(j, pages, token);
+        assert(rc == success && "Submitting a write should not fail.");
+        tokens.push_back(token);
+        rc = fileHandle.writePage(j, expected);
+        assert(rc == success && "Writing a page should not fail.");
+    }
+    if(result == 0)
+    {
+        rc = fileHandle.waitIO(tokens);
+        assert(rc == success && "Writing pages should not fail.");
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+
+        // Asynchronous reads go to the disk rather than the pool
+        pageNums.clear();
+        for(unsigned j = 0; j < numPages; j++)
+        {
+            pageNums.push_back(j);
+        }
+        rc = fileHandle.readPagesAsync(pageNums, buffer, tokens);
+        assert(rc == success && "Submitting reads should not fail.");
+        rc = fileHandle.waitIO(tokens);
+        assert(rc == success && "Reading pages should not fail.");
+        for(unsigned j = 0; j < numPages; j++)
+        {
+            fillPage(expected, j, 0);
+            if(memcmp(buffer + (size_t) j * PAGE_SIZE, expected, PAGE_SIZE) != 0)
+            {
+                cout << "[FAIL] Page " << j << " on disk is its asynchronous write, not the one after it." << endl;
+                result = -1;
+                break;
+            }
+        }
+    }
+
+    free(pages);
+    free(buffer);
+    free(expected);
+    return result;
+}
+
+int RBFTest_21(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append Pages
+    // 4. Write Pages asynchronously, and wait for them
+    // 5. Read Pages asynchronously, and poll for them
+    // 6. Read Page (the buffer pool must not serve stale copies)
+    // 7. Write Page while an asynchronous write of it is in flight
+    // 8. Close File
+    // 9. Destroy File
+    cout << endl << "***** In RBF Test Case 21 *****" << endl;
+
+    RC rc;
+    string fileName = "test21";
+
+    // Create the file named "test21"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned numPages = 300;
+    char *pages = (char *) malloc((size_t) numPages * PAGE_SIZE);
+    for(unsigned j = 0; j < numPages; j++)
+    {
+        fillPage(pages + (size_t) j * PAGE_SIZE, j, 0);
+    }
+    rc = fileHandle.appendPages(numPages, pages);
+    assert(rc == success && "Appending pages should not fail.");
+    free(pages);
+
+    // Run the same round trip on every backend there is here
+    AsyncIOManager *aio = AsyncIOManager::instance();
+    AsyncBackend backends[] = { AsyncIoUring, AsyncThreadPool };
+    for(unsigned b = 0; b < 2; b++)
+    {
+        string name = backends[b] == AsyncIoUring ? "io_uring" : "the thread pool";
+        if(aio->setBackend(backends[b]) != success)
+        {
+            cout << "No " << name << " here." << endl;
+            continue;
+        }
+
+        if(asyncRoundTrip(pfm, fileName, fileHandle, numPages, b + 1) != 0)
+        {
+            cout << "[FAIL] Asynchronous I/O through " << name << " failed. Test Case 21 Failed!" << endl << endl;
+            pfm->closeFile(fileHandle);
+            return -1;
+        }
+        cout << "Asynchronous I/O through " << name << " is correct!" << endl;
+    }
+
+    // Close the file "test21"
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 21 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test21");
+
+    RC rcmain = RBFTest_21(pfm);
+    return rcmain;
+}
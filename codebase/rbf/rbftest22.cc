@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_22(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File with background write-back
+    // 3. Insert Multiple Records (many to a page, so the page writes coalesce)
+    // 4. Close Record-Based File
+    // 5. Read Multiple Records (from disk, after the buffer pool has been emptied)
+    // 6. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 22 *****" << endl;
+
+    RC rc;
+    string fileName = "test22";
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+
+    // Create a file named "test22"
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    FileOptions options;
+    options.durability = DurabilityWriteBack;
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int numRecords = 3000;
+    vector<RID> rids;
+    uint64_t writtenBefore = bpm->getPagesWritten();
+
+    for(int i = 0; i < numRecords; i++)
+    {
+        RID rid;
+        int recordSize = 0;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1 + i, i * 10, record, &recordSize);
+
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+
+    // The flusher writes the pages in the background, with no sync from us
+    for(int i = 0; i < 40 && bpm->getPagesWritten() == writtenBefore; i++)
+    {
+        usleep(50 * 1000);
+    }
+    assert(bpm->getPagesWritten() > writtenBefore && "The flusher should have written pages back by now.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    unsigned readPageCount, writePageCount, appendPageCount;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    uint64_t written = bpm->getPagesWritten() - writtenBefore;
+    cout << numRecords << " inserts: " << writePageCount << " page writes, " << appendPageCount << " appends, "
+         << written << " pages written to disk" << endl;
+
+    if(written * 10 > writePageCount + appendPageCount)
+    {
+        cout << "[FAIL] The page writes weren't coalesced. Test Case 22 Failed!" << endl << endl;
+        free(record);
+        free(returnedData);
+        free(nullsIndicator);
+        return -1;
+    }
+
+    // Empty the buffer pool, so the records below really come from the file
+    rc = bpm->setCapacity(bpm->getCapacity());
+    assert(rc == success && "Emptying the buffer pool should not fail.");
+
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    for(int i = 0; i < numRecords; i++)
+    {
+        int recordSize = 0;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1 + i, i * 10, record, &recordSize);
+
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+
+        if(memcmp(returnedData, record, recordSize) != 0)
+        {
+            cout << "[FAIL] Record " << i << " is wrong on disk. Test Case 22 Failed!" << endl << endl;
+            rbfm->closeFile(fileHandle);
+            free(record);
+            free(returnedData);
+            free(nullsIndicator);
+            return -1;
+        }
+    }
+    cout << "All " << numRecords << " records are correct on disk!" << endl;
+
+    // Close the file "test22"
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    cout << "RBF Test Case 22 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test22");
+
+    RC rcmain = RBFTest_22(rbfm);
+    return rcmain;
+}
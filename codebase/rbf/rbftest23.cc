@@ -0,0 +1,158 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned poolFrames = 64;
+const unsigned hotPages = 20;
+const unsigned scanStart = 100;
+const unsigned numPages = 600;
+
+// Fills a page with a pattern that depends on its page number
+void fillPage(void *page, unsigned pageNum)
+{
+    for(unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((char *)page+i) = (i + pageNum) % 95 + 32;
+    }
+}
+
+// Uses the hot pages twice, scans the rest of the file once, and returns how many
+// of the hot pages had to be read from disk again afterwards
+int hotPagesLost(FileHandle &fileHandle, ReplacementPolicy policy, AccessPattern scanPattern)
+{
+    RC rc;
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    bpm->setPolicy(policy);
+    rc = bpm->setCapacity(poolFrames);
+    assert(rc == success && "Emptying the buffer pool should not fail.");
+
+    void *buffer = malloc(PAGE_SIZE);
+    void *expected = malloc(PAGE_SIZE);
+    for(unsigned round = 0; round < 2; round++)
+    {
+        for(unsigned j = 0; j < hotPages; j++)
+        {
+            rc = fileHandle.readPage(j, buffer);
+            assert(rc == success && "Reading a page should not fail.");
+        }
+    }
+
+    fileHandle.setAccessPattern(scanPattern);
+    for(unsigned j = scanStart; j < numPages; j++)
+    {
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        fillPage(expected, j);
+        assert(memcmp(buffer, expected, PAGE_SIZE) == 0 && "A scanned page is wrong.");
+    }
+    fileHandle.setAccessPattern(AccessNormal);
+
+    uint64_t readBefore = bpm->getPagesRead();
+    for(unsigned j = 0; j < hotPages; j++)
+    {
+        rc = fileHandle.readPage(j, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        fillPage(expected, j);
+        assert(memcmp(buffer, expected, PAGE_SIZE) == 0 && "A hot page is wrong.");
+    }
+
+    free(buffer);
+    free(expected);
+    return bpm->getPagesRead() - readBefore;
+}
+
+int RBFTest_23(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append Pages
+    // 4. Read Page, under every replacement policy, with and without the sequential hint
+    // 5. Close File
+    // 6. Destroy File
+    cout << endl << "***** In RBF Test Case 23 *****" << endl;
+
+    RC rc;
+    string fileName = "test23";
+
+    // Create the file named "test23"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    char *pages = (char *) malloc((size_t) numPages * PAGE_SIZE);
+    for(unsigned j = 0; j < numPages; j++)
+    {
+        fillPage(pages + (size_t) j * PAGE_SIZE, j);
+    }
+    rc = fileHandle.appendPages(numPages, pages);
+    assert(rc == success && "Appending pages should not fail.");
+    free(pages);
+
+    // CLOCK alone has nothing to tell the hot pages from the scanned ones
+    int lost = hotPagesLost(fileHandle, ReplaceClock, AccessNormal);
+    cout << "CLOCK, plain scan: " << lost << " of " << hotPages << " hot pages read again" << endl;
+
+    struct { ReplacementPolicy policy; AccessPattern pattern; const char *name; } cases[] = {
+        { Replace2Q, AccessNormal, "2Q, plain scan" },
+        { ReplaceLRUK, AccessNormal, "LRU-2, plain scan" },
+        { ReplaceClock, AccessSequential, "CLOCK, sequential scan" },
+        { Replace2Q, AccessSequential, "2Q, sequential scan" },
+    };
+    for(unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        lost = hotPagesLost(fileHandle, cases[i].policy, cases[i].pattern);
+        cout << cases[i].name << ": " << lost << " of " << hotPages << " hot pages read again" << endl;
+        if(lost != 0)
+        {
+            cout << "[FAIL] The scan evicted hot pages. Test Case 23 Failed!" << endl << endl;
+            pfm->closeFile(fileHandle);
+            return -1;
+        }
+    }
+    BufferPoolManager::instance()->setPolicy(ReplaceClock);
+
+    // Close the file "test23"
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 23 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test23");
+
+    RC rcmain = RBFTest_23(pfm);
+    return rcmain;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+int RBFTest_24(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File
+    // 3. Append Page, filled in place through a guard
+    // 4. Read Page in place through a guard
+    // 5. Write Page in place through a guard
+    // 6. Close File, and read the pages back from disk
+    // 7. Destroy File
+    cout << endl << "***** In RBF Test Case 24 *****" << endl;
+
+    RC rc;
+    string fileName = "test24";
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+
+    // Create the file named "test24"
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    rc = createFileShouldSucceed(fileName);
+    assert(rc == success && "Creating the file failed.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // Append pages, writing each straight into its buffer frame
+    unsigned numPages = 10;
+    for(unsigned j = 0; j < numPages; j++)
+    {
+        WritePageGuard page;
+        rc = fileHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+        assert(page.getPageNum() == j && "An appended page should come last.");
+        assert(fileHandle.getNumberOfPages() == j + 1 && "The page should be counted right away.");
+
+        unsigned *words = (unsigned *) page.mutableData();
+        for(unsigned i = 0; i < PAGE_SIZE / sizeof(unsigned); i++)
+        {
+            words[i] = j * 1000 + i;
+        }
+        rc = page.release();
+        assert(rc == success && "Committing an appended page should not fail.");
+    }
+
+    // A guard only counts as a write once its page has been handed out for changing
+    unsigned readPageCount, writePageCount, appendPageCount;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    {
+        WritePageGuard page;
+        rc = fileHandle.pinPage(3, page);
+        assert(rc == success && "Pinning a page should not fail.");
+        assert(*page.as<unsigned>(8 * sizeof(unsigned)) == 3008 && "The page should be read in place.");
+    }
+    unsigned writesBefore = writePageCount;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    assert(writePageCount == writesBefore && "An unchanged page shouldn't be written.");
+
+    // Change a page in place; a moved guard keeps the pin, and releases it once
+    {
+        WritePageGuard page;
+        rc = fileHandle.pinPage(5, page);
+        assert(rc == success && "Pinning a page should not fail.");
+        WritePageGuard moved(std::move(page));
+        assert(!page.isPinned() && moved.isPinned() && "The pin should move with the guard.");
+        ((unsigned *) moved.mutableData())[0] = 424242;
+    }
+
+    // Guards going out of scope must leave nothing pinned, or the pool couldn't be emptied
+    rc = bpm->setCapacity(bpm->getCapacity());
+    assert(rc == success && "Every guard should have unpinned its page.");
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Read every page back from disk, in place
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfPages() == numPages && "The appended pages should be in the file.");
+
+    int result = 0;
+    for(unsigned j = 0; j < numPages && result == 0; j++)
+    {
+        ReadPageGuard page;
+        rc = fileHandle.pinPage(j, page);
+        assert(rc == success && "Pinning a page should not fail.");
+        const unsigned *words = page.as<unsigned>();
+        for(unsigned i = 0; i < PAGE_SIZE / sizeof(unsigned); i++)
+        {
+            unsigned expected = (j == 5 && i == 0) ? 424242 : j * 1000 + i;
+            if(words[i] != expected)
+            {
+                cout << "[FAIL] Page " << j << " is wrong on disk. Test Case 24 Failed!" << endl << endl;
+                result = -1;
+                break;
+            }
+        }
+    }
+    if(result != 0)
+    {
+        pfm->closeFile(fileHandle);
+        return result;
+    }
+    cout << "Pages written and read in place are correct!" << endl;
+
+    // Pinning a page past the end fails and leaves the guard empty
+    ReadPageGuard missing;
+    rc = fileHandle.pinPage(numPages, missing);
+    assert(rc != success && "Pinning a page that doesn't exist should fail.");
+    assert(!missing.isPinned() && "A failed pin should leave the guard empty.");
+
+    // Close the file "test24"
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Destroy the file
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 24 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    remove("test24");
+
+    RC rcmain = RBFTest_24(pfm);
+    return rcmain;
+}
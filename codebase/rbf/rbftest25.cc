@@ -0,0 +1,284 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numThreads = 4;
+const int recordsPerThread = 1500;
+const unsigned smallPoolFrames = 8;
+const string fileName = "test25";
+const string destroyedFileName = "test25_destroyed";
+
+atomic<int> failures(0);
+
+// Each thread opens its own handle on the file, inserts its records and reads them all back
+void insertAndRead(RecordBasedFileManager *rbfm, int thread, vector<RID> &rids)
+{
+    FileHandle fileHandle;
+    if (rbfm->openFile(fileName, fileHandle))
+    {
+        failures++;
+        return;
+    }
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+
+    for (int i = 0; i < recordsPerThread; i++)
+    {
+        int key = thread * recordsPerThread + i;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", key, 170.1, key * 10, record, &recordSize);
+        if (rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]))
+            failures++;
+    }
+
+    for (int i = 0; i < recordsPerThread; i++)
+    {
+        int key = thread * recordsPerThread + i;
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", key, 170.1, key * 10, record, &recordSize);
+        if (rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData)
+                || memcmp(record, returnedData, recordSize) != 0)
+            failures++;
+    }
+
+    free(nullsIndicator);
+    free(record);
+    free(returnedData);
+    if (rbfm->closeFile(fileHandle))
+        failures++;
+}
+
+// Scans the whole file on its own handle, checking every record it returns
+void scanAll(RecordBasedFileManager *rbfm, int &scanned)
+{
+    scanned = 0;
+    FileHandle fileHandle;
+    if (rbfm->openFile(fileName, fileHandle))
+    {
+        failures++;
+        return;
+    }
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Salary");
+
+    RBFM_ScanIterator scanIterator;
+    if (rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator))
+    {
+        failures++;
+        rbfm->closeFile(fileHandle);
+        return;
+    }
+
+    RID rid;
+    char returnedData[100];
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        int age, salary;
+        memcpy(&age, returnedData + 1, sizeof(int));
+        memcpy(&salary, returnedData + 1 + sizeof(int), sizeof(int));
+        if (salary != age * 10)
+            failures++;
+        scanned++;
+    }
+    scanIterator.close();
+
+    if (rbfm->closeFile(fileHandle))
+        failures++;
+}
+
+int RBFTest_25(RecordBasedFileManager *rbfm) {
+    // Functions tested
+    // 1. Create Record-Based File
+    // 2. Open Record-Based File, once per thread
+    // 3. Insert and Read Records, from several threads at once
+    // 4. Scan, from several threads at once
+    // 5. Insert and Read Records from several threads, with a pool a few frames large
+    // 6. Destroy Record-Based File while one of its pages is pinned
+    // 7. Close Record-Based File
+    // 8. Destroy Record-Based File
+    cout << endl << "***** In RBF Test Case 25 *****" << endl;
+
+    RC rc;
+
+    // Create a file named "test25"
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+
+    // Every thread inserts and reads its own records, all on the same pages
+    vector<vector<RID> > rids(numThreads, vector<RID>(recordsPerThread));
+    vector<thread> threads;
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(thread(insertAndRead, rbfm, t, ref(rids[t])));
+    }
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads[t].join();
+    }
+    threads.clear();
+
+    if (failures != 0)
+    {
+        cout << "[FAIL] " << failures << " concurrent inserts or reads went wrong. Test Case 25 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Records inserted and read by " << numThreads << " threads are correct!" << endl;
+
+    // No two records may have been given the same slot
+    for (int t = 0; t < numThreads; t++)
+    {
+        for (int u = 0; u <= t; u++)
+        {
+            for (int i = 0; i < recordsPerThread; i++)
+            {
+                for (int j = (u == t ? i + 1 : 0); j < recordsPerThread; j++)
+                {
+                    if (rids[t][i].pageNum == rids[u][j].pageNum && rids[t][i].slotNum == rids[u][j].slotNum)
+                    {
+                        cout << "[FAIL] Two records share a slot. Test Case 25 Failed!" << endl << endl;
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    // Scans run next to each other, each through its own handle
+    int scanned[numThreads];
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(thread(scanAll, rbfm, ref(scanned[t])));
+    }
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads[t].join();
+    }
+
+    if (failures != 0)
+    {
+        cout << "[FAIL] Concurrent scans returned wrong records. Test Case 25 Failed!" << endl << endl;
+        return -1;
+    }
+    for (int t = 0; t < numThreads; t++)
+    {
+        if (scanned[t] != numThreads * recordsPerThread)
+        {
+            cout << "[FAIL] A scan returned " << scanned[t] << " records. Test Case 25 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    cout << "Concurrent scans returned all " << numThreads * recordsPerThread << " records!" << endl;
+
+    // With only a few frames, the threads miss on the same pages and evict each other's dirty pages all the time
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    unsigned capacity = bpm->getCapacity();
+    rc = bpm->setCapacity(smallPoolFrames);
+    assert(rc == success && "Resizing the pool should not fail.");
+    threads.clear();
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads.push_back(thread(insertAndRead, rbfm, t, ref(rids[t])));
+    }
+    for (int t = 0; t < numThreads; t++)
+    {
+        threads[t].join();
+    }
+    rc = bpm->setCapacity(capacity);
+    assert(rc == success && "Resizing the pool should not fail.");
+    if (failures != 0)
+    {
+        cout << "[FAIL] " << failures << " inserts or reads went wrong with a small pool. Test Case 25 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Records inserted and read by " << numThreads << " threads through " << smallPoolFrames << " frames are correct!" << endl;
+
+    // A page still pinned when its file is destroyed keeps its frame until it is unpinned,
+    // and the frame is of use again afterwards
+    rc = bpm->setCapacity(smallPoolFrames);
+    assert(rc == success && "Resizing the pool should not fail.");
+    rc = rbfm->createFile(destroyedFileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileHandle destroyedHandle;
+    rc = rbfm->openFile(destroyedFileName, destroyedHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    WritePageGuard guard;
+    rc = destroyedHandle.appendPage(guard);
+    assert(rc == success && "Appending a page should not fail.");
+    memset(guard.mutableData(), 'x', PAGE_SIZE);
+    rc = rbfm->destroyFile(destroyedFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    guard.release();
+    rbfm->closeFile(destroyedHandle);
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    char page[PAGE_SIZE];
+    for (unsigned j = 0; j < fileHandle.getNumberOfPages() && j < 2 * smallPoolFrames; j++)
+    {
+        if (fileHandle.readPage(j, page))
+            failures++;
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = bpm->setCapacity(capacity);
+    assert(rc == success && "Resizing the pool should not fail.");
+    if (failures != 0)
+    {
+        cout << "[FAIL] Pages can't be read after a file was destroyed under a pinned page. Test Case 25 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Destroying a file with a page pinned leaves the pool working!" << endl;
+
+    // Destroy the file
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 25 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove("test25");
+    remove("test25_destroyed");
+
+    RC rcmain = RBFTest_25(rbfm);
+    return rcmain;
+}
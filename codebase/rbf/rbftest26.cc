@@ -0,0 +1,205 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <dirent.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned numFiles = 4;
+
+// Number of descriptors this process has open
+unsigned openDescriptors()
+{
+    unsigned count = 0;
+    DIR *dir = opendir("/proc/self/fd");
+    if (dir == NULL)
+        return 0;
+    while (readdir(dir) != NULL)
+        count++;
+    closedir(dir);
+    return count;
+}
+
+string testFileName(unsigned i)
+{
+    return "test26_" + to_string(i);
+}
+
+int RBFTest_26(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File
+    // 2. Open File, many times over, and with several handles at once
+    // 3. Append Page, Read Page, through handles sharing one descriptor
+    // 4. Close File, within and past the open-file limit
+    // 5. Destroy File, while it is idle in the open-file table
+    cout << endl << "***** In RBF Test Case 26 *****" << endl;
+
+    RC rc;
+    for (unsigned i = 0; i < numFiles; i++)
+    {
+        string fileName = testFileName(i);
+        rc = pfm->createFile(fileName);
+        assert(rc == success && "Creating the file should not fail.");
+
+        rc = createFileShouldSucceed(fileName);
+        assert(rc == success && "Creating the file failed.");
+    }
+    assert(pfm->getOpenFileCount() == 0 && "No file has been opened yet.");
+
+    // Opening a file again and again keeps the one descriptor
+    string fileName = testFileName(0);
+    void *data = malloc(PAGE_SIZE);
+    void *buffer = malloc(PAGE_SIZE);
+    memset(data, 'a', PAGE_SIZE);
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.appendPage(data);
+    assert(rc == success && "Appending a page should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    unsigned descriptors = openDescriptors();
+    for (unsigned j = 0; j < 1000; j++)
+    {
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        assert(fileHandle.getNumberOfPages() == 1 && "The page count should be kept while the file is idle.");
+        rc = fileHandle.readPage(0, buffer);
+        assert(rc == success && "Reading a page should not fail.");
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+    if (openDescriptors() != descriptors || pfm->getOpenFileCount() != 1)
+    {
+        cout << "[FAIL] Opening an idle file again opened another descriptor. Test Case 26 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "An idle file is opened again without a new descriptor!" << endl;
+
+    // Handles open at the same time share the descriptor too, and see each other's pages
+    FileHandle handles[3];
+    for (unsigned j = 0; j < 3; j++)
+    {
+        rc = pfm->openFile(fileName, handles[j]);
+        assert(rc == success && "Opening the file should not fail.");
+    }
+    assert(openDescriptors() == descriptors && "Handles on one file should share its descriptor.");
+    memset(data, 'b', PAGE_SIZE);
+    rc = handles[0].writePage(0, data);
+    assert(rc == success && "Writing a page should not fail.");
+    rc = handles[2].readPage(0, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    assert(memcmp(data, buffer, PAGE_SIZE) == 0 && "A page written through one handle should be read through another.");
+    for (unsigned j = 0; j < 3; j++)
+    {
+        rc = pfm->closeFile(handles[j]);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    // Past the limit, idle files are closed, least recently used first.
+    // Files in use stay open whatever the limit.
+    pfm->setOpenFileLimit(2);
+    FileHandle inUse[numFiles];
+    for (unsigned i = 0; i < numFiles; i++)
+    {
+        rc = pfm->openFile(testFileName(i), inUse[i]);
+        assert(rc == success && "Opening the file should not fail.");
+    }
+    assert(pfm->getOpenFileCount() == numFiles && "Files in use should never be closed.");
+    for (unsigned i = 0; i < numFiles; i++)
+    {
+        rc = pfm->closeFile(inUse[i]);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+    if (pfm->getOpenFileCount() != 2)
+    {
+        cout << "[FAIL] " << pfm->getOpenFileCount() << " files are open with a limit of 2. Test Case 26 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // The two files used last are the ones still open. Opening another closes the one of them used least recently.
+    descriptors = openDescriptors();
+    rc = pfm->openFile(testFileName(numFiles - 1), fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(openDescriptors() == descriptors && "A file used last should still be open.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm->openFile(testFileName(0), fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(openDescriptors() == descriptors && "Opening a closed file should close an idle one.");
+    rc = fileHandle.readPage(0, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    assert(memcmp(data, buffer, PAGE_SIZE) == 0 && "A file opened again should read what was written before.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    assert(pfm->getOpenFileCount() == 2 && "Closing should keep the table within its limit.");
+
+    rc = pfm->openFile(testFileName(numFiles - 1), fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    if (openDescriptors() != descriptors)
+    {
+        cout << "[FAIL] The file used most recently was closed. Test Case 26 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    cout << "Idle files are closed least recently used first!" << endl;
+    pfm->setOpenFileLimit(PFM_DEFAULT_OPEN_FILES);
+
+    // Destroying an idle file takes it out of the table; a new file by the same name starts empty
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfPages() == 0 && "A file created again should be empty.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    free(data);
+    free(buffer);
+
+    // Destroy the files
+    for (unsigned i = 0; i < numFiles; i++)
+    {
+        string name = testFileName(i);
+        rc = pfm->destroyFile(name);
+        assert(rc == success && "Destroying the file should not fail.");
+
+        rc = destroyFileShouldSucceed(name);
+        assert(rc == success  && "Destroying the file should not fail.");
+    }
+    assert(pfm->getOpenFileCount() == 0 && "Destroyed files should have left the table.");
+
+    cout << "RBF Test Case 26 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    for (unsigned i = 0; i < numFiles; i++)
+    {
+        remove(testFileName(i).c_str());
+    }
+
+    RC rcmain = RBFTest_26(pfm);
+    return rcmain;
+}
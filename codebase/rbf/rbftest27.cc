@@ -0,0 +1,283 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned numSizes = 3;
+const unsigned pageSizes[numSizes] = { PAGE_SIZE, 16384, PFM_MAX_PAGE_SIZE };
+const unsigned numPages = 20;
+const int numRecords = 2000;
+
+string testFileName(unsigned i)
+{
+    return "test27_" + to_string(pageSizes[i]);
+}
+
+// Fills a page with a pattern unique to the page and its size
+void fillPage(void *data, unsigned pageSize, unsigned pageNum)
+{
+    for (unsigned i = 0; i < pageSize; i++)
+    {
+        *((unsigned char *) data + i) = (i + pageNum * 7 + pageSize) % 251;
+    }
+}
+
+int RBFTest_27(PagedFileManager *pfm, RecordBasedFileManager *rbfm, BufferPoolManager *bpm)
+{
+    // Functions Tested:
+    // 1. Create File, with each supported page size and with a bad one
+    // 2. Open File, reporting the page size it was created with
+    // 3. Append Page, Read Page, in pages of each size
+    // 4. Pin Page, with files of different page sizes sharing the pool
+    // 5. Insert and Read Records, Scan, in a file of 64 KB pages
+    cout << endl << "***** In RBF Test Case 27 *****" << endl;
+
+    RC rc;
+    rc = pfm->createFile("test27_bad", 3000);
+    assert(rc == PFM_BAD_PAGE_SIZE && "A page size that is not a power of two should be refused.");
+    rc = pfm->createFile("test27_bad", PFM_MAX_PAGE_SIZE * 2);
+    assert(rc == PFM_BAD_PAGE_SIZE && "A page size past the largest should be refused.");
+
+    void *data = malloc(PFM_MAX_PAGE_SIZE);
+    void *buffer = malloc(PFM_MAX_PAGE_SIZE);
+
+    // Every file reads back the pages written to it, in its own page size
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        string fileName = testFileName(i);
+        rc = pfm->createFile(fileName, pageSizes[i]);
+        assert(rc == success && "Creating the file should not fail.");
+
+        rc = createFileShouldSucceed(fileName);
+        assert(rc == success && "Creating the file failed.");
+
+        FileHandle fileHandle;
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        assert(fileHandle.getPageSize() == pageSizes[i] && "The file should have the page size it was created with.");
+
+        for (unsigned j = 0; j < numPages; j++)
+        {
+            fillPage(data, pageSizes[i], j);
+            rc = fileHandle.appendPage(data);
+            assert(rc == success && "Appending a page should not fail.");
+        }
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    // Opening the files again, from a table without them, reads the page size from their headers
+    pfm->setOpenFileLimit(0);
+    pfm->setOpenFileLimit(PFM_DEFAULT_OPEN_FILES);
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        FileHandle fileHandle;
+        rc = pfm->openFile(testFileName(i), fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        if (fileHandle.getPageSize() != pageSizes[i] || fileHandle.getNumberOfPages() != numPages)
+        {
+            cout << "[FAIL] A file of " << pageSizes[i] << " byte pages opened with " << fileHandle.getPageSize()
+                 << " byte pages and " << fileHandle.getNumberOfPages() << " pages. Test Case 27 Failed!" << endl << endl;
+            return -1;
+        }
+        for (unsigned j = 0; j < numPages; j++)
+        {
+            fillPage(data, pageSizes[i], j);
+            rc = fileHandle.readPage(j, buffer);
+            assert(rc == success && "Reading a page should not fail.");
+            if (memcmp(data, buffer, pageSizes[i]) != 0)
+            {
+                cout << "[FAIL] Page " << j << " of a file of " << pageSizes[i] << " byte pages was read wrong. Test Case 27 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+    cout << "Files of " << PAGE_SIZE << ", 16384 and " << PFM_MAX_PAGE_SIZE << " byte pages keep their pages!" << endl;
+
+    // A small pool takes pages of every size in turn, frames moving from one file to another
+    unsigned capacity = bpm->getCapacity();
+    rc = bpm->setCapacity(2);
+    assert(rc == success && "Resizing the pool should not fail.");
+
+    FileHandle handles[numSizes];
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        rc = pfm->openFile(testFileName(i), handles[i]);
+        assert(rc == success && "Opening the file should not fail.");
+    }
+    for (unsigned j = 0; j < numPages; j++)
+    {
+        for (unsigned i = 0; i < numSizes; i++)
+        {
+            WritePageGuard page;
+            rc = handles[i].pinPage(j, page);
+            assert(rc == success && "Pinning a page should not fail.");
+            fillPage(data, pageSizes[i], j);
+            if (memcmp(data, page.data(), pageSizes[i]) != 0)
+            {
+                cout << "[FAIL] Page " << j << " of " << pageSizes[i] << " bytes was pinned wrong. Test Case 27 Failed!" << endl << endl;
+                return -1;
+            }
+            fillPage(page.mutableData(), pageSizes[i], j + numPages);
+        }
+    }
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        rc = pfm->closeFile(handles[i]);
+        assert(rc == success && "Closing the file should not fail.");
+
+        FileHandle fileHandle;
+        rc = pfm->openFile(testFileName(i), fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        for (unsigned j = 0; j < numPages; j++)
+        {
+            fillPage(data, pageSizes[i], j + numPages);
+            rc = fileHandle.readPage(j, buffer);
+            assert(rc == success && "Reading a page should not fail.");
+            if (memcmp(data, buffer, pageSizes[i]) != 0)
+            {
+                cout << "[FAIL] Page " << j << " of " << pageSizes[i] << " bytes was written back wrong. Test Case 27 Failed!" << endl << endl;
+                return -1;
+            }
+        }
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+    rc = bpm->setCapacity(capacity);
+    assert(rc == success && "Resizing the pool should not fail.");
+    cout << "Pages of every size share the buffer pool!" << endl;
+
+    free(data);
+    free(buffer);
+
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        string fileName = testFileName(i);
+        rc = pfm->destroyFile(fileName);
+        assert(rc == success && "Destroying the file should not fail.");
+
+        rc = destroyFileShouldSucceed(fileName);
+        assert(rc == success  && "Destroying the file should not fail.");
+    }
+
+    // Records in a file of 64 KB pages, with free space beyond what 16 bits can count
+    string fileName = "test27_records";
+    rc = rbfm->createFile(fileName, PFM_MAX_PAGE_SIZE);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+    vector<RID> rids(numRecords);
+
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1, i * 10, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    if (fileHandle.getNumberOfPages() * PFM_MAX_PAGE_SIZE > (unsigned) numRecords * 100 * 2)
+    {
+        cout << "[FAIL] " << numRecords << " records took " << fileHandle.getNumberOfPages() << " pages of 64 KB. Test Case 27 Failed!" << endl << endl;
+        return -1;
+    }
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1, i * 10, record, &recordSize);
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        if (memcmp(record, returnedData, recordSize) != 0)
+        {
+            cout << "[FAIL] Record " << i << " was read wrong from 64 KB pages. Test Case 27 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    attributeNames.push_back("Salary");
+    RBFM_ScanIterator scanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+
+    RID rid;
+    int scanned = 0;
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        int age, salary;
+        memcpy(&age, (char *) returnedData + 1, sizeof(int));
+        memcpy(&salary, (char *) returnedData + 1 + sizeof(int), sizeof(int));
+        if (salary != age * 10)
+        {
+            cout << "[FAIL] The scan returned a wrong record. Test Case 27 Failed!" << endl << endl;
+            return -1;
+        }
+        scanned++;
+    }
+    scanIterator.close();
+    if (scanned != numRecords)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records. Test Case 27 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << numRecords << " records are kept in pages of 64 KB!" << endl;
+
+    free(nullsIndicator);
+    free(record);
+    free(returnedData);
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 27 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager, buffer pool and record-based file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        remove(testFileName(i).c_str());
+    }
+    remove("test27_bad");
+    remove("test27_records");
+
+    RC rcmain = RBFTest_27(pfm, rbfm, bpm);
+    return rcmain;
+}
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned numSizes = 2;
+const unsigned pageSizes[numSizes] = { PAGE_SIZE, PFM_MAX_PAGE_SIZE };
+const off_t fileBytes = (off_t) 6 << 30;
+const uint64_t fourGigabytes = (uint64_t) 4 << 30;
+
+string testFileName(unsigned i)
+{
+    return "test28_" + to_string(pageSizes[i]);
+}
+
+// Fills a page with a pattern unique to the page
+void fillPage(void *data, unsigned pageSize, PageNum pageNum)
+{
+    for (unsigned i = 0; i < pageSize / sizeof(unsigned); i++)
+    {
+        ((unsigned *) data)[i] = pageNum * 31 + i;
+    }
+}
+
+// Drops every idle file from the open-file table, so the next open reads the file from disk
+void forgetIdleFiles(PagedFileManager *pfm)
+{
+    pfm->setOpenFileLimit(0);
+    pfm->setOpenFileLimit(PFM_DEFAULT_OPEN_FILES);
+}
+
+int checkPage(FileHandle &fileHandle, PageNum pageNum, bool hole, void *data, void *buffer)
+{
+    unsigned pageSize = fileHandle.getPageSize();
+    if (hole)
+        memset(data, 0, pageSize);
+    else
+        fillPage(data, pageSize, pageNum);
+    RC rc = fileHandle.readPage(pageNum, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    if (memcmp(data, buffer, pageSize) != 0)
+    {
+        cout << "[FAIL] Page " << pageNum << " of " << pageSize << " bytes was read wrong. Test Case 28 Failed!" << endl << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int RBFTest_28(PagedFileManager *pfm)
+{
+    // Functions Tested:
+    // 1. Create File, and grow it sparsely past 4 GB
+    // 2. Open File, counting the pages of a large file
+    // 3. Read Page, Write Page, Append Page, at page numbers past 4 GB of data
+    // 4. Set and Find Free Space, in a group far into the file
+    cout << endl << "***** In RBF Test Case 28 *****" << endl;
+
+    RC rc;
+    void *data = malloc(PFM_MAX_PAGE_SIZE);
+    void *buffer = malloc(PFM_MAX_PAGE_SIZE);
+
+    for (unsigned s = 0; s < numSizes; s++)
+    {
+        string fileName = testFileName(s);
+        unsigned pageSize = pageSizes[s];
+        rc = pfm->createFile(fileName, pageSize);
+        assert(rc == success && "Creating the file should not fail.");
+
+        rc = createFileShouldSucceed(fileName);
+        assert(rc == success && "Creating the file failed.");
+
+        FileHandle fileHandle;
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        assert(fileHandle.getMaxNumberOfPages() >= 4000000000u && "A file should have room for billions of pages.");
+        fillPage(data, pageSize, 0);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+
+        // The pages in between are holes, which cost no disk space and read as zeros
+        forgetIdleFiles(pfm);
+        rc = truncate(fileName.c_str(), fileBytes);
+        assert(rc == success && "Growing the file should not fail.");
+
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        PageNum numPages = fileHandle.getNumberOfPages();
+        if ((uint64_t) numPages * pageSize <= fourGigabytes || (uint64_t) numPages * pageSize >= (uint64_t) fileBytes)
+        {
+            cout << "[FAIL] A file of " << fileBytes << " bytes opened with " << numPages << " pages of "
+                 << pageSize << " bytes. Test Case 28 Failed!" << endl << endl;
+            return -1;
+        }
+
+        if (checkPage(fileHandle, 0, false, data, buffer) || checkPage(fileHandle, numPages / 2, true, data, buffer))
+            return -1;
+
+        // Write where the byte offset needs more than 32 bits, then append past the end
+        PageNum pastFourGigabytes = fourGigabytes / pageSize + 5;
+        PageNum written[3] = { pastFourGigabytes, numPages - 1, numPages };
+        for (unsigned i = 0; i < 3; i++)
+        {
+            fillPage(data, pageSize, written[i]);
+            rc = written[i] < numPages ? fileHandle.writePage(written[i], data) : fileHandle.appendPage(data);
+            assert(rc == success && "Writing a page should not fail.");
+        }
+        for (unsigned i = 0; i < 3; i++)
+        {
+            if (checkPage(fileHandle, written[i], false, data, buffer))
+                return -1;
+        }
+
+        // The free-space map reaches the far end of the file too
+        rc = fileHandle.setPageFreeSpace(numPages - 1, 4096);
+        assert(rc == success && "Setting the free space should not fail.");
+        PageNum found;
+        rc = fileHandle.findPageWithFreeSpace(2000, found);
+        if (rc != success || found != numPages - 1)
+        {
+            cout << "[FAIL] The page with free space at the end of the file was not found. Test Case 28 Failed!" << endl << endl;
+            return -1;
+        }
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+
+        // Everything is still there after opening the file again from disk
+        forgetIdleFiles(pfm);
+        rc = pfm->openFile(fileName, fileHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        assert(fileHandle.getNumberOfPages() == numPages + 1 && "The appended page should be in the file.");
+        for (unsigned i = 0; i < 3; i++)
+        {
+            if (checkPage(fileHandle, written[i], false, data, buffer))
+                return -1;
+        }
+        if (checkPage(fileHandle, 0, false, data, buffer) || checkPage(fileHandle, numPages / 2, true, data, buffer))
+            return -1;
+        rc = pfm->closeFile(fileHandle);
+        assert(rc == success && "Closing the file should not fail.");
+
+        cout << "Pages " << pastFourGigabytes << " to " << numPages << " of " << pageSize << " bytes are read and written past 4 GB!" << endl;
+
+        rc = pfm->destroyFile(fileName);
+        assert(rc == success && "Destroying the file should not fail.");
+
+        rc = destroyFileShouldSucceed(fileName);
+        assert(rc == success  && "Destroying the file should not fail.");
+    }
+
+    free(data);
+    free(buffer);
+
+    cout << "RBF Test Case 28 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+
+    for (unsigned i = 0; i < numSizes; i++)
+    {
+        remove(testFileName(i).c_str());
+    }
+
+    RC rcmain = RBFTest_28(pfm);
+    return rcmain;
+}
@@ -0,0 +1,404 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRecords = 1000;
+const unsigned numPages = 64;
+const string fileName = "test29";
+const string pagedFileName = "test29_pages";
+const string forwardFileName = "test29_forward";
+
+// Disk blocks the file takes, in 512 byte units
+long long diskBlocks(const string &name)
+{
+    struct stat sb;
+    if (stat(name.c_str(), &sb) != 0)
+        return -1;
+    return sb.st_blocks;
+}
+
+RC insertRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                 int base, vector<RID> &rids)
+{
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    void *record = malloc(100);
+    int recordSize = 0;
+
+    RC rc = success;
+    for (int i = 0; i < numRecords && rc == success; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", base + i, 170.1, (base + i) * 10, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+    }
+
+    free(nullsIndicator);
+    free(record);
+    return rc;
+}
+
+// Reads back the records whose index passes the filter
+int checkRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                 int base, const vector<RID> &rids, int step)
+{
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+
+    int result = 0;
+    for (int i = 0; i < numRecords && result == 0; i += step)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", base + i, 170.1, (base + i) * 10, record, &recordSize);
+        RC rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        if (rc != success || memcmp(record, returnedData, recordSize) != 0)
+            result = -1;
+    }
+
+    free(nullsIndicator);
+    free(record);
+    free(returnedData);
+    return result;
+}
+
+// Reads back one record, as prepareRecord makes it
+int checkRecord(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                const RID &rid, const string &name, int key)
+{
+    unsigned char nullsIndicator = 0;
+    vector<char> record(name.size() + 100);
+    vector<char> returnedData(name.size() + 100);
+    int recordSize = 0;
+    prepareRecord(recordDescriptor.size(), &nullsIndicator, name.size(), name, key, 170.1, key * 10, record.data(), &recordSize);
+    RC rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, returnedData.data());
+    return rc != success || memcmp(record.data(), returnedData.data(), recordSize) != 0 ? -1 : 0;
+}
+
+RC updateRecord(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                const RID &rid, const string &name, int key)
+{
+    unsigned char nullsIndicator = 0;
+    vector<char> record(name.size() + 100);
+    int recordSize = 0;
+    prepareRecord(recordDescriptor.size(), &nullsIndicator, name.size(), name, key, 170.1, key * 10, record.data(), &recordSize);
+    return rbfm->updateRecord(fileHandle, recordDescriptor, record.data(), rid);
+}
+
+RC insertRecord(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                const string &name, int key, RID &rid)
+{
+    unsigned char nullsIndicator = 0;
+    vector<char> record(name.size() + 100);
+    int recordSize = 0;
+    prepareRecord(recordDescriptor.size(), &nullsIndicator, name.size(), name, key, 170.1, key * 10, record.data(), &recordSize);
+    return rbfm->insertRecord(fileHandle, recordDescriptor, record.data(), rid);
+}
+
+// A record moved to page 0 leaves a forwarding address that must not pass for a deleted slot
+int checkForwardToFirstPage(RecordBasedFileManager *rbfm, const vector<Attribute> &recordDescriptor)
+{
+    RC rc = rbfm->createFile(forwardFileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileHandle fileHandle;
+    rc = rbfm->openFile(forwardFileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // A large record fills page 0; the one to move and a filler go on page 1
+    RID big, moved, filler;
+    rc = insertRecord(rbfm, fileHandle, recordDescriptor, string(4020, 'b'), 1, big);
+    assert(rc == success && "Inserting a record should not fail.");
+    rc = insertRecord(rbfm, fileHandle, recordDescriptor, "Mover", 2, moved);
+    assert(rc == success && "Inserting a record should not fail.");
+    rc = insertRecord(rbfm, fileHandle, recordDescriptor, string(3950, 'f'), 3, filler);
+    assert(rc == success && "Inserting a record should not fail.");
+    assert(big.pageNum == 0 && moved.pageNum == 1 && filler.pageNum == 1 && "The records should fill two pages.");
+
+    // Page 0 is given back, and the record grown past what page 1 has left moves there
+    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, big);
+    assert(rc == success && "Deleting a record should not fail.");
+    string grown(1000, 'm');
+    rc = updateRecord(rbfm, fileHandle, recordDescriptor, moved, grown, 2);
+    assert(rc == success && "Updating a record should not fail.");
+
+    // Page 1 keeps the forwarding address once the filler goes
+    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, filler);
+    assert(rc == success && "Deleting a record should not fail.");
+    int result = 0;
+    if (fileHandle.getNumberOfFreePages() != 0 || checkRecord(rbfm, fileHandle, recordDescriptor, moved, grown, 2) != 0)
+    {
+        cout << "[FAIL] A record moved to page 0 was lost with its old page. Test Case 29 Failed!" << endl << endl;
+        result = -1;
+    }
+    vector<char> returnedData(2000);
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, filler, returnedData.data());
+    assert(rc == RBFM_RECORD_DELETE && "A deleted record should not be read.");
+
+    // Deleting it empties both pages
+    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, moved);
+    assert(rc == success && "Deleting a moved record should not fail.");
+    assert(fileHandle.getNumberOfFreePages() == 2 && "Both emptied pages should be free.");
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, moved, returnedData.data());
+    assert(rc == RBFM_SLOT_NO_EXIST && "A record on a page given back should not be read.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(forwardFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    return result;
+}
+
+int RBFTest_29(PagedFileManager *pfm, RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Insert Records, Delete Records, emptying whole pages
+    // 2. Insert Records, into the pages given back, before the file grows
+    // 3. Close and Open File, keeping the free pages
+    // 4. Update Records, shrinking and growing them in place, then Delete Records next to them
+    // 5. Update Records, moving them to page 0, then Delete Records next to their forwarding address
+    // 6. Free Page, Allocate Page, punching holes in pages left free
+    cout << endl << "***** In RBF Test Case 29 *****" << endl;
+
+    RC rc;
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    vector<RID> rids(numRecords);
+
+    rc = insertRecords(rbfm, fileHandle, recordDescriptor, 0, rids);
+    assert(rc == success && "Inserting a record should not fail.");
+    unsigned pagesUsed = fileHandle.getNumberOfPages();
+    assert(pagesUsed > 2 && "The records should take several pages.");
+
+    // Deleting every other record compacts the pages, and the rest of the records read back
+    for (int i = 1; i < numRecords; i += 2)
+    {
+        rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+    }
+    if (checkRecords(rbfm, fileHandle, recordDescriptor, 0, rids, 2) != 0)
+    {
+        cout << "[FAIL] Records next to deleted ones were read wrong. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+    assert(fileHandle.getNumberOfFreePages() == 0 && "Pages with records left should not be free.");
+
+    // Once the rest go, every page is empty and given back
+    for (int i = 0; i < numRecords; i += 2)
+    {
+        rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[i]);
+        assert(rc == success && "Deleting a record should not fail.");
+    }
+    if (fileHandle.getNumberOfFreePages() != pagesUsed)
+    {
+        cout << "[FAIL] " << fileHandle.getNumberOfFreePages() << " of " << pagesUsed << " emptied pages are free. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+
+    // The free pages survive closing the file
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    pfm->setOpenFileLimit(0);
+    pfm->setOpenFileLimit(PFM_DEFAULT_OPEN_FILES);
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfFreePages() == pagesUsed && "The free pages should be kept in the header.");
+
+    // As many records again fit in the pages given back, without growing the file
+    rc = insertRecords(rbfm, fileHandle, recordDescriptor, numRecords, rids);
+    assert(rc == success && "Inserting a record should not fail.");
+    if (fileHandle.getNumberOfPages() != pagesUsed || fileHandle.getNumberOfFreePages() != 0)
+    {
+        cout << "[FAIL] The file grew to " << fileHandle.getNumberOfPages() << " pages from " << pagesUsed
+             << " with " << fileHandle.getNumberOfFreePages() << " pages still free. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+    if (checkRecords(rbfm, fileHandle, recordDescriptor, numRecords, rids, 1) != 0)
+    {
+        cout << "[FAIL] Records in reused pages were read wrong. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    RBFM_ScanIterator scanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    RID rid;
+    char returnedData[100];
+    int scanned = 0;
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        scanned++;
+    }
+    scanIterator.close();
+    if (scanned != numRecords)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Emptied pages are reused before the file grows!" << endl;
+
+    // Shrinking a record and deleting the next one keeps the page packed; growing the one after
+    // takes the room that leaves, in the same slot. Every other record on the page is untouched.
+    assert(rids[0].pageNum == rids[2].pageNum && "The first records should share a page.");
+    rc = updateRecord(rbfm, fileHandle, recordDescriptor, rids[0], "T", numRecords);
+    assert(rc == success && "Updating a record should not fail.");
+    rc = rbfm->deleteRecord(fileHandle, recordDescriptor, rids[1]);
+    assert(rc == success && "Deleting a record should not fail.");
+    string longName = "Tester with a long name";
+    rc = updateRecord(rbfm, fileHandle, recordDescriptor, rids[2], longName, numRecords + 2);
+    assert(rc == success && "Updating a record should not fail.");
+    int result = checkRecord(rbfm, fileHandle, recordDescriptor, rids[0], "T", numRecords);
+    result |= checkRecord(rbfm, fileHandle, recordDescriptor, rids[2], longName, numRecords + 2);
+    unsigned onPage = 0;
+    for (int i = 0; i < numRecords; i++)
+    {
+        if (rids[i].pageNum == rids[0].pageNum)
+            onPage++;
+        if (i > 2)
+            result |= checkRecord(rbfm, fileHandle, recordDescriptor, rids[i], "Tester", numRecords + i);
+    }
+    if (result != 0)
+    {
+        cout << "[FAIL] Records next to updated ones were read wrong. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[1], returnedData);
+    assert(rc == RBFM_RECORD_DELETE && "A deleted record should not be read.");
+    RID pastEnd = rids[0];
+    pastEnd.slotNum = onPage;
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, pastEnd, returnedData);
+    assert(rc == RBFM_SLOT_NO_EXIST && "A slot past the directory should not be read.");
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    scanned = 0;
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        scanned++;
+    }
+    scanIterator.close();
+    if (scanned != numRecords - 1 || checkForwardToFirstPage(rbfm, recordDescriptor) != 0)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records after updates. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Updated records keep their pages packed!" << endl;
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    // Pages left free long enough give their disk space back, and read as zeros
+    rc = pfm->createFile(pagedFileName);
+    assert(rc == success && "Creating the file should not fail.");
+    FileOptions options;
+    options.punchHoleMillis = 1;
+    options.extentPages = 0;
+    rc = pfm->openFile(pagedFileName, fileHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *data = malloc(numPages * PAGE_SIZE);
+    void *buffer = malloc(PAGE_SIZE);
+    memset(data, 'p', numPages * PAGE_SIZE);
+    rc = fileHandle.appendPages(numPages, data);
+    assert(rc == success && "Appending pages should not fail.");
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+    long long blocksBefore = diskBlocks(pagedFileName);
+
+    for (unsigned j = 0; j < numPages / 2; j++)
+    {
+        rc = fileHandle.freePage(j);
+        assert(rc == success && "Freeing a page should not fail.");
+    }
+    usleep(20000);
+    rc = fileHandle.freePage(numPages - 1);
+    assert(rc == success && "Freeing a page should not fail.");
+
+    long long blocksAfter = diskBlocks(pagedFileName);
+    if (blocksAfter > blocksBefore - (long long) (numPages / 2) * (PAGE_SIZE / 512))
+    {
+        cout << "[FAIL] The file took " << blocksBefore << " blocks before punching and " << blocksAfter
+             << " after. Test Case 29 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = fileHandle.readPage(0, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    memset(data, 0, PAGE_SIZE);
+    assert(memcmp(data, buffer, PAGE_SIZE) == 0 && "A punched page should read as zeros.");
+    rc = fileHandle.readPage(numPages / 2, buffer);
+    assert(rc == success && "Reading a page should not fail.");
+    memset(data, 'p', PAGE_SIZE);
+    assert(memcmp(data, buffer, PAGE_SIZE) == 0 && "A page in use should keep its data.");
+
+    // Punched pages are handed out again like any free page, zeroed
+    {
+        WritePageGuard page;
+        rc = fileHandle.allocatePage(page);
+        assert(rc == success && "Allocating a page should not fail.");
+        assert(page.getPageNum() == 0 && "The first free page should be handed out first.");
+        memset(data, 0, PAGE_SIZE);
+        assert(memcmp(page.data(), data, PAGE_SIZE) == 0 && "A page handed out should be zeroed.");
+        memset(page.mutableData(), 'q', PAGE_SIZE);
+    }
+    assert(fileHandle.getNumberOfPages() == numPages && "Handing out a free page should not grow the file.");
+    assert(fileHandle.getNumberOfFreePages() == numPages / 2 && "The page handed out should no longer be free.");
+    cout << "Pages left free give their disk space back!" << endl;
+
+    free(data);
+    free(buffer);
+
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->destroyFile(pagedFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    name = pagedFileName;
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 29 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager and record-based file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove(fileName.c_str());
+    remove(pagedFileName.c_str());
+    remove(forwardFileName.c_str());
+
+    RC rcmain = RBFTest_29(pfm, rbfm);
+    return rcmain;
+}
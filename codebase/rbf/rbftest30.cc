@@ -0,0 +1,308 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "asyncio.h"
+#include "rbfm.h"
+#include "checksum.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRecords = 1000;
+const unsigned numPages = 8;
+const string fileName = "test30";
+const string pagedFileName = "test30_pages";
+
+// Drops every page from the buffer pool and every idle file from the open-file table,
+// so the next reads come from disk
+void forgetCachedPages(PagedFileManager *pfm, BufferPoolManager *bpm)
+{
+    RC rc = bpm->setCapacity(bpm->getCapacity());
+    assert(rc == success && "Resizing the pool should not fail.");
+    pfm->setOpenFileLimit(0);
+    pfm->setOpenFileLimit(PFM_DEFAULT_OPEN_FILES);
+}
+
+// Flips a byte of a data page on disk, behind the paged file manager's back
+void corruptPage(const string &name, PageNum pageNum, unsigned offset)
+{
+    PageNum location = PageLayout<PAGE_SIZE>::dataPageLocation(pageNum);
+    int fd = open(name.c_str(), O_RDWR);
+    assert(fd >= 0 && "Opening the file should not fail.");
+    off_t position = (off_t) location * PAGE_SIZE + offset;
+    char c;
+    assert(pread(fd, &c, 1, position) == 1 && "Reading the file should not fail.");
+    c ^= 0x10;
+    assert(pwrite(fd, &c, 1, position) == 1 && "Writing the file should not fail.");
+    close(fd);
+}
+
+// Fills a page with a pattern unique to the page
+void fillPage(void *data, unsigned pageNum)
+{
+    for (unsigned i = 0; i < PAGE_SIZE; i++)
+    {
+        *((unsigned char *) data + i) = (i + pageNum * 13) % 253;
+    }
+}
+
+int RBFTest_30(PagedFileManager *pfm, RecordBasedFileManager *rbfm, BufferPoolManager *bpm)
+{
+    // Functions Tested:
+    // 1. Create File, with page checksums
+    // 2. Insert Records, Read Records, Scan, in pages that end in a checksum
+    // 3. Read Record, Read Page, Read Pages, Read Page Async, of a page corrupted on disk
+    // 4. Read Page, of holes in the file
+    // 5. Write Page Async, setting the checksum of a copy
+    cout << endl << "***** In RBF Test Case 30 *****" << endl;
+
+    RC rc;
+    rc = rbfm->createFile(fileName, PAGE_SIZE, PFM_PAGE_CHECKSUMS);
+    assert(rc == success && "Creating the file should not fail.");
+
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.hasChecksums() && "The file should keep page checksums.");
+    assert(fileHandle.getUsablePageSize() == PAGE_SIZE - PFM_CHECKSUM_SIZE && "The checksum should be kept out of the page's usable bytes.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    int recordSize = 0;
+    vector<RID> rids(numRecords);
+
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1, i * 10, record, &recordSize);
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, record, rids[i]);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Every page read back from disk passes its checksum
+    forgetCachedPages(pfm, bpm);
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    for (int i = 0; i < numRecords; i++)
+    {
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1, i * 10, record, &recordSize);
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        if (memcmp(record, returnedData, recordSize) != 0)
+        {
+            cout << "[FAIL] Record " << i << " was read wrong from a file with checksums. Test Case 30 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    unsigned pagesUsed = fileHandle.getNumberOfPages();
+    assert(pagesUsed > 2 && "The records should take several pages.");
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    RBFM_ScanIterator scanIterator;
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    RID rid;
+    int scanned = 0;
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        scanned++;
+    }
+    scanIterator.close();
+    if (scanned != numRecords)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records. Test Case 30 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    cout << numRecords << " records pass their page checksums!" << endl;
+
+    // A byte flipped on disk is caught on every path a page comes from disk by
+    int victim = 0;
+    while (rids[victim].pageNum != 1)
+        victim++;
+    forgetCachedPages(pfm, bpm);
+    corruptPage(fileName, 1, PAGE_SIZE / 2);
+
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[victim], returnedData);
+    assert(rc != success && "Reading a record from a corrupted page should fail.");
+    rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[0], returnedData);
+    assert(rc == success && "Reading a record from a sound page should not fail.");
+
+    void *page = malloc(pagesUsed * PAGE_SIZE);
+    rc = fileHandle.readPage(1, page);
+    assert(rc == FH_CHECKSUM_FAILED && "Reading a corrupted page should fail its checksum.");
+    rc = fileHandle.readPages(0, pagesUsed, page);
+    assert(rc == FH_CHECKSUM_FAILED && "Reading a run with a corrupted page should fail its checksum.");
+    vector<PageNum> pageNums;
+    pageNums.push_back(2);
+    pageNums.push_back(1);
+    rc = fileHandle.readPages(pageNums, page);
+    assert(rc == FH_CHECKSUM_FAILED && "Reading a list with a corrupted page should fail its checksum.");
+    IOToken token;
+    rc = fileHandle.readPageAsync(1, page, token);
+    assert(rc == success && "Starting a read should not fail.");
+    rc = fileHandle.waitIO(token);
+    assert(rc == AIO_CHECKSUM_FAILED && "Reading a corrupted page asynchronously should fail its checksum.");
+
+    // The scan reads ahead, so it may find the page as it starts
+    rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    scanned = 0;
+    while (rc == success && scanIterator.getNextRecord(rid, returnedData) == success)
+    {
+        scanned++;
+    }
+    scanIterator.close();
+    assert(scanned < numRecords && "A scan should stop at a corrupted page.");
+
+    // A handle that skips verification reads the page as it is
+    FileHandle uncheckedHandle;
+    FileOptions options;
+    options.verifyChecksums = false;
+    rc = pfm->openFile(fileName, uncheckedHandle, options);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = uncheckedHandle.readPage(1, page);
+    assert(rc == success && "Reading a page without verification should not fail.");
+    rc = pfm->closeFile(uncheckedHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    cout << "A corrupted page is caught on its way in from disk!" << endl;
+
+    free(nullsIndicator);
+    free(record);
+    free(returnedData);
+    free(page);
+
+    forgetCachedPages(pfm, bpm);
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    // Holes read as zeros and pass; pages written asynchronously get their checksum too
+    rc = pfm->createFile(pagedFileName, PAGE_SIZE, PFM_PAGE_CHECKSUMS);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = pfm->openFile(pagedFileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    void *data = malloc(numPages * PAGE_SIZE);
+    void *buffer = NULL;
+    assert(posix_memalign(&buffer, PAGE_SIZE, numPages * PAGE_SIZE) == 0 && "Allocating a buffer should not fail.");
+    for (unsigned j = 0; j < numPages; j++)
+        fillPage((char *) data + j * PAGE_SIZE, j);
+    rc = fileHandle.appendPages(numPages, data);
+    assert(rc == success && "Appending pages should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    forgetCachedPages(pfm, bpm);
+    rc = truncate(pagedFileName.c_str(), (off_t) PageLayout<PAGE_SIZE>::dataPageLocation(numPages * 2) * PAGE_SIZE);
+    assert(rc == success && "Growing the file should not fail.");
+    rc = pfm->openFile(pagedFileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfPages() == numPages * 2 && "The file should have grown by the holes.");
+
+    rc = fileHandle.readPages(0, numPages, buffer);
+    assert(rc == success && "Reading pages with checksums should not fail.");
+    for (unsigned j = 0; j < numPages; j++)
+    {
+        fillPage(data, j);
+        if (memcmp(data, (char *) buffer + j * PAGE_SIZE, PAGE_SIZE - PFM_CHECKSUM_SIZE) != 0)
+        {
+            cout << "[FAIL] Page " << j << " was read wrong. Test Case 30 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    rc = fileHandle.readPage(numPages + 1, buffer);
+    assert(rc == success && "Reading a hole should not fail its checksum.");
+
+    fillPage(data, numPages * 3);
+    rc = fileHandle.writePageAsync(numPages + 1, data, token);
+    assert(rc == success && "Starting a write should not fail.");
+    rc = fileHandle.waitIO(token);
+    assert(rc == success && "Writing a page should not fail.");
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    forgetCachedPages(pfm, bpm);
+    rc = pfm->openFile(pagedFileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.readPage(numPages + 1, buffer);
+    assert(rc == success && "Reading a page written asynchronously should not fail its checksum.");
+    if (memcmp(data, buffer, PAGE_SIZE - PFM_CHECKSUM_SIZE) != 0)
+    {
+        cout << "[FAIL] The page written asynchronously was read wrong. Test Case 30 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    cout << "Holes pass, and asynchronous writes carry their checksum!" << endl;
+
+    // What a checksum costs, for the record
+    const unsigned rounds = 100000;
+    uint32_t sum = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned i = 0; i < rounds; i++)
+    {
+        *(unsigned *) data = i;
+        sum += crc32c(data, PAGE_SIZE - PFM_CHECKSUM_SIZE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double nanos = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / rounds;
+    cout << "A checksum of a " << PAGE_SIZE << " byte page takes " << (unsigned) nanos << " ns (" << (sum != 0) << ")." << endl;
+
+    free(data);
+    free(buffer);
+
+    rc = pfm->destroyFile(pagedFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    name = pagedFileName;
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 30 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager, buffer pool and record-based file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+
+    remove(fileName.c_str());
+    remove(pagedFileName.c_str());
+
+    RC rcmain = RBFTest_30(pfm, rbfm, bpm);
+    return rcmain;
+}
@@ -0,0 +1,205 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "bpm.h"
+#include "iostats.h"
+#include "test_util.h"
+
+using namespace std;
+
+const unsigned numPages = 40;
+const unsigned poolFrames = 8;
+const string fileName = "test31";
+const string otherFileName = "test31_other";
+
+// Checks a histogram is consistent with itself: percentiles in order and within the slowest seen
+int checkLatency(const IOStatsSnapshot &stats, IOOp op, uint64_t count, const char *name)
+{
+    const LatencySnapshot &latency = stats.latency[op];
+    uint64_t inBuckets = 0;
+    for (unsigned b = 0; b < IOSTATS_BUCKETS; b++)
+        inBuckets += latency.buckets[b];
+    uint64_t p50 = latency.percentileNanos(0.5);
+    uint64_t p99 = latency.percentileNanos(0.99);
+    uint64_t p999 = latency.percentileNanos(0.999);
+    if (latency.count != count || inBuckets != count || p50 > p99 || p99 > p999 || p999 > latency.maxNanos
+            || latency.maxNanos == 0 || latency.meanNanos() > latency.maxNanos)
+    {
+        cout << "[FAIL] " << latency.count << " " << name << "s were timed, " << inBuckets << " in buckets, with p50 "
+             << p50 << " p99 " << p99 << " p999 " << p999 << " max " << latency.maxNanos << " ns, expected "
+             << count << ". Test Case 31 Failed!" << endl << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int RBFTest_31(PagedFileManager *pfm, BufferPoolManager *bpm)
+{
+    // Functions Tested:
+    // 1. Latency buckets, covering every latency once
+    // 2. Collect Stats, of reads, writes, appends and syncs, and of the buffer pool, per file and in all
+    // 3. Reset Stats
+    cout << endl << "***** In RBF Test Case 31 *****" << endl;
+
+    // Every latency falls in the bucket whose range holds it, and the buckets follow on from each other
+    uint64_t limit = 0;
+    for (unsigned b = 0; b < IOSTATS_BUCKETS; b++)
+    {
+        uint64_t next = LatencyHistogram::bucketLimit(b);
+        if (next <= limit || LatencyHistogram::bucketOf(limit) != b || LatencyHistogram::bucketOf(next - 1) != b
+                || (b >= IOSTATS_SUB_BUCKETS && (next - limit) * IOSTATS_SUB_BUCKETS > limit))
+        {
+            cout << "[FAIL] Bucket " << b << " covers " << limit << " to " << next << " ns. Test Case 31 Failed!" << endl << endl;
+            return -1;
+        }
+        limit = next;
+    }
+    assert(LatencyHistogram::bucketOf(UINT64_MAX) == IOSTATS_BUCKETS - 1 && "The longest latencies should land in the last bucket.");
+
+    RC rc;
+    rc = pfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+    rc = pfm->createFile(otherFileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    unsigned capacity = bpm->getCapacity();
+    rc = bpm->setCapacity(poolFrames);
+    assert(rc == success && "Resizing the pool should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    FileHandle otherHandle;
+    rc = pfm->openFile(otherFileName, otherHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    pfm->resetStats();
+
+    void *data = malloc(PAGE_SIZE);
+    memset(data, 'a', PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    rc = otherHandle.appendPage(data);
+    assert(rc == success && "Appending a page should not fail.");
+
+    // Starting over forgets the appends, and only those of the file it is asked of
+    rc = fileHandle.resetStats();
+    assert(rc == success && "Resetting the statistics should not fail.");
+    IOStatsSnapshot stats;
+    rc = fileHandle.collectStats(stats);
+    assert(rc == success && "Collecting the statistics should not fail.");
+    assert(stats.latency[IOAppend].count == 0 && stats.bytesWritten == 0 && stats.poolMisses == 0 && "Resetting should clear the statistics.");
+    pfm->collectStats(stats);
+    assert(stats.latency[IOAppend].count == numPages + 1 && "The appends should still count in all.");
+
+    // Every page is read twice in a row, then each is written and the file synced.
+    // With a pool of a few frames, each page misses on the first read, hits on the second,
+    // and pushes out an older page once the pool is full.
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        rc = fileHandle.readPage(i, data);
+        assert(rc == success && "Reading a page should not fail.");
+        rc = fileHandle.readPage(i, data);
+        assert(rc == success && "Reading a page should not fail.");
+    }
+    for (unsigned i = 0; i < numPages; i++)
+    {
+        rc = fileHandle.writePage(i, data);
+        assert(rc == success && "Writing a page should not fail.");
+    }
+    rc = fileHandle.sync();
+    assert(rc == success && "Syncing the file should not fail.");
+
+    rc = fileHandle.collectStats(stats);
+    assert(rc == success && "Collecting the statistics should not fail.");
+    if (checkLatency(stats, IORead, 2 * numPages, "read") || checkLatency(stats, IOWrite, numPages, "write")
+            || checkLatency(stats, IOSync, 1, "sync"))
+        return -1;
+    if (stats.bytesRead != 2 * numPages * PAGE_SIZE || stats.bytesWritten != numPages * PAGE_SIZE)
+    {
+        cout << "[FAIL] " << stats.bytesRead << " bytes were read and " << stats.bytesWritten << " written. Test Case 31 Failed!" << endl << endl;
+        return -1;
+    }
+    if (stats.poolHits < numPages || stats.poolMisses < numPages || stats.poolEvictions < numPages - poolFrames)
+    {
+        cout << "[FAIL] The pool had " << stats.poolHits << " hits, " << stats.poolMisses << " misses and "
+             << stats.poolEvictions << " evictions. Test Case 31 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << stats.toString();
+
+    // The global statistics add up every file
+    IOStatsSnapshot global;
+    pfm->collectStats(global);
+    if (global.latency[IORead].count < stats.latency[IORead].count || global.bytesWritten < stats.bytesWritten + (numPages + 1) * PAGE_SIZE
+            || global.poolMisses < stats.poolMisses)
+    {
+        cout << "[FAIL] The global statistics miss some of the file's. Test Case 31 Failed!" << endl << endl;
+        return -1;
+    }
+    string text = global.toString();
+    assert(text.find("p999") != string::npos && text.find("append") != string::npos && "The text dump should show the percentiles of every operation.");
+
+    // A second handle on the file shares its statistics
+    FileHandle secondHandle;
+    rc = pfm->openFile(fileName, secondHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = secondHandle.readPage(0, data);
+    assert(rc == success && "Reading a page should not fail.");
+    rc = fileHandle.collectStats(stats);
+    assert(rc == success && "Collecting the statistics should not fail.");
+    assert(stats.latency[IORead].count == 2 * numPages + 1 && "Reads through every handle should count for the file.");
+    rc = pfm->closeFile(secondHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = secondHandle.collectStats(stats);
+    assert(rc == PFM_FILE_NOT_OPEN && "A closed handle should have no statistics.");
+
+    pfm->resetStats();
+    pfm->collectStats(global);
+    assert(global.latency[IORead].count == 0 && global.bytesRead == 0 && global.poolHits == 0 && "Resetting should clear the global statistics.");
+    cout << "Page I/O latencies and pool counts are kept per file and in all!" << endl;
+
+    free(data);
+    rc = pfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm->closeFile(otherHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = bpm->setCapacity(capacity);
+    assert(rc == success && "Resizing the pool should not fail.");
+
+    rc = pfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+    rc = pfm->destroyFile(otherFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 31 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the paged file manager and buffer pool
+    PagedFileManager *pfm = PagedFileManager::instance();
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+
+    remove(fileName.c_str());
+    remove(otherFileName.c_str());
+
+    RC rcmain = RBFTest_31(pfm, bpm);
+    return rcmain;
+}
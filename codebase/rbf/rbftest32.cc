@@ -0,0 +1,238 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRecords = 20000;
+const int numSingleRecords = 2000;
+const string fileName = "test32";
+const string singleFileName = "test32_single";
+const string checksumFileName = "test32_checksums";
+
+// Builds the records of index base up, each in its own buffer, and tells their size
+int prepareRecords(const vector<Attribute> &recordDescriptor, int base, int count, vector<const void*> &records)
+{
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    int recordSize = 0;
+
+    records.clear();
+    for (int i = 0; i < count; i++)
+    {
+        void *record = malloc(100);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", base + i, 170.1, (base + i) * 10, record, &recordSize);
+        records.push_back(record);
+    }
+    free(nullsIndicator);
+    return recordSize;
+}
+
+void freeRecords(vector<const void*> &records)
+{
+    for (size_t i = 0; i < records.size(); i++)
+        free((void *) records[i]);
+    records.clear();
+}
+
+// Reads back every record by its RID, then scans the file for as many
+int checkRecords(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor,
+                 const vector<const void*> &records, const vector<RID> &rids, int recordSize, int scanCount)
+{
+    void *returnedData = malloc(100);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        RC rc = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData);
+        if (rc != success || memcmp(records[i], returnedData, recordSize) != 0)
+        {
+            cout << "[FAIL] Record " << i << " was read wrong from page " << rids[i].pageNum << " slot " << rids[i].slotNum
+                 << ". Test Case 32 Failed!" << endl << endl;
+            free(returnedData);
+            return -1;
+        }
+    }
+
+    vector<string> attributeNames;
+    attributeNames.push_back("Age");
+    RBFM_ScanIterator scanIterator;
+    RC rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+    RID rid;
+    int scanned = 0;
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+        scanned++;
+    scanIterator.close();
+    free(returnedData);
+    if (scanned != scanCount)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records, expected " << scanCount << ". Test Case 32 Failed!" << endl << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int RBFTest_32(PagedFileManager *pfm, RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Insert Records, many at once onto pages built in memory
+    // 2. Read Record and Scan, of the records inserted at once
+    // 3. Insert Record, filling the room the batch left on its last page
+    // 4. Insert Records, into a file with page checksums
+    cout << endl << "***** In RBF Test Case 32 *****" << endl;
+
+    RC rc;
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+    rc = rbfm->createFile(singleFileName);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = rbfm->createFile(checksumFileName, PAGE_SIZE, PFM_PAGE_CHECKSUMS);
+    assert(rc == success && "Creating the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    vector<const void*> records;
+    int recordSize = prepareRecords(recordDescriptor, 0, numRecords, records);
+
+    // Nothing to insert is no work, and no page
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    unsigned firstPages = fileHandle.getNumberOfPages();
+    vector<const void*> none;
+    vector<RID> rids;
+    rc = rbfm->insertRecords(fileHandle, recordDescriptor, none, rids);
+    assert(rc == success && rids.empty() && fileHandle.getNumberOfPages() == firstPages && "Inserting no records should do nothing.");
+
+    // The records go to new pages at the end of the file, each packed before the next
+    uint64_t start = IOStats::now();
+    rc = rbfm->insertRecords(fileHandle, recordDescriptor, records, rids);
+    uint64_t batchNanos = IOStats::now() - start;
+    assert(rc == success && "Inserting the records should not fail.");
+    assert(rids.size() == records.size() && "Every record should get a RID.");
+    unsigned pagesUsed = fileHandle.getNumberOfPages();
+    for (size_t i = 1; i < rids.size(); i++)
+    {
+        bool next = rids[i].pageNum == rids[i - 1].pageNum ? rids[i].slotNum == rids[i - 1].slotNum + 1
+                  : rids[i].pageNum == rids[i - 1].pageNum + 1 && rids[i].slotNum == 0;
+        if (!next)
+        {
+            cout << "[FAIL] Record " << i << " went to page " << rids[i].pageNum << " slot " << rids[i].slotNum
+                 << " after page " << rids[i - 1].pageNum << " slot " << rids[i - 1].slotNum << ". Test Case 32 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    assert(rids[0].pageNum == firstPages && rids[0].slotNum == 0 && "The records should start on a new page.");
+    assert(rids.back().pageNum == pagesUsed - 1 && "The records should fill the pages appended and no more.");
+    if (checkRecords(rbfm, fileHandle, recordDescriptor, records, rids, recordSize, numRecords) != 0)
+        return -1;
+
+    // The same records one by one end up on pages just as full, only slower: the file's
+    // first page, left empty by createFile, takes them before any page is appended
+    FileHandle singleHandle;
+    rc = rbfm->openFile(singleFileName, singleHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    RID rid;
+    start = IOStats::now();
+    for (int i = 0; i < numSingleRecords; i++)
+    {
+        rc = rbfm->insertRecord(singleHandle, recordDescriptor, records[i], rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    uint64_t singleNanos = IOStats::now() - start;
+    assert(rid.pageNum + firstPages == rids[numSingleRecords - 1].pageNum && rid.slotNum == rids[numSingleRecords - 1].slotNum
+           && "One by one, the records should be placed as in a batch.");
+    cout << "Inserted " << numRecords << " records at once at " << (uint64_t) (numRecords * 1e9 / max(batchNanos, (uint64_t) 1))
+         << " records/s, and one by one at " << (uint64_t) (numSingleRecords * 1e9 / max(singleNanos, (uint64_t) 1)) << " records/s." << endl;
+    rc = rbfm->closeFile(singleHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // The free space map knows the room the batch left at the end of its first block: once the
+    // first page is full, the next record inserted goes there
+    unsigned perPage = 0;
+    while (rids[perPage].pageNum == firstPages)
+        perPage++;
+    assert(RBFM_LOAD_BLOCK_RECORDS % perPage != 0 && "The last page of a block should have room left.");
+    for (unsigned i = 0; i <= perPage; i++)
+    {
+        rc = rbfm->insertRecord(fileHandle, recordDescriptor, records[i], rid);
+        assert(rc == success && "Inserting a record should not fail.");
+    }
+    assert(fileHandle.getNumberOfPages() == pagesUsed && rid.pageNum == rids[RBFM_LOAD_BLOCK_RECORDS - 1].pageNum
+           && "The record should fill the last page of the first block.");
+
+    // A second batch follows on, after reopening the file
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    vector<const void*> moreRecords;
+    prepareRecords(recordDescriptor, numRecords, numSingleRecords, moreRecords);
+    vector<RID> moreRids;
+    rc = rbfm->insertRecords(fileHandle, recordDescriptor, moreRecords, moreRids);
+    assert(rc == success && "Inserting the records should not fail.");
+    assert(moreRids[0].pageNum == pagesUsed && "A batch should start on a new page.");
+    if (checkRecords(rbfm, fileHandle, recordDescriptor, moreRecords, moreRids, recordSize, numRecords + perPage + 1 + numSingleRecords) != 0)
+        return -1;
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // Pages built in memory get their checksum when they are appended
+    FileHandle checksumHandle;
+    rc = rbfm->openFile(checksumFileName, checksumHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = rbfm->insertRecords(checksumHandle, recordDescriptor, records, rids);
+    assert(rc == success && "Inserting the records should not fail.");
+    rc = rbfm->closeFile(checksumHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    pfm->setOpenFileLimit(0);
+    pfm->setOpenFileLimit(PFM_DEFAULT_OPEN_FILES);
+    rc = rbfm->openFile(checksumFileName, checksumHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    if (checkRecords(rbfm, checksumHandle, recordDescriptor, records, rids, recordSize, numRecords) != 0)
+        return -1;
+    rc = rbfm->closeFile(checksumHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    cout << "Records are inserted many at once onto whole pages!" << endl;
+
+    freeRecords(records);
+    freeRecords(moreRecords);
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+    rc = rbfm->destroyFile(singleFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = rbfm->destroyFile(checksumFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 32 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove(fileName.c_str());
+    remove(singleFileName.c_str());
+    remove(checksumFileName.c_str());
+
+    RC rcmain = RBFTest_32(pfm, rbfm);
+    return rcmain;
+}
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRows = 10000;
+const string fileName = "test33";
+const string halfFileName = "test33_half";
+const string csvFileName = "test33.csv";
+
+// The fields of row i, as they are meant to be read; a few rows hold NULLs and names that need quoting
+void rowFields(int i, string &name, unsigned char &nulls)
+{
+    nulls = 0;
+    switch (i)
+    {
+        case 1: name = "Smith, John"; break;
+        case 2: name = "say \"hi\""; break;
+        case 3: name = "two\nlines"; break;
+        case 4: name = "Bob"; nulls = 1 << 6; break;           // no age
+        case 5: name = ""; break;
+        case 6: name = ""; nulls = 1 << 7; break;              // no name
+        case 7: name = "Ann"; nulls = (1 << 5) | (1 << 4); break;
+        default: name = "Tester" + to_string(i);
+    }
+}
+
+// Row i in CSV, every other line ending in \r\n
+string csvRow(int i)
+{
+    string name;
+    unsigned char nulls;
+    rowFields(i, name, nulls);
+    string row;
+    if (i == 1 || i == 3 || i == 5)
+        row = "\"" + name + "\"";
+    else if (i == 2)
+        row = "\"say \"\"hi\"\"\"";
+    else if (!(nulls & (1 << 7)))
+        row = name;
+    row += ",";
+    if (!(nulls & (1 << 6)))
+        row += to_string(i);
+    row += ",";
+    if (!(nulls & (1 << 5)))
+        row += "170.5";
+    row += ",";
+    if (!(nulls & (1 << 4)))
+        row += to_string(i * 10);
+    return row + (i % 2 ? "\r\n" : "\n");
+}
+
+// Scans the file and compares every record with the rows it was loaded from, in order
+int checkRows(RecordBasedFileManager *rbfm, FileHandle &fileHandle, const vector<Attribute> &recordDescriptor, int count)
+{
+    vector<string> attributeNames;
+    for (unsigned i = 0; i < recordDescriptor.size(); i++)
+        attributeNames.push_back(recordDescriptor[i].name);
+    RBFM_ScanIterator scanIterator;
+    RC rc = rbfm->scan(fileHandle, recordDescriptor, "", NO_OP, NULL, attributeNames, scanIterator);
+    assert(rc == success && "Scanning the file should not fail.");
+
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    RID rid;
+    int scanned = 0;
+    int result = 0;
+    while (result == 0 && scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        string name;
+        unsigned char nulls;
+        rowFields(scanned, name, nulls);
+        int recordSize = 0;
+        prepareRecord(recordDescriptor.size(), &nulls, name.size(), name, scanned, 170.5, scanned * 10, record, &recordSize);
+        if (scanned >= count || memcmp(record, returnedData, recordSize) != 0)
+        {
+            cout << "[FAIL] Row " << scanned << " was loaded wrong. Test Case 33 Failed!" << endl << endl;
+            result = -1;
+        }
+        scanned++;
+    }
+    scanIterator.close();
+    free(record);
+    free(returnedData);
+    if (result == 0 && scanned != count)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " rows, expected " << count << ". Test Case 33 Failed!" << endl << endl;
+        result = -1;
+    }
+    return result;
+}
+
+int RBFTest_33(PagedFileManager *pfm, RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Bulk Load, of a CSV file with a header, quoted fields, NULLs and \r\n line ends
+    // 2. Bulk Load, filling pages only so far
+    // 3. Bulk Load, stopping at a bad row, and refusing a bad fill factor
+    cout << endl << "***** In RBF Test Case 33 *****" << endl;
+
+    RC rc;
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+    rc = rbfm->createFile(halfFileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    uint64_t csvBytes = 0;
+    {
+        ofstream csv(csvFileName.c_str(), ios::out | ios::binary);
+        string header = "EmpName,Age,Height,Salary\n";
+        csv << header;
+        csvBytes += header.size();
+        for (int i = 0; i < numRows; i++)
+        {
+            string row = csvRow(i);
+            csv << row;
+            csvBytes += row.size();
+            // A blank line is passed over
+            if (i == 100)
+            {
+                csv << "\n";
+                csvBytes++;
+            }
+        }
+    }
+
+    BulkLoadOptions options;
+    options.header = true;
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    unsigned firstPages = fileHandle.getNumberOfPages();
+    BulkLoadStats stats;
+    rc = rbfm->bulkLoad(fileHandle, recordDescriptor, csvFileName, options, stats);
+    assert(rc == success && "Loading the file should not fail.");
+    if (stats.rows != numRows || stats.bytes != csvBytes || stats.errorLine != 0
+            || stats.pages != fileHandle.getNumberOfPages() - firstPages || stats.pages < 64)
+    {
+        cout << "[FAIL] The load took " << stats.rows << " rows and " << stats.bytes << " bytes onto " << stats.pages
+             << " pages. Test Case 33 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Loaded " << stats.rows << " rows at " << (uint64_t) stats.rowsPerSecond() << " rows/s, "
+         << stats.megabytesPerSecond() << " MB/s." << endl;
+    if (checkRows(rbfm, fileHandle, recordDescriptor, numRows) != 0)
+        return -1;
+
+    // Filled only half way, the pages number about twice as many
+    FileHandle halfHandle;
+    rc = rbfm->openFile(halfFileName, halfHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    BulkLoadOptions halfOptions = options;
+    halfOptions.fillFactor = 0.5;
+    BulkLoadStats halfStats;
+    rc = rbfm->bulkLoad(halfHandle, recordDescriptor, csvFileName, halfOptions, halfStats);
+    assert(rc == success && "Loading the file should not fail.");
+    if (halfStats.rows != numRows || halfStats.pages < 2 * stats.pages - 2 || halfStats.pages > 2 * stats.pages + 2)
+    {
+        cout << "[FAIL] Half full, " << halfStats.rows << " rows took " << halfStats.pages << " pages against "
+             << stats.pages << ". Test Case 33 Failed!" << endl << endl;
+        return -1;
+    }
+    if (checkRows(rbfm, halfHandle, recordDescriptor, numRows) != 0)
+        return -1;
+    rc = rbfm->closeFile(halfHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    halfOptions.fillFactor = 0;
+    rc = rbfm->bulkLoad(fileHandle, recordDescriptor, csvFileName, halfOptions, stats);
+    assert(rc == RBFM_BAD_FILL_FACTOR && "A fill factor of 0 should be refused.");
+    halfOptions.fillFactor = 1.5;
+    rc = rbfm->bulkLoad(fileHandle, recordDescriptor, csvFileName, halfOptions, stats);
+    assert(rc == RBFM_BAD_FILL_FACTOR && "A fill factor over 1 should be refused.");
+    rc = rbfm->bulkLoad(fileHandle, recordDescriptor, "test33_missing.csv", options, stats);
+    assert(rc == RBFM_OPEN_FAILED && "A missing file should not load.");
+
+    // Rows that don't parse stop the load at their line, after the rows before them
+    const char *badRows[] = {
+        "Zed,12x,170.5,10\n",                               // not a number
+        "Zed,1,170.5\n",                                    // a field short
+        "Zed,1,170.5,10,11\n",                              // a field over
+        "\"Zed\"x,1,170.5,10\n",                            // text past a quote
+        "Zed,99999999999,170.5,10\n",                       // too big for an int
+        "Abcdefghijklmnopqrstuvwxyzabcde,1,170.5,10\n",     // longer than 30 characters
+        "\"Zed,1,170.5,10\n"                                // a quote never closed
+    };
+    for (unsigned b = 0; b < sizeof(badRows) / sizeof(badRows[0]); b++)
+    {
+        stringstream input;
+        input << "Ok,1,170.5,10\nOk,2,170.5,20\n" << badRows[b] << "Ok,3,170.5,30\n";
+        unsigned pages = fileHandle.getNumberOfPages();
+        rc = rbfm->bulkLoad(fileHandle, recordDescriptor, input, BulkLoadOptions(), stats);
+        if (rc != RBFM_CSV_PARSE_FAILED || stats.rows != 2 || stats.errorLine < 3 || fileHandle.getNumberOfPages() != pages + 1)
+        {
+            cout << "[FAIL] Bad row " << b << " gave " << rc << " after " << stats.rows << " rows, at line "
+                 << stats.errorLine << ". Test Case 33 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    cout << "CSV files are loaded straight onto whole pages!" << endl;
+
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    remove(csvFileName.c_str());
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+    rc = rbfm->destroyFile(halfFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 33 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove(fileName.c_str());
+    remove(halfFileName.c_str());
+    remove(csvFileName.c_str());
+
+    RC rcmain = RBFTest_33(pfm, rbfm);
+    return rcmain;
+}
@@ -0,0 +1,247 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRecords = 30000;
+const int numRows = 120000;
+const int badRow = 100000;
+const unsigned numThreads = 4;
+const string fileName = "test34";
+const string serialFileName = "test34_serial";
+const string parallelFileName = "test34_parallel";
+const string csvFileName = "test34.csv";
+
+// Whether two files hold the same pages, byte for byte
+int comparePages(FileHandle &first, FileHandle &second)
+{
+    if (first.getNumberOfPages() != second.getNumberOfPages())
+        return -1;
+    void *firstPage = malloc(PAGE_SIZE);
+    void *secondPage = malloc(PAGE_SIZE);
+    int result = 0;
+    for (PageNum p = 0; p < first.getNumberOfPages() && result == 0; p++)
+    {
+        if (first.readPage(p, firstPage) != success || second.readPage(p, secondPage) != success
+                || memcmp(firstPage, secondPage, PAGE_SIZE) != 0)
+            result = -1;
+    }
+    free(firstPage);
+    free(secondPage);
+    return result;
+}
+
+// Loads the CSV file into a new file on as many threads
+RC loadFile(RecordBasedFileManager *rbfm, const string &name, const vector<Attribute> &recordDescriptor, unsigned threads,
+            FileHandle &fileHandle, BulkLoadStats &stats)
+{
+    RC rc = rbfm->createFile(name);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = rbfm->openFile(name, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    BulkLoadOptions options;
+    options.threads = threads;
+    return rbfm->bulkLoad(fileHandle, recordDescriptor, csvFileName, options, stats);
+}
+
+int RBFTest_34(PagedFileManager *pfm, RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Insert Records, on several threads, to the same pages and RIDs as on one
+    // 2. Insert Records, on several threads, while another handle inserts into the file
+    // 3. Bulk Load, on several threads, to the same pages as on one, stopping at the same bad row
+    cout << endl << "***** In RBF Test Case 34 *****" << endl;
+
+    RC rc;
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    unsigned char *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    vector<const void*> records;
+    int recordSize = 0;
+    for (int i = 0; i < numRecords; i++)
+    {
+        void *record = malloc(100);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 6, "Tester", i, 170.1, i * 10, record, &recordSize);
+        records.push_back(record);
+    }
+
+    // The same records on one thread and on several take the same RIDs
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    vector<RID> serialRids;
+    rc = rbfm->insertRecords(fileHandle, recordDescriptor, records, serialRids, 1);
+    assert(rc == success && "Inserting the records should not fail.");
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    vector<RID> rids;
+    rc = rbfm->insertRecords(fileHandle, recordDescriptor, records, rids, numThreads);
+    assert(rc == success && "Inserting the records should not fail.");
+    for (int i = 0; i < numRecords; i++)
+    {
+        if (rids[i].pageNum != serialRids[i].pageNum || rids[i].slotNum != serialRids[i].slotNum)
+        {
+            cout << "[FAIL] Record " << i << " went to page " << rids[i].pageNum << " slot " << rids[i].slotNum << " on "
+                 << numThreads << " threads, and to page " << serialRids[i].pageNum << " slot " << serialRids[i].slotNum
+                 << " on one. Test Case 34 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    // While a batch is packed and appended, another handle goes on inserting, and every record
+    // of either reads back from where it went
+    FileHandle otherHandle;
+    rc = rbfm->openFile(fileName, otherHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    vector<RID> otherRids(numRecords / 10);
+    atomic<bool> otherFailed(false);
+    thread other([&]() {
+        for (unsigned i = 0; i < otherRids.size(); i++)
+            if (rbfm->insertRecord(otherHandle, recordDescriptor, records[i], otherRids[i]) != success)
+                otherFailed = true;
+    });
+    rc = rbfm->insertRecords(fileHandle, recordDescriptor, records, rids, numThreads);
+    other.join();
+    assert(rc == success && !otherFailed && "Inserting the records should not fail.");
+    void *returnedData = malloc(100);
+    for (int i = 0; i < numRecords; i++)
+    {
+        bool batchRight = rbfm->readRecord(fileHandle, recordDescriptor, rids[i], returnedData) == success
+                && memcmp(records[i], returnedData, recordSize) == 0;
+        bool otherRight = (unsigned) i >= otherRids.size()
+                || (rbfm->readRecord(fileHandle, recordDescriptor, otherRids[i], returnedData) == success
+                    && memcmp(records[i], returnedData, recordSize) == 0);
+        if (!batchRight || !otherRight)
+        {
+            cout << "[FAIL] Record " << i << " inserted alongside another handle was read wrong. Test Case 34 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+    free(returnedData);
+    rc = rbfm->closeFile(otherHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    cout << "Records packed on " << numThreads << " threads take the same RIDs as on one!" << endl;
+
+    // A CSV file of several blocks loads to the same pages on one thread and on several
+    {
+        ofstream csv(csvFileName.c_str(), ios::out | ios::binary);
+        for (int i = 0; i < numRows; i++)
+            csv << "Tester" << i << "," << i << ",170.5," << i * 10 << "\n";
+    }
+    FileHandle serialHandle;
+    BulkLoadStats serialStats;
+    rc = loadFile(rbfm, serialFileName, recordDescriptor, 1, serialHandle, serialStats);
+    assert(rc == success && "Loading the file should not fail.");
+    FileHandle parallelHandle;
+    BulkLoadStats parallelStats;
+    rc = loadFile(rbfm, parallelFileName, recordDescriptor, numThreads, parallelHandle, parallelStats);
+    assert(rc == success && "Loading the file should not fail.");
+    if (serialStats.rows != numRows || parallelStats.rows != numRows || parallelStats.bytes != serialStats.bytes
+            || serialStats.bytes < 3 * RBFM_LOAD_BLOCK_BYTES || comparePages(serialHandle, parallelHandle) != 0)
+    {
+        cout << "[FAIL] " << parallelStats.rows << " rows loaded on " << numThreads << " threads onto " << parallelStats.pages
+             << " pages, against " << serialStats.rows << " rows onto " << serialStats.pages << " pages on one. Test Case 34 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "Loaded " << numRows << " rows at " << (uint64_t) serialStats.rowsPerSecond() << " rows/s on one thread and "
+         << (uint64_t) parallelStats.rowsPerSecond() << " rows/s on " << numThreads << "." << endl;
+    rc = rbfm->closeFile(serialHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->closeFile(parallelHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(serialFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = rbfm->destroyFile(parallelFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    // A bad row in a later block stops the load at its line on any number of threads, after the rows before it
+    {
+        ofstream csv(csvFileName.c_str(), ios::out | ios::binary);
+        for (int i = 0; i < numRows; i++)
+        {
+            if (i == badRow)
+                csv << "Tester" << i << ",not a number,170.5," << i * 10 << "\n";
+            else
+                csv << "Tester" << i << "," << i << ",170.5," << i * 10 << "\n";
+        }
+    }
+    rc = loadFile(rbfm, serialFileName, recordDescriptor, 1, serialHandle, serialStats);
+    assert(rc == RBFM_CSV_PARSE_FAILED && "The bad row should stop the load.");
+    rc = loadFile(rbfm, parallelFileName, recordDescriptor, numThreads, parallelHandle, parallelStats);
+    assert(rc == RBFM_CSV_PARSE_FAILED && "The bad row should stop the load.");
+    if (serialStats.rows != badRow || serialStats.errorLine != badRow + 1 || parallelStats.rows != badRow
+            || parallelStats.errorLine != badRow + 1 || comparePages(serialHandle, parallelHandle) != 0)
+    {
+        cout << "[FAIL] The load stopped after " << parallelStats.rows << " rows at line " << parallelStats.errorLine << " on "
+             << numThreads << " threads, and after " << serialStats.rows << " rows at line " << serialStats.errorLine
+             << " on one. Test Case 34 Failed!" << endl << endl;
+        return -1;
+    }
+    cout << "CSV files load to the same pages on " << numThreads << " threads as on one!" << endl;
+
+    rc = rbfm->closeFile(serialHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->closeFile(parallelHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(serialFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = rbfm->destroyFile(parallelFileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    remove(csvFileName.c_str());
+    for (int i = 0; i < numRecords; i++)
+        free((void *) records[i]);
+    free(nullsIndicator);
+
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 34 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    PagedFileManager *pfm = PagedFileManager::instance();
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove(fileName.c_str());
+    remove(serialFileName.c_str());
+    remove(parallelFileName.c_str());
+    remove(csvFileName.c_str());
+
+    RC rcmain = RBFTest_34(pfm, rbfm);
+    return rcmain;
+}
@@ -0,0 +1,265 @@
+#include <iostream>
+#include <string>
+#include <cassert>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <stdio.h>
+
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+using namespace std;
+
+const int numRecords = 20000;
+const int narrowFields = 9;
+const string fileName = "test35";
+
+// A table of ints only, the last one left out of the narrower version
+void createNarrowRecordDescriptor(vector<Attribute> &recordDescriptor, int fieldCount)
+{
+    for (int i = 0; i < fieldCount; i++)
+    {
+        Attribute attr;
+        attr.name = "Field" + to_string(i);
+        attr.type = TypeInt;
+        attr.length = (AttrLength)4;
+        recordDescriptor.push_back(attr);
+    }
+}
+
+int RBFTest_35(RecordBasedFileManager *rbfm)
+{
+    // Functions Tested:
+    // 1. Insert Record, Read Record, Read Attribute and Scan, through a RecordLayout
+    // 2. Records read through a layout with fields they were written without
+    // 3. Read Record through a descriptor and through a layout, timed
+    // 4. Read Attribute through a layout of a record moved off its page
+    cout << endl << "***** In RBF Test Case 35 *****" << endl;
+
+    RC rc;
+    rc = rbfm->createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+    string name = fileName;
+    rc = createFileShouldSucceed(name);
+    assert(rc == success && "Creating the file failed.");
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+    RecordLayout layout(recordDescriptor);
+    assert(layout.getFieldCount() == 4 && layout.getNullIndicatorSize() == 1 && "The layout should have the descriptor's fields.");
+    assert(layout.getFieldIndex("Height") == 2 && layout.getFieldIndex("Weight") == -1 && "Fields should be found by name.");
+    assert(layout.matches(recordDescriptor) && "The layout should match its descriptor.");
+
+    // Records with and without NULLs, written through the layout and read back both ways
+    void *record = malloc(100);
+    void *returnedData = malloc(100);
+    unsigned char nulls[] = { 0, 1 << 7, 1 << 6, (1 << 5) | (1 << 4), 0xF0 };
+    const unsigned numKinds = sizeof(nulls) / sizeof(nulls[0]);
+    vector<RID> rids;
+    for (unsigned k = 0; k < numKinds; k++)
+    {
+        int recordSize = 0;
+        prepareRecord(recordDescriptor.size(), &nulls[k], 8, "Anteater", 20 + k, 170.5, 5000 + k, record, &recordSize);
+        RID rid;
+        rc = rbfm->insertRecord(fileHandle, layout, record, rid);
+        assert(rc == success && "Inserting a record through a layout should not fail.");
+        rids.push_back(rid);
+
+        memset(returnedData, 0, 100);
+        rc = rbfm->readRecord(fileHandle, recordDescriptor, rid, returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        if (memcmp(record, returnedData, recordSize) != 0)
+        {
+            cout << "[FAIL] Record " << k << " read through the descriptor differs. Test Case 35 Failed!" << endl << endl;
+            return -1;
+        }
+        memset(returnedData, 0, 100);
+        rc = rbfm->readRecord(fileHandle, layout, rid, returnedData);
+        assert(rc == success && "Reading a record through a layout should not fail.");
+        if (memcmp(record, returnedData, recordSize) != 0)
+        {
+            cout << "[FAIL] Record " << k << " read through the layout differs. Test Case 35 Failed!" << endl << endl;
+            return -1;
+        }
+    }
+
+    // A single attribute comes after a NULL flag byte
+    rc = rbfm->readAttribute(fileHandle, layout, rids[0], "Salary", returnedData);
+    assert(rc == success && "Reading an attribute through a layout should not fail.");
+    int salary;
+    memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+    assert(((char *) returnedData)[0] == 0 && salary == 5000 && "The attribute should be read back.");
+    rc = rbfm->readAttribute(fileHandle, layout, rids[1], "EmpName", returnedData);
+    assert(rc == success && ((char *) returnedData)[0] == 1 && "A NULL attribute should be flagged.");
+    rc = rbfm->readAttribute(fileHandle, layout, rids[2], "EmpName", returnedData);
+    assert(rc == success && ((char *) returnedData)[0] == 0 && memcmp((char *) returnedData + 1 + sizeof(int), "Anteater", 8) == 0
+           && "A VarChar attribute should be read back.");
+    rc = rbfm->readAttribute(fileHandle, layout, rids[0], "Weight", returnedData);
+    assert(rc == RBFM_READ_FAILED && "A missing attribute should not be read.");
+
+    // Age >= 22 projected on Salary then EmpName: the records of kinds 2, 3 and 4 whose age is not NULL
+    vector<string> attributeNames;
+    attributeNames.push_back("Salary");
+    attributeNames.push_back("EmpName");
+    int minAge = 22;
+    RBFM_ScanIterator scanIterator;
+    rc = rbfm->scan(fileHandle, layout, "Age", GE_OP, &minAge, attributeNames, scanIterator);
+    assert(rc == success && "Scanning through a layout should not fail.");
+    RID rid;
+    unsigned scanned = 0;
+    while (scanIterator.getNextRecord(rid, returnedData) != RBFM_EOF)
+    {
+        unsigned k = rid.slotNum;
+        int expectedSalary = 5000 + k;
+        char expected[20];
+        expected[0] = 0;
+        unsigned size = 1;
+        if (nulls[k] & (1 << 4))
+            expected[0] |= 1 << 7;
+        else
+        {
+            memcpy(expected + size, &expectedSalary, sizeof(int));
+            size += sizeof(int);
+        }
+        if (nulls[k] & (1 << 7))
+            expected[0] |= 1 << 6;
+        else
+        {
+            int length = 8;
+            memcpy(expected + size, &length, sizeof(int));
+            memcpy(expected + size + sizeof(int), "Anteater", 8);
+            size += sizeof(int) + 8;
+        }
+        if (k != 3 || memcmp(expected, returnedData, size) != 0)
+        {
+            cout << "[FAIL] The scan returned slot " << k << " wrong. Test Case 35 Failed!" << endl << endl;
+            return -1;
+        }
+        scanned++;
+    }
+    scanIterator.close();
+    if (scanned != 1)
+    {
+        cout << "[FAIL] The scan returned " << scanned << " records, expected 1. Test Case 35 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = rbfm->scan(fileHandle, layout, "Weight", GE_OP, &minAge, attributeNames, scanIterator);
+    assert(rc == RBFM_ScanIterator_ERROR && "Scanning on a missing attribute should fail.");
+    scanIterator.close();
+
+    // Records written before a field was added read it as NULL, past the first null byte too
+    vector<Attribute> shortDescriptor;
+    createRecordDescriptor(shortDescriptor);
+    shortDescriptor.pop_back();
+    int recordSize = 0;
+    unsigned char noNulls = 0;
+    prepareRecord(shortDescriptor.size(), &noNulls, 8, "Anteater", 30, 170.5, 0, record, &recordSize);
+    recordSize -= sizeof(int);
+    rc = rbfm->insertRecord(fileHandle, shortDescriptor, record, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+    rc = rbfm->readRecord(fileHandle, layout, rid, returnedData);
+    assert(rc == success && "Reading a record should not fail.");
+    if (((unsigned char *) returnedData)[0] != (1 << 4) || memcmp((char *) record + 1, (char *) returnedData + 1, recordSize - 1) != 0)
+    {
+        cout << "[FAIL] The added field should read as NULL. Test Case 35 Failed!" << endl << endl;
+        return -1;
+    }
+
+    vector<Attribute> narrowDescriptor;
+    createNarrowRecordDescriptor(narrowDescriptor, narrowFields);
+    vector<Attribute> olderDescriptor(narrowDescriptor.begin(), narrowDescriptor.end() - 1);
+    RecordLayout narrowLayout(narrowDescriptor);
+    char narrowRecord[2 + narrowFields * sizeof(int)];
+    memset(narrowRecord, 0, sizeof(narrowRecord));
+    for (int i = 0; i < narrowFields; i++)
+        memcpy(narrowRecord + 1 + i * sizeof(int), &i, sizeof(int));
+    rc = rbfm->insertRecord(fileHandle, olderDescriptor, narrowRecord, rid);
+    assert(rc == success && "Inserting a record should not fail.");
+    rc = rbfm->readRecord(fileHandle, narrowLayout, rid, returnedData);
+    assert(rc == success && "Reading a record should not fail.");
+    if (((unsigned char *) returnedData)[0] != 0 || ((unsigned char *) returnedData)[1] != (1 << 7)
+            || memcmp(narrowRecord + 1, (char *) returnedData + 2, (narrowFields - 1) * sizeof(int)) != 0)
+    {
+        cout << "[FAIL] The ninth field added should read as NULL. Test Case 35 Failed!" << endl << endl;
+        return -1;
+    }
+    rc = rbfm->readAttribute(fileHandle, narrowLayout, rid, "Field8", returnedData);
+    assert(rc == success && ((char *) returnedData)[0] == 1 && "An added attribute should read as NULL.");
+    cout << "Records are read and written through a layout!" << endl;
+
+    // Reading a narrow table through its descriptor and its layout, for comparison
+    narrowRecord[0] = narrowRecord[1] = 0;
+    RID firstRid = rids[0];
+    rids.clear();
+    for (int i = 0; i < numRecords; i++)
+    {
+        memcpy(narrowRecord + 2, &i, sizeof(int));
+        rc = rbfm->insertRecord(fileHandle, narrowLayout, narrowRecord, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+    uint64_t start = IOStats::now();
+    for (int i = 0; i < numRecords; i++)
+    {
+        rc = rbfm->readRecord(fileHandle, narrowDescriptor, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+    }
+    uint64_t descriptorNanos = IOStats::now() - start;
+    start = IOStats::now();
+    for (int i = 0; i < numRecords; i++)
+    {
+        rc = rbfm->readRecord(fileHandle, narrowLayout, rids[i], returnedData);
+        assert(rc == success && "Reading a record should not fail.");
+        assert(memcmp(narrowRecord + 2 + sizeof(int), (char *) returnedData + 2 + sizeof(int), (narrowFields - 1) * sizeof(int)) == 0
+               && "The record should be read back.");
+    }
+    uint64_t layoutNanos = IOStats::now() - start;
+    cout << numRecords << " reads of " << narrowFields << " ints: " << descriptorNanos / numRecords << " ns each through the descriptor, "
+         << layoutNanos / numRecords << " ns through the layout" << endl;
+
+    // The first page is full by now, so the first record grown moves and leaves its address behind
+    string longName(100, 'A');
+    char longRecord[200];
+    char longAttribute[200];
+    prepareRecord(recordDescriptor.size(), &nulls[0], longName.size(), longName, 20, 170.5, 5000, longRecord, &recordSize);
+    rc = rbfm->updateRecord(fileHandle, recordDescriptor, longRecord, firstRid);
+    assert(rc == success && "Updating a record should not fail.");
+    rc = rbfm->readAttribute(fileHandle, layout, firstRid, "EmpName", longAttribute);
+    assert(rc == success && "Reading an attribute of a moved record should not fail.");
+    if (longAttribute[0] != 0 || memcmp(longRecord + 1, longAttribute + 1, sizeof(int) + longName.size()) != 0)
+    {
+        cout << "[FAIL] The attribute of a moved record differs. Test Case 35 Failed!" << endl << endl;
+        return -1;
+    }
+
+    free(record);
+    free(returnedData);
+    rc = rbfm->closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = rbfm->destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+    rc = destroyFileShouldSucceed(name);
+    assert(rc == success  && "Destroying the file should not fail.");
+
+    cout << "RBF Test Case 35 Finished! The result will be examined." << endl << endl;
+
+    return 0;
+}
+
+int main()
+{
+    // To test the functionality of the record-based file manager
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+
+    remove(fileName.c_str());
+
+    RC rcmain = RBFTest_35(rbfm);
+    return rcmain;
+}
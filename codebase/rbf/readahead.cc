@@ -0,0 +1,199 @@
+#include <cstdlib>
+#include <system_error>
+#include <algorithm>
+
+#include "readahead.h"
+#include "bpm.h"
+
+ReadAhead::ReadAhead()
+{
+    fileHandle = NULL;
+    end = 0;
+    chunkPages = 0;
+    for (unsigned i = 0; i < RA_MAX_CHUNKS; i++)
+    {
+        slots[i].data = NULL;
+        slots[i].state = SlotFree;
+    }
+    head = 0;
+    queued = 0;
+    nextChunk = 0;
+    depth = 2;
+    readyStreak = 0;
+    running = false;
+    stopping = false;
+}
+
+ReadAhead::~ReadAhead()
+{
+    stop();
+    for (unsigned i = 0; i < RA_MAX_CHUNKS; i++)
+        free(slots[i].data);
+}
+
+RC ReadAhead::start(FileHandle &fileHandle, PageNum end, unsigned chunkPages)
+{
+    this->fileHandle = &fileHandle;
+    this->end = end;
+    this->chunkPages = chunkPages;
+    head = 0;
+    queued = 0;
+    nextChunk = 0;
+    stopping = false;
+
+    try
+    {
+        worker = thread(&ReadAhead::run, this);
+    }
+    catch (const system_error &)
+    {
+        return RA_THREAD_FAILED;
+    }
+    running = true;
+    return SUCCESS;
+}
+
+void ReadAhead::stop()
+{
+    if (!running)
+        return;
+
+    {
+        unique_lock<mutex> lock(latch);
+        stopping = true;
+    }
+    workQueued.notify_one();
+    worker.join();
+    running = false;
+
+    for (unsigned i = 0; i < RA_MAX_CHUNKS; i++)
+        slots[i].state = SlotFree;
+    queued = 0;
+}
+
+unsigned ReadAhead::getDepth()
+{
+    return depth;
+}
+
+// Tops the ring up to depth chunks. Called with the latch held.
+RC ReadAhead::queueChunks()
+{
+    BufferPoolManager *bpm = BufferPoolManager::instance();
+    while (queued < depth && nextChunk < end)
+    {
+        ReadAheadSlot &slot = slots[(head + queued) % RA_MAX_CHUNKS];
+        if (slot.data == NULL)
+        {
+            void *data = NULL;
+            if (posix_memalign(&data, PAGE_SIZE, (size_t) chunkPages * fileHandle->getPageSize()) != 0)
+                return RA_MALLOC_FAILED;
+            slot.data = (char*) data;
+        }
+
+        slot.start = nextChunk;
+        slot.count = min(chunkPages, end - nextChunk);
+
+        // The file has to be current before the background thread reads it
+        for (unsigned i = 0; i < slot.count; i++)
+        {
+            if (bpm->flushPage(*fileHandle, fileHandle->dataPageLocation(slot.start + i)))
+                return RA_READ_FAILED;
+        }
+
+        slot.state = SlotQueued;
+        nextChunk += slot.count;
+        queued++;
+        fileHandle->readPageCounter += slot.count;
+    }
+    workQueued.notify_one();
+    return SUCCESS;
+}
+
+RC ReadAhead::getPage(PageNum pageNum, const void *&page)
+{
+    if (pageNum >= end)
+        return RA_READ_FAILED;
+
+    unique_lock<mutex> lock(latch);
+
+    // Let go of the chunks the consumer has moved past
+    while (queued > 0 && pageNum >= slots[head].start + slots[head].count)
+    {
+        ReadAheadSlot &slot = slots[head];
+        while (slot.state == SlotReading)
+            workDone.wait(lock);
+        slot.state = SlotFree;
+        head = (head + 1) % RA_MAX_CHUNKS;
+        queued--;
+    }
+    if (queued == 0)
+        nextChunk = pageNum;
+    else if (pageNum < slots[head].start)
+        return RA_NOT_SEQUENTIAL;
+
+    RC rc = queueChunks();
+    if (rc)
+        return rc;
+
+    ReadAheadSlot &slot = slots[head];
+    bool firstPage = pageNum == slot.start;
+    bool waited = false;
+    while (slot.state == SlotQueued || slot.state == SlotReading)
+    {
+        waited = true;
+        workDone.wait(lock);
+    }
+    if (slot.state == SlotFailed)
+        return RA_READ_FAILED;
+
+    // Adapt the depth once per chunk
+    if (firstPage)
+    {
+        if (waited)
+        {
+            depth = min(depth * 2, (unsigned) RA_MAX_CHUNKS);
+            readyStreak = 0;
+        }
+        else if (++readyStreak >= RA_MAX_CHUNKS && depth > 1)
+        {
+            depth--;
+            readyStreak = 0;
+        }
+    }
+
+    page = slot.data + (size_t) (pageNum - slot.start) * fileHandle->getPageSize();
+    return SUCCESS;
+}
+
+// The background thread: reads queued chunks in ring order
+void ReadAhead::run()
+{
+    unique_lock<mutex> lock(latch);
+    while (true)
+    {
+        ReadAheadSlot *slot = NULL;
+        for (unsigned i = 0; i < queued && !slot; i++)
+        {
+            ReadAheadSlot &candidate = slots[(head + i) % RA_MAX_CHUNKS];
+            if (candidate.state == SlotQueued)
+                slot = &candidate;
+        }
+        if (slot == NULL)
+        {
+            if (stopping)
+                return;
+            workQueued.wait(lock);
+            continue;
+        }
+        if (stopping)
+            return;
+
+        slot->state = SlotReading;
+        lock.unlock();
+        RC rc = fileHandle->readRun(slot->start, slot->count, slot->data);
+        lock.lock();
+        slot->state = rc ? SlotFailed : SlotReady;
+        workDone.notify_all();
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef _readahead_h_
+#define _readahead_h_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "pfm.h"
+
+#define RA_MAX_CHUNKS   8       // chunks in flight at most
+
+#define RA_MALLOC_FAILED    1
+#define RA_READ_FAILED      2
+#define RA_NOT_SEQUENTIAL   3
+#define RA_THREAD_FAILED    4
+
+using namespace std;
+
+typedef enum { SlotFree = 0, SlotQueued, SlotReading, SlotReady, SlotFailed } SlotState;
+
+// One buffer of the ring, holding a chunk of consecutive data pages
+typedef struct ReadAheadSlot
+{
+    char *data;
+    PageNum start;
+    unsigned count;
+    SlotState state;
+} ReadAheadSlot;
+
+// ReadAhead reads the pages of a file ahead of a consumer that goes through them in order.
+// A background thread fills a ring of chunk buffers while the consumer works on the current one.
+// The number of chunks kept in flight adapts: it doubles whenever the consumer has to wait
+// for a chunk, and shrinks again while chunks are consistently ready before they are needed.
+//
+// Only the consumer's thread touches the buffer pool: dirty pages of a chunk are written
+// back when the chunk is queued, and the background thread reads the file directly.
+class ReadAhead
+{
+public:
+	ReadAhead();
+	~ReadAhead();
+
+	RC start(FileHandle &fileHandle, PageNum end, unsigned chunkPages);  // Start reading ahead in pages [0, end) of an open file
+	RC getPage(PageNum pageNum, const void *&page);                      // Wait for a page; valid until a later page is asked for
+	void stop();                                                         // Stop the background thread, dropping whatever is in flight
+
+	unsigned getDepth();                                                 // Chunks currently kept in flight
+
+private:
+	FileHandle *fileHandle;
+	PageNum end;
+	unsigned chunkPages;
+
+	ReadAheadSlot slots[RA_MAX_CHUNKS];
+	unsigned head;          // slot of the chunk the consumer is in
+	unsigned queued;        // chunks queued, being read or ready, from head on
+	PageNum nextChunk;      // first page of the next chunk to queue
+	unsigned depth;
+	unsigned readyStreak;   // chunks in a row the consumer didn't have to wait for
+
+	thread worker;
+	mutex latch;
+	condition_variable workQueued;
+	condition_variable workDone;
+	bool running;
+	bool stopping;
+
+	RC queueChunks();
+	void run();
+};
+
+#endif
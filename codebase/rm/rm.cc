@@ -1,13 +1,15 @@
 
 #include "rm.h"
 #include <iostream>
+#include <cstring>
+#include <mutex>
 
 RelationManager* RelationManager::_rm = 0;
 
 RelationManager* RelationManager::instance()
 {
-    if(!_rm)
-        _rm = new RelationManager();
+    static once_flag created;
+    call_once(created, [] { _rm = new RelationManager(); });
 
     return _rm;
 }
@@ -111,7 +113,7 @@ RC RelationManager::insertColumns (int32_t table_id, const vector<Attribute> &re
         memcpy((char *) columndata + offset, &pos, INT_SIZE); //&(i+1)??
         offset += INT_SIZE;
 
-        rc = rbfm->insertRecord(fileHandle, recordDescriptor, columndata, rid);
+        rc = rbfm->insertRecord(fileHandle, columnLayout, columndata, rid);
         if (rc) return rc;
     }
 
@@ -157,7 +159,7 @@ RC RelationManager::insertTables (int32_t table_id, bool system, const string &t
     memcpy((char *) tabledata + offset, &accessSystem, INT_SIZE);
     offset += INT_SIZE;
 
-    rc = rbfm->insertRecord(fileHandle, tableDescriptor, tabledata, rid);
+    rc = rbfm->insertRecord(fileHandle, tableLayout, tabledata, rid);
     if (rc) return rc;
 
     rbfm->closeFile(fileHandle);
@@ -166,10 +168,32 @@ RC RelationManager::insertTables (int32_t table_id, bool system, const string &t
 }
 
 
-RelationManager::RelationManager() : tableDescriptor (createTableDescriptor()), columnDescriptor (createColumnDescriptor())
+RelationManager::RelationManager() : tableDescriptor (createTableDescriptor()), columnDescriptor (createColumnDescriptor()),
+    tableLayout (tableDescriptor), columnLayout (columnDescriptor)
 {
 }
 
+// The table's layout, compiled from its attributes the first time. It stays put until the table is deleted.
+RC RelationManager::getLayout(const string &tableName, const RecordLayout *&layout)
+{
+    {
+        lock_guard<mutex> lock(layoutsLatch);
+        unordered_map<string, RecordLayout>::const_iterator found = layouts.find(tableName);
+        if (found != layouts.end()) {
+            layout = &found->second;
+            return SUCCESS;
+        }
+    }
+
+    vector<Attribute> attrs;
+    RC rc = getAttributes(tableName, attrs);
+    if (rc) return rc;
+
+    lock_guard<mutex> lock(layoutsLatch);
+    layout = &layouts.emplace(tableName, RecordLayout(attrs)).first->second;
+    return SUCCESS;
+}
+
 RelationManager::~RelationManager()
 {
 }
@@ -216,6 +240,9 @@ RC RelationManager::deleteCatalog()
     if (rc) return rc;
     rc = rbfm->destroyFile("Columns.ext");
     if (rc) return rc;
+
+    lock_guard<mutex> lock(layoutsLatch);
+    layouts.clear();
     return SUCCESS;
 }
 
@@ -234,7 +261,7 @@ RC RelationManager::getTableId(const string &tableName, int32_t &tableid){
     memcpy((char *) value + INT_SIZE, tableName.c_str(), attrnameLen);
 
     RBFM_ScanIterator scanIterator;
-    rc = rbfm->scan(fileHandle, tableDescriptor, "table-name", EQ_OP, value, attrs, scanIterator);
+    rc = rbfm->scan(fileHandle, tableLayout, "table-name", EQ_OP, value, attrs, scanIterator);
     if (rc) return rc;
 
     RID rid;
@@ -265,7 +292,7 @@ RC RelationManager::getNextTableId(int32_t &id) {
     vector<string> attrs;
     attrs.push_back("table-id");
     RBFM_ScanIterator scanIterator;
-    rc = rbfm->scan(fileHandle, tableDescriptor, "table-id", NO_OP, NULL, attrs, scanIterator);
+    rc = rbfm->scan(fileHandle, tableLayout, "table-id", NO_OP, NULL, attrs, scanIterator);
     if (rc) return rc;
     RID rid;
     void *data = malloc(1 + INT_SIZE);
@@ -301,6 +328,10 @@ RC RelationManager::createTable(const string &tableName, const vector<Attribute>
     RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
     RC rc = rbfm->createFile(tableName + ".ext");
     if (rc) return rc;
+    {
+        lock_guard<mutex> lock(layoutsLatch);
+        layouts.erase(tableName);
+    }
 
     int32_t id;
     rc = getNextTableId(id);
@@ -325,6 +356,10 @@ RC RelationManager::deleteTable(const string &tableName)
 //delete file
     RC rc = rbfm->destroyFile(tableName + ".ext");
     if (rc) return rc;
+    {
+        lock_guard<mutex> lock(layoutsLatch);
+        layouts.erase(tableName);
+    }
 //get tableid so as to delete entry in columns and entry in tables
     int32_t tableid;
     rc = getTableId(tableName, tableid);
@@ -339,7 +374,7 @@ RC RelationManager::deleteTable(const string &tableName)
     vector<string> attrs; //empty
     void *value = &tableid;
 
-    rc = rbfm->scan(fileHandle, tableDescriptor, "table-id", EQ_OP, value, attrs, scanIterator);
+    rc = rbfm->scan(fileHandle, tableLayout, "table-id", EQ_OP, value, attrs, scanIterator);
     if (rc) return rc;
 
     RID rid;
@@ -353,7 +388,7 @@ RC RelationManager::deleteTable(const string &tableName)
 //delete entry in columns
     rc = rbfm->openFile("Columns.ext", fileHandle);
     if (rc) return rc;
-    rc = rbfm->scan(fileHandle, columnDescriptor, "table-id", EQ_OP, value, attrs, scanIterator);
+    rc = rbfm->scan(fileHandle, columnLayout, "table-id", EQ_OP, value, attrs, scanIterator);
     if (rc) return rc;
 
     while ((rc = scanIterator.getNextRecord(rid, NULL)) == SUCCESS) {
@@ -397,7 +432,7 @@ RC RelationManager::getAttributes(const string &tableName, vector<Attribute> &at
     attr_show.push_back("column-length");
     attr_show.push_back("column-position");
 
-    rc = rbfm->scan(fileHandle, columnDescriptor, "table-id", EQ_OP, value, attr_show, scanIterator);
+    rc = rbfm->scan(fileHandle, columnLayout, "table-id", EQ_OP, value, attr_show, scanIterator);
     if (rc) return rc;
 
     RID rid;
@@ -470,17 +505,57 @@ RC RelationManager::insertTuple(const string &tableName, const void *data, RID &
     RC rc = rbfm->openFile(tableName + ".ext", fileHandle);
     if (rc) return rc;
 
-    vector<Attribute> newtableDescriptor;
-    rc = getAttributes(tableName, newtableDescriptor);
+    const RecordLayout *layout;
+    rc = getLayout(tableName, layout);
     if (rc) return rc;
 
-    rc = rbfm->insertRecord(fileHandle, newtableDescriptor, data, rid);
+    rc = rbfm->insertRecord(fileHandle, *layout, data, rid);
     if (rc) return rc;
 
     rc = rbfm->closeFile(fileHandle);
     return rc;
 }
 
+RC RelationManager::insertTuples(const string &tableName, const vector<const void*> &data, vector<RID> &rids)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    if (tableName == "Tables" || tableName == "Columns") {
+        return RM_CANNOT_DELETE_SYS;
+    }
+
+    const RecordLayout *layout;
+    RC rc = getLayout(tableName, layout);
+    if (rc) return rc;
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(tableName + ".ext", fileHandle);
+    if (rc) return rc;
+
+    rc = rbfm->insertRecords(fileHandle, layout->getAttributes(), data, rids);
+    RC closeRc = rbfm->closeFile(fileHandle);
+    return rc ? rc : closeRc;
+}
+
+RC RelationManager::loadTuples(const string &tableName, const string &csvFileName, const BulkLoadOptions &options, BulkLoadStats &stats)
+{
+    RecordBasedFileManager *rbfm = RecordBasedFileManager::instance();
+    if (tableName == "Tables" || tableName == "Columns") {
+        return RM_CANNOT_DELETE_SYS;
+    }
+
+    const RecordLayout *layout;
+    RC rc = getLayout(tableName, layout);
+    if (rc) return rc;
+
+    FileHandle fileHandle;
+    rc = rbfm->openFile(tableName + ".ext", fileHandle);
+    if (rc) return rc;
+
+    rc = rbfm->bulkLoad(fileHandle, layout->getAttributes(), csvFileName, options, stats);
+    RC closeRc = rbfm->closeFile(fileHandle);
+    return rc ? rc : closeRc;
+}
+
 
 //
 RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
@@ -494,11 +569,11 @@ RC RelationManager::deleteTuple(const string &tableName, const RID &rid)
     RC rc = rbfm->openFile(tableName + ".ext", fileHandle);
     if (rc) return rc;
 
-    vector<Attribute> newtableDescriptor;
-    rc = getAttributes(tableName, newtableDescriptor);
+    const RecordLayout *layout;
+    rc = getLayout(tableName, layout);
     if (rc) return rc;
 
-    rc = rbfm->deleteRecord(fileHandle, newtableDescriptor, rid);
+    rc = rbfm->deleteRecord(fileHandle, layout->getAttributes(), rid);
     if (rc) return rc;
 
     rc = rbfm->closeFile(fileHandle);
@@ -516,11 +591,11 @@ RC RelationManager::updateTuple(const string &tableName, const void *data, const
     RC rc = rbfm->openFile(tableName + ".ext", fileHandle);
     if (rc) return rc;
 
-    vector<Attribute> newtableDescriptor;
-    rc = getAttributes(tableName, newtableDescriptor);
+    const RecordLayout *layout;
+    rc = getLayout(tableName, layout);
     if (rc) return rc;
 
-    rc = rbfm->updateRecord(fileHandle, newtableDescriptor, data, rid);
+    rc = rbfm->updateRecord(fileHandle, *layout, data, rid);
     if (rc) return rc;
 
     rc = rbfm->closeFile(fileHandle);
@@ -535,11 +610,11 @@ RC RelationManager::readTuple(const string &tableName, const RID &rid, void *dat
     RC rc = rbfm->openFile(tableName + ".ext", fileHandle);
     if (rc) return rc;
 
-    vector<Attribute> newtableDescriptor;
-    rc = getAttributes(tableName, newtableDescriptor);
+    const RecordLayout *layout;
+    rc = getLayout(tableName, layout);
     if (rc) return rc;
 
-    rc = rbfm->readRecord(fileHandle, newtableDescriptor, rid, data);
+    rc = rbfm->readRecord(fileHandle, *layout, rid, data);
     if (rc) return rc;
 
     rc = rbfm->closeFile(fileHandle);
@@ -563,11 +638,11 @@ RC RelationManager::readAttribute(const string &tableName, const RID &rid, const
     RC rc = rbfm->openFile(tableName + ".ext", fileHandle);
     if (rc) return rc;
 
-    vector<Attribute> newtableDescriptor;
-    rc = getAttributes(tableName, newtableDescriptor);
+    const RecordLayout *layout;
+    rc = getLayout(tableName, layout);
     if (rc) return rc;
 
-    rc = rbfm->readAttribute(fileHandle, newtableDescriptor, rid, attributeName, data);
+    rc = rbfm->readAttribute(fileHandle, *layout, rid, attributeName, data);
     if (rc) return rc;
 
     rc = rbfm->closeFile(fileHandle);
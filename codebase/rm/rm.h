@@ -4,6 +4,8 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
 
 #include "../rbf/rbfm.h"
 
@@ -55,6 +57,12 @@ public:
 
   RC insertTuple(const string &tableName, const void *data, RID &rid);
 
+  // Inserts many tuples at once, with the file opened and the schema looked up only once; rids[i] is where data[i] went
+  RC insertTuples(const string &tableName, const vector<const void*> &data, vector<RID> &rids);
+
+  // Loads a CSV file into the table, a field per column, as RecordBasedFileManager::bulkLoad does
+  RC loadTuples(const string &tableName, const string &csvFileName, const BulkLoadOptions &options, BulkLoadStats &stats);
+
   RC deleteTuple(const string &tableName, const RID &rid);
 
   RC updateTuple(const string &tableName, const void *data, const RID &rid);
@@ -85,6 +93,12 @@ private:
   static RelationManager *_rm;
   const vector<Attribute> tableDescriptor;
   const vector<Attribute> columnDescriptor;
+  const RecordLayout tableLayout;
+  const RecordLayout columnLayout;
+
+  // Layouts of the user tables, compiled from the catalog on first use and dropped with the table
+  unordered_map<string, RecordLayout> layouts;
+  mutex layoutsLatch;
 
   static vector<Attribute> createTableDescriptor();
   static vector<Attribute> createColumnDescriptor();
@@ -93,6 +107,7 @@ private:
   RC insertTables (int32_t table_id, bool system, const string &tableName);
   RC getNextTableId(int32_t &id);
   RC getTableId(const string &tableName, int32_t &tableid);
+  RC getLayout(const string &tableName, const RecordLayout *&layout);
 
 };
 